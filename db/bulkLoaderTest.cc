@@ -0,0 +1,147 @@
+#include "bulk_loader.h"
+#include "../sstable/table_cache.h"
+#include "../util/fname.h"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+static std::string Key(int i)
+{
+    char buf[32];
+    snprintf(buf,sizeof(buf),"key%06d",i);
+    return buf;
+}
+
+static bool FileExists(const std::string& fileName)
+{
+    struct stat st;
+    return ::stat(fileName.c_str(),&st) == 0;
+}
+
+TEST(BulkLoader,RollsTables)
+{
+    const std::string dbname = "bulk_loader_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::atomic<uint64_t> nextFileNumber{1};
+    BulkLoadOptions loadOptions;
+    loadOptions.targetFileSize_ = 64 * 1024;
+    loadOptions.sequence_ = 100;
+    Options options;
+    options.compression_ = CompressionType::kNoCompression;
+    BulkLoader loader(dbname,options,loadOptions,&nextFileNumber);
+    for (int i = 0; i < 10000; i++)
+    {
+        ASSERT_EQ(loader.Add(Key(i),std::string(100,'a' + i % 26)),0);
+    }
+    ASSERT_EQ(loader.Finish(),0);
+    const auto& files = loader.Files();
+    ASSERT_GT(files.size(),10);
+    uint64_t entries = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        ASSERT_EQ(files[i].number_,i + 1);
+        ASSERT_LT(files[i].fileSize_,loadOptions.targetFileSize_ + 8 * 1024);
+        entries += files[i].numEntries_;
+        if(i > 0)
+        {
+            ASSERT_LT(files[i - 1].largest_.ExtractUserKey(),files[i].smallest_.ExtractUserKey());
+        }
+    }
+    ASSERT_EQ(entries,10000);
+
+    //properties are written as the tables are built
+    TableCache cache(dbname,16,options);
+    TableProperties properties;
+    ASSERT_TRUE(cache.GetProperties(files[0].number_,files[0].fileSize_,&properties));
+    ASSERT_EQ(properties.numEntries_,files[0].numEntries_);
+    ASSERT_EQ(properties.minSequence_,100);
+
+    //keys must keep increasing
+    BulkLoader unordered(dbname,options,loadOptions,&nextFileNumber);
+    ASSERT_EQ(unordered.Add(Key(5),"v"),0);
+    ASSERT_EQ(unordered.Add(Key(5),"v"),-1);
+    ASSERT_EQ(unordered.Add(Key(6),"v"),-1);
+    ASSERT_EQ(unordered.Finish(),-1);
+}
+
+TEST(BulkLoader,ParallelLoad)
+{
+    const std::string dbname = "bulk_parallel_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::atomic<uint64_t> nextFileNumber{1};
+    BulkLoadOptions loadOptions;
+    loadOptions.targetFileSize_ = 32 * 1024;
+    loadOptions.sequence_ = 7;
+    Options options;
+    std::vector<BulkLoadSource> sources;
+    for (int part = 0; part < 4; part++)
+    {
+        sources.push_back([part](BulkLoader& loader){
+            for (int i = part * 5000; i < (part + 1) * 5000; i++)
+            {
+                if(loader.Add(Key(i),"value" + std::to_string(i)) != 0)
+                    return -1;
+            }
+            return 0;
+        });
+    }
+    VersionEdit edit;
+    Version version;
+    ASSERT_EQ(ParallelBulkLoad(dbname,options,loadOptions,&nextFileNumber,sources,version,&edit),0);
+    ASSERT_EQ(edit.LastSequence(),7);
+    version.Apply(edit);
+    const auto& files = version.Files(loadOptions.level_);
+    ASSERT_EQ(files.size(),edit.NewFiles().size());
+    for (size_t i = 1; i < files.size(); i++)
+    {
+        ASSERT_LT(files[i - 1].largest_.ExtractUserKey(),files[i].smallest_.ExtractUserKey());
+    }
+
+    TableCache cache(dbname,64,options);
+    int next = 0;
+    ParallelScanOptions scanOptions;
+    scanOptions.ordered_ = true;
+    ASSERT_EQ(version.ParallelScan(cache,{Key(0),Key(20000)},scanOptions,[&](const std::string_view& key,const std::string_view& value){
+        EXPECT_EQ(key,InternalKey(Key(next),7,OpsType::UPDATE).Encode());
+        EXPECT_EQ(value,"value" + std::to_string(next));
+        next++;
+        return true;
+    }),20000);
+
+    //overlapping ranges fail the whole load and leave no table behind
+    uint64_t first = nextFileNumber;
+    std::vector<BulkLoadSource> overlapping{
+        [](BulkLoader& loader){ return loader.Add(Key(1),"a") | loader.Add(Key(3),"b"); },
+        [](BulkLoader& loader){ return loader.Add(Key(2),"c"); },
+    };
+    VersionEdit failed;
+    ASSERT_EQ(ParallelBulkLoad(dbname,options,loadOptions,&nextFileNumber,overlapping,version,&failed),-1);
+    ASSERT_TRUE(failed.NewFiles().empty());
+    for (uint64_t number = first; number < nextFileNumber; number++)
+    {
+        ASSERT_FALSE(FileExists(TableFileName(dbname,number)));
+    }
+
+    //so do ranges that overlap files at the level or above it
+    loadOptions.sequence_ = 8;
+    std::vector<BulkLoadSource> spanning{
+        [](BulkLoader& loader){ return loader.Add(Key(19999),"d") | loader.Add(Key(20001),"e"); },
+    };
+    VersionEdit rejected;
+    ASSERT_EQ(ParallelBulkLoad(dbname,options,loadOptions,&nextFileNumber,spanning,version,&rejected),-1);
+    ASSERT_TRUE(rejected.NewFiles().empty());
+    //a level above them takes the range, as does the target level for a disjoint one
+    loadOptions.level_ = 1;
+    VersionEdit upper;
+    ASSERT_EQ(ParallelBulkLoad(dbname,options,loadOptions,&nextFileNumber,spanning,version,&upper),0);
+    ASSERT_EQ(upper.NewFiles().size(),1);
+    loadOptions.level_ = kNumLevels - 1;
+    std::vector<BulkLoadSource> disjoint{
+        [](BulkLoader& loader){ return loader.Add(Key(20001),"f"); },
+    };
+    VersionEdit fresh;
+    ASSERT_EQ(ParallelBulkLoad(dbname,options,loadOptions,&nextFileNumber,disjoint,version,&fresh),0);
+    ASSERT_EQ(fresh.NewFiles().size(),1);
+}
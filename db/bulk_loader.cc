@@ -0,0 +1,132 @@
+#include "bulk_loader.h"
+#include "../util/fname.h"
+
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+BulkLoader::BulkLoader(std::string dbname,const Options& options,const BulkLoadOptions& loadOptions,
+                        std::atomic<uint64_t>* nextFileNumber)
+ : dbname_(std::move(dbname)),
+   options_(options),
+   loadOptions_(loadOptions),
+   nextFileNumber_(nextFileNumber)
+{
+
+}
+
+void BulkLoader::finishTable()
+{
+    ok_ = builder_->Finish() == 0 && ok_;
+    current_.fileSize_ = builder_->FileSize();
+    current_.numEntries_ = builder_->NumEntries();
+    current_.creationTime_ = builder_->Properties().creationTime_;
+    current_.largest_ = InternalKey(lastKey_,loadOptions_.sequence_,OpsType::UPDATE);
+    files_.push_back(std::move(current_));
+    current_ = FileMeta{};
+    builder_.reset();
+}
+
+int BulkLoader::Add(const std::string_view& userKey,const std::string_view& value)
+{
+    if(!ok_ || ((builder_ != nullptr || !files_.empty()) && userKey <= lastKey_))
+    {
+        ok_ = false;
+        return -1;
+    }
+    InternalKey key(userKey,loadOptions_.sequence_,OpsType::UPDATE);
+    if(builder_ == nullptr)
+    {
+        current_.number_ = nextFileNumber_->fetch_add(1);
+        current_.smallest_ = key;
+        builder_ = std::make_unique<TableBuilder>(TableFileName(dbname_,current_.number_),options_);
+    }
+    builder_->Add(key.Encode(),value);
+    lastKey_ = userKey;
+    if(builder_->FileSize() >= loadOptions_.targetFileSize_)
+        finishTable();
+    return ok_ ? 0 : -1;
+}
+
+int BulkLoader::Finish()
+{
+    if(builder_)
+        finishTable();
+    return ok_ ? 0 : -1;
+}
+
+void BulkLoader::Abandon()
+{
+    if(builder_)
+        finishTable();
+    for (const auto & file : files_)
+    {
+        std::remove(TableFileName(dbname_,file.number_).c_str());
+    }
+    files_.clear();
+    ok_ = false;
+}
+
+int ParallelBulkLoad(const std::string& dbname,const Options& options,const BulkLoadOptions& loadOptions,
+                        std::atomic<uint64_t>* nextFileNumber,const std::vector<BulkLoadSource>& sources,
+                        const Version& version,VersionEdit* edit)
+{
+    std::vector<std::unique_ptr<BulkLoader>> loaders;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        loaders.push_back(std::make_unique<BulkLoader>(dbname,options,loadOptions,nextFileNumber));
+    }
+    std::vector<int> results(sources.size(),-1);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        workers.emplace_back([&,i](){
+            BulkLoader& loader = *loaders[i];
+            int ret = sources[i](loader);
+            results[i] = loader.Finish() == 0 ? ret : -1;
+        });
+    }
+    for (auto & t : workers)
+    {
+        t.join();
+    }
+
+    std::vector<FileMeta> files;
+    bool ok = std::all_of(results.begin(),results.end(),[](int ret){ return ret == 0; });
+    for (const auto & loader : loaders)
+    {
+        files.insert(files.end(),loader->Files().begin(),loader->Files().end());
+    }
+    std::sort(files.begin(),files.end(),[](const FileMeta& l,const FileMeta& r){
+        return l.smallest_.ExtractUserKey() < r.smallest_.ExtractUserKey();
+    });
+    for (size_t i = 1; i < files.size() && ok; i++)
+    {
+        ok = files[i - 1].largest_.ExtractUserKey() < files[i].smallest_.ExtractUserKey();
+    }
+    //the loaded keys are the newest, older versions above them would be read first
+    for (int level = 0; level <= loadOptions.level_ && ok; level++)
+    {
+        for (const auto & existing : version.Files(level))
+        {
+            ok = ok && std::none_of(files.begin(),files.end(),[&existing](const FileMeta& file){
+                return file.largest_.ExtractUserKey() >= existing.smallest_.ExtractUserKey() &&
+                        file.smallest_.ExtractUserKey() <= existing.largest_.ExtractUserKey();
+            });
+        }
+    }
+    if(!ok)
+    {
+        for (const auto & loader : loaders)
+        {
+            loader->Abandon();
+        }
+        return -1;
+    }
+    for (const auto & file : files)
+    {
+        edit->AddFile(loadOptions.level_,file);
+    }
+    edit->SetLastSequence(std::max(edit->LastSequence(),loadOptions.sequence_));
+    return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include "version.h"
+#include "../sstable/table_builder.h"
+#include "../util/Options.h"
+
+struct BulkLoadOptions
+{
+    //a table is finished once it reaches about this size
+    uint64_t targetFileSize_{64 << 20};
+    //level the tables are added at, neither it nor a level above may hold keys of the
+    //loaded ranges, ParallelBulkLoad rejects the load otherwise
+    int level_{kNumLevels - 1};
+    //every key is written with this sequence, newer than anything the DB holds
+    SequenceNumber sequence_{1};
+};
+
+//writes keys that arrive sorted straight into tables of the DB directory, without
+//memtable or log, and rolls to a new table at the target size.
+//loaders on disjoint key ranges can run on separate threads and share nextFileNumber
+class BulkLoader
+{
+private:
+    const std::string dbname_;
+    Options options_;
+    BulkLoadOptions loadOptions_;
+    std::atomic<uint64_t>* nextFileNumber_;
+    std::unique_ptr<TableBuilder> builder_{nullptr};
+    FileMeta current_;
+    std::vector<FileMeta> files_;
+    std::string lastKey_;
+    bool ok_{true};
+
+    void finishTable();
+public:
+    BulkLoader(std::string dbname,const Options& options,const BulkLoadOptions& loadOptions,
+                std::atomic<uint64_t>* nextFileNumber);
+    ~BulkLoader() = default;
+
+    BulkLoader(const BulkLoader&) = delete;
+    BulkLoader& operator=(const BulkLoader&) = delete;
+
+    //user keys in strictly increasing order, -1 when one is not or a write failed
+    int Add(const std::string_view& userKey,const std::string_view& value);
+
+    //finishes the last table, -1 if any table failed
+    int Finish();
+
+    //finished tables in key order
+    const std::vector<FileMeta>& Files() const
+    {
+        return files_;
+    }
+
+    //deletes every table written so far
+    void Abandon();
+};
+
+//feeds one loader of a partition, returns -1 to fail the load
+using BulkLoadSource = std::function<int(BulkLoader&)>;
+
+//runs every source on its own thread with its own loader and collects all tables in one edit
+//for version, sources cover disjoint key ranges. on any failure, when the ranges turn out to
+//overlap or when they overlap files of version at or above the target level, every table is
+//deleted, edit is left untouched and -1 is returned
+int ParallelBulkLoad(const std::string& dbname,const Options& options,const BulkLoadOptions& loadOptions,
+                        std::atomic<uint64_t>* nextFileNumber,const std::vector<BulkLoadSource>& sources,
+                        const Version& version,VersionEdit* edit);
@@ -0,0 +1,431 @@
+#include "compaction.h"
+#include "../sstable/table_cache.h"
+#include "../sstable/table_builder.h"
+#include "../util/fname.h"
+
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+
+std::vector<UniversalCompactionPicker::SortedRun> UniversalCompactionPicker::sortedRuns(const Version& version) const
+{
+    std::vector<SortedRun> runs;
+    const auto& level0 = version.Files(0);
+    for (auto it = level0.rbegin(); it != level0.rend(); it++)
+    {
+        runs.push_back(SortedRun{0,*it,it->fileSize_});
+    }
+    for (int level = 1; level < kNumLevels; level++)
+    {
+        const auto& files = version.Files(level);
+        if(files.empty())
+            continue;
+        uint64_t size = 0;
+        for (const auto & file : files)
+        {
+            size += file.fileSize_;
+        }
+        runs.push_back(SortedRun{level,FileMeta{},size});
+    }
+    return runs;
+}
+
+bool UniversalCompactionPicker::compactionOf(const Version& version,const std::vector<SortedRun>& runs,size_t first,size_t n,
+                                                Compaction* compaction) const
+{
+    Compaction picked;
+    for (size_t i = first; i < n; i++)
+    {
+        if(runs[i].level_ == 0)
+        {
+            picked.inputs_.emplace_back(0,runs[i].file_);
+            continue;
+        }
+        for (const auto & file : version.Files(runs[i].level_))
+        {
+            picked.inputs_.emplace_back(runs[i].level_,file);
+        }
+    }
+    picked.bottommost_ = n == runs.size();
+    if(picked.bottommost_)
+    {
+        picked.outputLevel_ = kNumLevels - 1;
+    } else if(runs[n - 1].level_ > 0)
+    {
+        picked.outputLevel_ = runs[n - 1].level_;
+    } else
+    {
+        //the levels between level 0 and the next run are empty
+        picked.outputLevel_ = std::max(runs[n].level_ - 1,0);
+        if(picked.outputLevel_ == 0 && first > 0)
+            return false;
+    }
+    *compaction = std::move(picked);
+    return true;
+}
+
+bool UniversalCompactionPicker::PickCompaction(const Version& version,Compaction* compaction) const
+{
+    std::vector<SortedRun> runs = sortedRuns(version);
+    if(runs.size() < 2)
+        return false;
+    size_t maxWidth = std::max<size_t>(options_.maxMergeWidth_,2);
+
+    //space amplification, the oldest run holds most of the live data
+    uint64_t newer = 0;
+    for (size_t i = 0; i + 1 < runs.size(); i++)
+    {
+        newer += runs[i].size_;
+    }
+    if(newer * 100 >= runs.back().size_ * options_.maxSizeAmplificationPercent_)
+        return compactionOf(version,runs,0,runs.size(),compaction);
+
+    //size ratio, starting from the newest run
+    for (size_t start = 0; start + 1 < runs.size(); start++)
+    {
+        uint64_t candidateSize = runs[start].size_;
+        size_t n = start + 1;
+        while (n < runs.size() && n - start < maxWidth &&
+                runs[n].size_ * 100 <= candidateSize * (100 + options_.sizeRatio_))
+        {
+            candidateSize += runs[n].size_;
+            n++;
+        }
+        if(n - start < std::max<size_t>(options_.minMergeWidth_,2))
+            continue;
+        //only the picked runs are merged, the newer ones stay above the output
+        if(compactionOf(version,runs,start,n,compaction))
+            return true;
+    }
+
+    //too many runs, merge the newest ones down to the limit, at most maxWidth at a time
+    if(runs.size() > options_.maxSortedRuns_)
+    {
+        size_t n = std::min(std::max<size_t>(runs.size() - options_.maxSortedRuns_ + 1,2),runs.size());
+        return compactionOf(version,runs,0,std::min(n,maxWidth),compaction);
+    }
+    return false;
+}
+
+bool FIFOCompactionPicker::PickCompaction(const Version& version,uint64_t now,Compaction* compaction) const
+{
+    const auto& files = version.Files(0);
+    *compaction = Compaction{};
+    compaction->deletionOnly_ = true;
+    if(options_.ttl_ > 0)
+    {
+        //merged files carry the creation time of their oldest input, so look at every file
+        for (const auto & file : files)
+        {
+            if(file.creationTime_ > 0 && file.creationTime_ + options_.ttl_ <= now)
+                compaction->inputs_.emplace_back(0,file);
+        }
+        if(!compaction->inputs_.empty())
+            return true;
+    }
+
+    uint64_t totalSize = 0;
+    for (const auto & file : files)
+    {
+        totalSize += file.fileSize_;
+    }
+    if(options_.maxTableFilesSize_ > 0)
+    {
+        for (auto it = files.begin(); it != files.end() && totalSize > options_.maxTableFilesSize_; it++)
+        {
+            compaction->inputs_.emplace_back(0,*it);
+            totalSize -= it->fileSize_;
+        }
+        if(!compaction->inputs_.empty())
+            return true;
+    }
+
+    //the newest small files, the output stays the newest file
+    if(!options_.allowCompaction_)
+        return false;
+    *compaction = Compaction{};
+    for (auto it = files.rbegin(); it != files.rend() && it->fileSize_ < options_.maxMergeFileSize_; it++)
+    {
+        compaction->inputs_.emplace_back(0,*it);
+    }
+    if(compaction->inputs_.size() < std::max<size_t>(options_.minMergeWidth_,2))
+        return false;
+    compaction->outputLevel_ = 0;
+    //older files still hold versions a deletion may shadow
+    compaction->bottommost_ = compaction->inputs_.size() == files.size();
+    for (int level = 1; level < kNumLevels && compaction->bottommost_; level++)
+    {
+        compaction->bottommost_ = version.Files(level).empty();
+    }
+    return true;
+}
+
+CompactionJob::CompactionJob(std::string dbname,TableCache& cache,const Options& options,
+                                const CompactionOptions& compactionOptions,std::atomic<uint64_t>* nextFileNumber)
+ : dbname_(std::move(dbname)),
+   cache_(cache),
+   options_(options),
+   compactionOptions_(compactionOptions),
+   nextFileNumber_(nextFileNumber)
+{
+
+}
+
+template<typename F>
+void CompactionJob::mergeOperands(MergeIterator& it,const MergeOperator& mergeOperator,const std::string& userKey,
+                                    bool bottommost,SequenceNumber* lastSequenceForKey,F&& emit)
+{
+    //operands newest first, then the base they stopped at
+    std::vector<std::pair<std::string,std::string>> operands;
+    std::string baseKey;
+    std::string base;
+    OpsType baseType = OpsType::DELETE;
+    bool hasBase = false;
+    bool reachedBase = false;
+    const bool newerThanSnapshot = ExtractSequence(it.key()) > compactionOptions_.smallestSnapshot_;
+    for (; it.Valid(); it.Next())
+    {
+        std::string_view key = it.key();
+        SequenceNumber seq = ExtractSequence(key);
+        if(key.substr(0,key.size() - 8) != userKey || (seq > compactionOptions_.smallestSnapshot_) != newerThanSnapshot)
+            break;
+        *lastSequenceForKey = seq;
+        if(ExtractOpsType(key) == OpsType::MERGE)
+        {
+            operands.emplace_back(key,it.value());
+            continue;
+        }
+        reachedBase = true;
+        baseType = ExtractOpsType(key);
+        hasBase = baseType != OpsType::DELETE;
+        baseKey = key;
+        base = it.value();
+        it.Next();
+        break;
+    }
+    bool keyEnded = !it.Valid() || it.key().substr(0,it.key().size() - 8) != userKey;
+
+    if(reachedBase || (keyEnded && bottommost))
+    {
+        MergeContext context;
+        for (const auto & [key,value] : operands)
+        {
+            context.PushOperand(value);
+        }
+        std::string result;
+        std::string blob;
+        std::string_view baseValue = base;
+        //a separated base is read only now that the operands go onto it
+        bool resolved = baseType != OpsType::BLOB_INDEX || cache_.GetBlobCache()->Resolve(base,&blob);
+        if(baseType == OpsType::BLOB_INDEX)
+            baseValue = blob;
+        if(resolved && context.Fold(mergeOperator,userKey,hasBase ? &baseValue : nullptr,&result))
+        {
+            std::string key = operands.front().first;
+            SetOpsType(key,OpsType::UPDATE);
+            emit(key,result);
+            return;
+        }
+        //kept as they are for reads to fail on
+        for (const auto & [key,value] : operands)
+        {
+            emit(key,value);
+        }
+        if(reachedBase)
+            emit(baseKey,base);
+        return;
+    }
+
+    //the base lies below the inputs or past a snapshot, operands are combined where the
+    //operator allows it and each result keeps the newest key of the operands it replaces
+    std::vector<std::pair<std::string,std::string>> combined;
+    for (auto it = operands.rbegin(); it != operands.rend(); it++)
+    {
+        std::string result;
+        if(!combined.empty() && mergeOperator.PartialMerge(userKey,combined.back().second,it->second,&result))
+        {
+            combined.back() = {it->first,std::move(result)};
+            continue;
+        }
+        combined.push_back(*it);
+    }
+    for (auto it = combined.rbegin(); it != combined.rend(); it++)
+    {
+        emit(it->first,it->second);
+    }
+}
+
+int CompactionJob::Run(const Compaction& compaction,VersionEdit* edit)
+{
+    if(compaction.deletionOnly_)
+    {
+        for (const auto & [level,file] : compaction.inputs_)
+        {
+            edit->RemoveFile(level,file.number_);
+        }
+        return 0;
+    }
+    std::vector<FileMeta> inputs;
+    uint64_t creationTime = 0;
+    for (const auto & [level,file] : compaction.inputs_)
+    {
+        inputs.push_back(file);
+        if(file.creationTime_ > 0 && (creationTime == 0 || file.creationTime_ < creationTime))
+            creationTime = file.creationTime_;
+    }
+    //blob references are copied through, values are read only where a filter or merge needs them
+    ReadOptions readOptions;
+    readOptions.resolveBlobs_ = false;
+    MergeIterator::IteratorList iterators = cache_.NewIterators(inputs,readOptions);
+    if(iterators.size() != inputs.size())
+        return -1;
+    MergeIterator it(std::move(iterators));
+
+    std::vector<FileMeta> outputs;
+    std::unique_ptr<TableBuilder> builder;
+    FileMeta current;
+    std::string lastKey;
+    bool ok = true;
+    auto finishTable = [&](){
+        ok = builder->Finish() == 0 && ok;
+        current.fileSize_ = builder->FileSize();
+        current.numEntries_ = builder->NumEntries();
+        //the output expires with its oldest input
+        current.creationTime_ = creationTime > 0 ? creationTime : builder->Properties().creationTime_;
+        current.largest_.DecodeFrom(lastKey);
+        outputs.push_back(std::move(current));
+        current = FileMeta{};
+        builder.reset();
+    };
+
+    const CompactionFilter* filter = compactionOptions_.compactionFilter_.get();
+    const MergeOperator* mergeOperator = options_.mergeOperator_.get();
+    const SequenceNumber smallestSnapshot = compactionOptions_.smallestSnapshot_;
+    auto emit = [&](const std::string_view& key,const std::string_view& value){
+        if(builder == nullptr)
+        {
+            current.number_ = nextFileNumber_->fetch_add(1);
+            current.smallest_.DecodeFrom(key);
+            builder = std::make_unique<TableBuilder>(TableFileName(dbname_,current.number_),options_);
+        }
+        builder->Add(key,value);
+        lastKey = key;
+    };
+
+    std::string filteredValue;
+    std::string blobValue;
+    std::string rewrittenKey;
+    std::string currentUserKey;
+    bool hasCurrentUserKey = false;
+    SequenceNumber lastSequenceForKey = kDefaultMaxSequenceNumber;
+    //an operand kept as it is does not hide the versions below it
+    bool lastWasOperand = false;
+    it.SeekForFirst();
+    while (it.Valid() && ok)
+    {
+        std::string_view key = it.key();
+        std::string_view userKey = key.substr(0,key.size() - 8);
+        SequenceNumber seq = ExtractSequence(key);
+        OpsType type = ExtractOpsType(key);
+        bool sameUserKey = hasCurrentUserKey && userKey == currentUserKey;
+        if(!sameUserKey)
+        {
+            currentUserKey = userKey;
+            hasCurrentUserKey = true;
+            lastSequenceForKey = kDefaultMaxSequenceNumber;
+            //a table ends between user keys so that the versions of one key stay together
+            if(builder && builder->FileSize() >= compactionOptions_.targetFileSize_)
+                finishTable();
+        }
+        bool drop = false;
+        if(sameUserKey && !lastWasOperand && lastSequenceForKey <= smallestSnapshot)
+        {
+            //shadowed by a newer version every snapshot sees
+            drop = true;
+        } else if(type == OpsType::DELETE && seq <= smallestSnapshot && compaction.bottommost_)
+        {
+            drop = true;
+        }
+        lastSequenceForKey = seq;
+        lastWasOperand = type == OpsType::MERGE;
+        if(drop)
+        {
+            it.Next();
+            continue;
+        }
+
+        if(mergeOperator != nullptr && type == OpsType::MERGE)
+        {
+            mergeOperands(it,*mergeOperator,currentUserKey,compaction.bottommost_,&lastSequenceForKey,emit);
+            lastWasOperand = false;
+            continue;
+        }
+
+        std::string_view value = it.value();
+        if(filter != nullptr && (type == OpsType::UPDATE || type == OpsType::BLOB_INDEX))
+        {
+            //a separated value is read for the filter only, kept entries stay references
+            std::string_view filterValue = value;
+            if(type == OpsType::BLOB_INDEX)
+            {
+                if(!cache_.GetBlobCache()->Resolve(value,&blobValue))
+                {
+                    emit(key,value);
+                    it.Next();
+                    continue;
+                }
+                filterValue = blobValue;
+            }
+            filteredValue.clear();
+            switch (filter->Filter(compaction.outputLevel_,userKey,seq,filterValue,&filteredValue))
+            {
+            case FilterDecision::kKeep:
+                break;
+            case FilterDecision::kRemove:
+                //every snapshot reads this version, the older ones below are shadowed and
+                //dropped with it. otherwise a deletion keeps them hidden from newer reads
+                if(compaction.bottommost_ && seq <= smallestSnapshot)
+                {
+                    it.Next();
+                    continue;
+                }
+                rewrittenKey = key;
+                SetOpsType(rewrittenKey,OpsType::DELETE);
+                key = rewrittenKey;
+                value = std::string_view();
+                break;
+            case FilterDecision::kChangeValue:
+                //the new value is written inline
+                rewrittenKey = key;
+                SetOpsType(rewrittenKey,OpsType::UPDATE);
+                key = rewrittenKey;
+                value = filteredValue;
+                break;
+            }
+        }
+        emit(key,value);
+        it.Next();
+    }
+    //an input that fails to read ends early, the entries past it would be lost
+    if(it.Corrupted())
+        ok = false;
+    if(builder)
+        finishTable();
+    if(!ok)
+    {
+        for (const auto & file : outputs)
+        {
+            std::remove(TableFileName(dbname_,file.number_).c_str());
+        }
+        return -1;
+    }
+    for (const auto & [level,file] : compaction.inputs_)
+    {
+        edit->RemoveFile(level,file.number_);
+    }
+    for (const auto & file : outputs)
+    {
+        edit->AddFile(compaction.outputLevel_,file);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <memory>
+
+#include "version.h"
+#include "compaction_filter.h"
+#include "../util/Options.h"
+
+class TableCache;
+class MergeIterator;
+
+struct UniversalCompactionOptions
+{
+    //the next older run joins a merge while its size is within this percent
+    //of the runs picked so far
+    unsigned sizeRatio_{1};
+    size_t minMergeWidth_{2};
+    size_t maxMergeWidth_{static_cast<size_t>(-1)};
+    //more sorted runs than this force a merge of the newest ones
+    size_t maxSortedRuns_{8};
+    //every run is merged into one when the newer runs exceed this percent of the oldest
+    unsigned maxSizeAmplificationPercent_{200};
+};
+
+struct FIFOCompactionOptions
+{
+    //the oldest tables are dropped while all tables together are larger, 0 disables
+    uint64_t maxTableFilesSize_{1ull << 30};
+    //tables whose data is older than this many seconds are dropped, 0 disables
+    uint64_t ttl_{0};
+    //merge runs of small recent level 0 files with each other, nothing else is ever merged
+    bool allowCompaction_{false};
+    //files of at least this size are not merged
+    uint64_t maxMergeFileSize_{4 << 20};
+    size_t minMergeWidth_{4};
+};
+
+struct CompactionOptions
+{
+    //output tables are cut at about this size
+    uint64_t targetFileSize_{64 << 20};
+    //versions a snapshot at or above this sequence may read are kept, older ones
+    //shadowed by a newer version are dropped
+    SequenceNumber smallestSnapshot_{kDefaultMaxSequenceNumber};
+    UniversalCompactionOptions universal_;
+    FIFOCompactionOptions fifo_;
+    //sees every value that survives, disabled when null
+    std::shared_ptr<CompactionFilter> compactionFilter_{nullptr};
+};
+
+//inputs are merged into tables of outputLevel_
+struct Compaction
+{
+    std::vector<std::pair<int,FileMeta>> inputs_;
+    int outputLevel_{0};
+    //no data older than the inputs lives below, deletions can go
+    bool bottommost_{false};
+    //inputs are dropped without reading them
+    bool deletionOnly_{false};
+};
+
+//size-tiered compaction: every level 0 file and every non-empty level past 0 is one
+//sorted run, runs of similar size are merged so that each byte is rewritten about once
+//per size tier instead of once per level
+class UniversalCompactionPicker
+{
+private:
+    UniversalCompactionOptions options_;
+
+    struct SortedRun
+    {
+        int level_;
+        //the single file of a level 0 run
+        FileMeta file_;
+        uint64_t size_;
+    };
+
+    //newest first, level 0 files are kept oldest first in the version
+    std::vector<SortedRun> sortedRuns(const Version& version) const;
+
+    //merges runs [first,n) of runs, false when the output has no level to go to: it would
+    //land in level 0 and rank above the newer runs left there
+    bool compactionOf(const Version& version,const std::vector<SortedRun>& runs,size_t first,size_t n,
+                        Compaction* compaction) const;
+public:
+    explicit UniversalCompactionPicker(const UniversalCompactionOptions& options)
+     : options_(options)
+    {
+
+    }
+
+    //false when nothing needs merging
+    bool PickCompaction(const Version& version,Compaction* compaction) const;
+};
+
+//for data that expires as a whole, such as logs and time series: every table stays in
+//level 0 oldest first and is dropped once too old or over the size limit, so data is
+//written about once
+class FIFOCompactionPicker
+{
+private:
+    FIFOCompactionOptions options_;
+public:
+    explicit FIFOCompactionPicker(const FIFOCompactionOptions& options)
+     : options_(options)
+    {
+
+    }
+
+    //drops expired tables first, then the oldest tables over the size limit, then merges
+    //small recent tables when allowed, false when nothing needs doing.
+    //now is in seconds since the epoch
+    bool PickCompaction(const Version& version,uint64_t now,Compaction* compaction) const;
+};
+
+//merges the inputs of a compaction through a MergeIterator into new tables
+class CompactionJob
+{
+private:
+    const std::string dbname_;
+    TableCache& cache_;
+    Options options_;
+    CompactionOptions compactionOptions_;
+    std::atomic<uint64_t>* nextFileNumber_;
+
+    //folds the MERGE entries at it onto the base below them within one snapshot stripe,
+    //without a base they are only combined with each other unless nothing older exists,
+    //leaves it on the first entry it did not consume
+    template<typename F>
+    void mergeOperands(MergeIterator& it,const MergeOperator& mergeOperator,const std::string& userKey,
+                        bool bottommost,SequenceNumber* lastSequenceForKey,F&& emit);
+public:
+    CompactionJob(std::string dbname,TableCache& cache,const Options& options,
+                    const CompactionOptions& compactionOptions,std::atomic<uint64_t>* nextFileNumber);
+
+    //edit gets the inputs removed and the outputs added, on failure the outputs
+    //are deleted and -1 is returned. a deletion only compaction writes nothing,
+    //the caller deletes input files once no reader holds them
+    int Run(const Compaction& compaction,VersionEdit* edit);
+};
@@ -0,0 +1,597 @@
+#include "compaction.h"
+#include "../sstable/table_cache.h"
+#include "../sstable/table_builder.h"
+#include "../util/fname.h"
+#include "../util/TestMergeOperators.h"
+#include <gtest/gtest.h>
+
+#include <map>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+static std::string Key(int i)
+{
+    char buf[32];
+    snprintf(buf,sizeof(buf),"key%06d",i);
+    return buf;
+}
+
+static FileMeta FakeFile(uint64_t number,uint64_t size)
+{
+    FileMeta meta;
+    meta.number_ = number;
+    meta.fileSize_ = size;
+    meta.smallest_ = InternalKey(Key(0),number,OpsType::UPDATE);
+    meta.largest_ = InternalKey(Key(100),number,OpsType::UPDATE);
+    return meta;
+}
+
+TEST(Compaction,UniversalPicker)
+{
+    UniversalCompactionOptions options;
+    UniversalCompactionPicker picker(options);
+    Compaction compaction;
+
+    //four small runs of one size over a large oldest run
+    Version similar;
+    similar.AddFile(kNumLevels - 1,FakeFile(1,1000));
+    for (uint64_t i = 2; i <= 5; i++)
+    {
+        similar.AddFile(0,FakeFile(i,10));
+    }
+    ASSERT_TRUE(picker.PickCompaction(similar,&compaction));
+    ASSERT_EQ(compaction.inputs_.size(),4);
+    ASSERT_EQ(compaction.outputLevel_,kNumLevels - 2);
+    ASSERT_FALSE(compaction.bottommost_);
+    //newest first
+    ASSERT_EQ(compaction.inputs_.front().second.number_,5);
+
+    //sizes growing tenfold leave nothing to merge until there are too many runs
+    Version tiered;
+    tiered.AddFile(kNumLevels - 1,FakeFile(1,100000));
+    tiered.AddFile(3,FakeFile(2,10000));
+    tiered.AddFile(0,FakeFile(3,1000));
+    tiered.AddFile(0,FakeFile(4,100));
+    ASSERT_FALSE(picker.PickCompaction(tiered,&compaction));
+    UniversalCompactionOptions fewRuns;
+    fewRuns.maxSortedRuns_ = 2;
+    ASSERT_TRUE(UniversalCompactionPicker(fewRuns).PickCompaction(tiered,&compaction));
+    ASSERT_EQ(compaction.inputs_.size(),3);
+    ASSERT_EQ(compaction.outputLevel_,3);
+    fewRuns.maxMergeWidth_ = 2;
+    ASSERT_TRUE(UniversalCompactionPicker(fewRuns).PickCompaction(tiered,&compaction));
+    ASSERT_EQ(compaction.inputs_.size(),2);
+    ASSERT_EQ(compaction.outputLevel_,2);
+
+    //runs of similar size behind a small newer one are merged without it
+    Version behind;
+    behind.AddFile(kNumLevels - 1,FakeFile(1,10000000));
+    behind.AddFile(4,FakeFile(2,1000));
+    behind.AddFile(3,FakeFile(3,1000));
+    behind.AddFile(2,FakeFile(4,100000));
+    behind.AddFile(0,FakeFile(5,10));
+    UniversalCompactionOptions narrow;
+    narrow.maxMergeWidth_ = 3;
+    ASSERT_TRUE(UniversalCompactionPicker(narrow).PickCompaction(behind,&compaction));
+    ASSERT_EQ(compaction.inputs_.size(),3);
+    ASSERT_EQ(compaction.inputs_.front().first,2);
+    ASSERT_EQ(compaction.outputLevel_,4);
+    ASSERT_FALSE(compaction.bottommost_);
+
+    //newer runs larger than the oldest merge everything
+    Version amplified;
+    amplified.AddFile(kNumLevels - 1,FakeFile(1,1000));
+    amplified.AddFile(2,FakeFile(2,100000));
+    amplified.AddFile(0,FakeFile(3,10));
+    ASSERT_TRUE(picker.PickCompaction(amplified,&compaction));
+    ASSERT_EQ(compaction.inputs_.size(),3);
+    ASSERT_EQ(compaction.outputLevel_,kNumLevels - 1);
+    ASSERT_TRUE(compaction.bottommost_);
+
+    Version single;
+    single.AddFile(0,FakeFile(1,10));
+    ASSERT_FALSE(picker.PickCompaction(single,&compaction));
+}
+
+TEST(Compaction,FIFOPicker)
+{
+    FIFOCompactionOptions options;
+    options.maxTableFilesSize_ = 1000;
+    options.ttl_ = 3600;
+    Version version;
+    //oldest first, one file of unknown age
+    for (uint64_t i = 1; i <= 6; i++)
+    {
+        FileMeta file = FakeFile(i,300);
+        file.creationTime_ = i == 3 ? 0 : 10000 + i * 1000;
+        version.AddFile(0,file);
+    }
+    Compaction compaction;
+    FIFOCompactionPicker picker(options);
+    //files 1 and 2 passed the ttl
+    ASSERT_TRUE(picker.PickCompaction(version,10000 + 2000 + 3600,&compaction));
+    ASSERT_TRUE(compaction.deletionOnly_);
+    ASSERT_EQ(compaction.inputs_.size(),2);
+    ASSERT_EQ(compaction.inputs_[0].second.number_,1);
+    ASSERT_EQ(compaction.inputs_[1].second.number_,2);
+
+    VersionEdit edit;
+    std::atomic<uint64_t> nextFileNumber{100};
+    TableCache cache("fifo_unused_db",1,Options{});
+    CompactionJob job("fifo_unused_db",cache,Options{},CompactionOptions{},&nextFileNumber);
+    ASSERT_EQ(job.Run(compaction,&edit),0);
+    ASSERT_TRUE(edit.NewFiles().empty());
+    version.Apply(edit);
+    ASSERT_EQ(version.Files(0).size(),4);
+    ASSERT_EQ(nextFileNumber,100);
+
+    //1200 bytes left, the oldest file goes
+    ASSERT_TRUE(picker.PickCompaction(version,0,&compaction));
+    ASSERT_EQ(compaction.inputs_.size(),1);
+    ASSERT_EQ(compaction.inputs_[0].second.number_,3);
+    options.maxTableFilesSize_ = 0;
+    ASSERT_FALSE(FIFOCompactionPicker(options).PickCompaction(version,0,&compaction));
+
+    //small recent files are merged only when allowed, never the large one behind them
+    options.allowCompaction_ = true;
+    options.maxMergeFileSize_ = 200;
+    options.minMergeWidth_ = 3;
+    for (uint64_t i = 7; i <= 9; i++)
+    {
+        version.AddFile(0,FakeFile(i,100));
+    }
+    ASSERT_TRUE(FIFOCompactionPicker(options).PickCompaction(version,0,&compaction));
+    ASSERT_FALSE(compaction.deletionOnly_);
+    ASSERT_EQ(compaction.outputLevel_,0);
+    ASSERT_EQ(compaction.inputs_.size(),3);
+    ASSERT_FALSE(compaction.bottommost_);
+    options.minMergeWidth_ = 4;
+    ASSERT_FALSE(FIFOCompactionPicker(options).PickCompaction(version,0,&compaction));
+}
+
+//entries are (key index, seq, type), in internal key order
+static FileMeta BuildTable(const std::string& dbname,uint64_t number,
+                            const std::vector<std::tuple<int,SequenceNumber,OpsType>>& entries)
+{
+    TableBuilder builder(TableFileName(dbname,number));
+    FileMeta meta;
+    meta.number_ = number;
+    for (const auto & [i,seq,type] : entries)
+    {
+        InternalKey key(Key(i),seq,type);
+        builder.Add(key.Encode(),"value" + std::to_string(i) + "@" + std::to_string(seq));
+        if(meta.largest_ == InternalKey{})
+            meta.smallest_ = key;
+        meta.largest_ = key;
+    }
+    builder.Finish();
+    meta.fileSize_ = builder.FileSize();
+    return meta;
+}
+
+static std::vector<std::string> Contents(TableCache& cache,const Version& version)
+{
+    std::vector<FileMeta> files;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        files.insert(files.end(),version.Files(level).begin(),version.Files(level).end());
+    }
+    MergeIterator it(cache.NewIterators(files,ReadOptions{}));
+    std::vector<std::string> contents;
+    for (it.SeekForFirst(); it.Valid(); it.Next())
+    {
+        std::string key(it.key().substr(0,it.key().size() - 8));
+        switch (ExtractOpsType(it.key()))
+        {
+        case OpsType::DELETE:
+            key += " del";
+            break;
+        case OpsType::MERGE:
+            key += " +" + std::string(it.value());
+            break;
+        default:
+            key += " " + std::string(it.value());
+        }
+        contents.push_back(key);
+    }
+    return contents;
+}
+
+TEST(Compaction,MergeRuns)
+{
+    const std::string dbname = "compaction_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::vector<std::tuple<int,SequenceNumber,OpsType>> old;
+    std::vector<std::tuple<int,SequenceNumber,OpsType>> recent;
+    for (int i = 0; i < 2000; i++)
+    {
+        old.emplace_back(i,i + 1,OpsType::UPDATE);
+        //every third key is deleted, every third overwritten
+        if(i % 3 == 0)
+            recent.emplace_back(i,10000 + i,OpsType::DELETE);
+        else if(i % 3 == 1)
+            recent.emplace_back(i,10000 + i,OpsType::UPDATE);
+    }
+    Version version;
+    FileMeta oldFile = BuildTable(dbname,1,old);
+    FileMeta recentFile = BuildTable(dbname,2,recent);
+    oldFile.creationTime_ = 500;
+    recentFile.creationTime_ = 900;
+    version.AddFile(0,oldFile);
+    version.AddFile(0,recentFile);
+    TableCache cache(dbname,16,Options{});
+
+    CompactionOptions options;
+    options.targetFileSize_ = 16 * 1024;
+    //a snapshot between the two runs keeps the versions it reads
+    options.smallestSnapshot_ = 10000 + 1000;
+    options.universal_.maxSizeAmplificationPercent_ = 50;
+    std::atomic<uint64_t> nextFileNumber{3};
+    UniversalCompactionPicker picker(options.universal_);
+    Compaction compaction;
+    ASSERT_TRUE(picker.PickCompaction(version,&compaction));
+    ASSERT_TRUE(compaction.bottommost_);
+
+    CompactionJob job(dbname,cache,Options{},options,&nextFileNumber);
+    VersionEdit edit;
+    ASSERT_EQ(job.Run(compaction,&edit),0);
+    ASSERT_EQ(edit.DeletedFiles().size(),2);
+    ASSERT_GT(edit.NewFiles().size(),1);
+    Version compacted = version;
+    compacted.Apply(edit);
+    ASSERT_TRUE(compacted.Files(0).empty());
+    ASSERT_EQ(compacted.Files(kNumLevels - 1).size(),edit.NewFiles().size());
+
+    std::vector<std::string> expected;
+    for (int i = 0; i < 2000; i++)
+    {
+        std::string key = Key(i);
+        std::string newer = " value" + std::to_string(i) + "@" + std::to_string(10000 + i);
+        std::string older = " value" + std::to_string(i) + "@" + std::to_string(i + 1);
+        if(i % 3 == 2)
+        {
+            expected.push_back(key + older);
+            continue;
+        }
+        //versions past the snapshot keep the one below them
+        bool newerThanSnapshot = static_cast<SequenceNumber>(10000 + i) > options.smallestSnapshot_;
+        if(i % 3 == 0 && !newerThanSnapshot)
+            continue;
+        expected.push_back(key + (i % 3 == 0 ? " del" : newer));
+        if(newerThanSnapshot)
+            expected.push_back(key + older);
+    }
+    ASSERT_EQ(Contents(cache,compacted),expected);
+    //output tables hold whole user keys
+    const auto& files = compacted.Files(kNumLevels - 1);
+    for (size_t i = 1; i < files.size(); i++)
+    {
+        ASSERT_LT(files[i - 1].largest_.ExtractUserKey(),files[i].smallest_.ExtractUserKey());
+    }
+    //and expire with the oldest input
+    for (const auto & file : files)
+    {
+        ASSERT_EQ(file.creationTime_,500);
+    }
+
+    //without a snapshot only the newest version of each key is left
+    Compaction full;
+    for (const auto & file : files)
+    {
+        full.inputs_.emplace_back(kNumLevels - 1,file);
+    }
+    full.outputLevel_ = kNumLevels - 1;
+    full.bottommost_ = true;
+    CompactionJob latest(dbname,cache,Options{},CompactionOptions{},&nextFileNumber);
+    VersionEdit latestEdit;
+    ASSERT_EQ(latest.Run(full,&latestEdit),0);
+    compacted.Apply(latestEdit);
+    expected.clear();
+    for (int i = 0; i < 2000; i++)
+    {
+        if(i % 3 == 0)
+            continue;
+        SequenceNumber seq = i % 3 == 1 ? 10000 + i : i + 1;
+        expected.push_back(Key(i) + " value" + std::to_string(i) + "@" + std::to_string(seq));
+    }
+    ASSERT_EQ(Contents(cache,compacted),expected);
+}
+
+//drops keys divisible by 5, upper-cases the value of keys divisible by 7
+class TestFilter : public CompactionFilter
+{
+public:
+    mutable std::atomic<int> calls_{0};
+
+    FilterDecision Filter(int level,const std::string_view& userKey,SequenceNumber seq,
+                            const std::string_view& value,std::string* newValue) const override
+    {
+        calls_++;
+        int i = std::stoi(std::string(userKey.substr(3)));
+        if(i % 5 == 0)
+            return FilterDecision::kRemove;
+        if(i % 7 != 0)
+            return FilterDecision::kKeep;
+        for (char c : value)
+        {
+            newValue->push_back(toupper(c));
+        }
+        return FilterDecision::kChangeValue;
+    }
+};
+
+TEST(Compaction,Filter)
+{
+    const std::string dbname = "compaction_filter_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::vector<std::tuple<int,SequenceNumber,OpsType>> entries;
+    for (int i = 0; i < 1000; i++)
+    {
+        entries.emplace_back(i,i + 1,i % 11 == 0 ? OpsType::DELETE : OpsType::UPDATE);
+    }
+    TableCache cache(dbname,16,Options{});
+    auto filter = std::make_shared<TestFilter>();
+    CompactionOptions options;
+    options.compactionFilter_ = filter;
+    std::atomic<uint64_t> nextFileNumber{10};
+    CompactionJob job(dbname,cache,Options{},options,&nextFileNumber);
+
+    for (bool bottommost : {true,false})
+    {
+        Version version;
+        version.AddFile(0,BuildTable(dbname,bottommost ? 1 : 2,entries));
+        Compaction compaction;
+        compaction.inputs_.emplace_back(0,version.Files(0)[0]);
+        compaction.outputLevel_ = bottommost ? kNumLevels - 1 : 1;
+        compaction.bottommost_ = bottommost;
+        filter->calls_ = 0;
+        VersionEdit edit;
+        ASSERT_EQ(job.Run(compaction,&edit),0);
+        version.Apply(edit);
+
+        std::vector<std::string> expected;
+        for (int i = 0; i < 1000; i++)
+        {
+            std::string value = "value" + std::to_string(i) + "@" + std::to_string(i + 1);
+            if(i % 11 == 0)
+            {
+                //deletions skip the filter and stay above the bottom
+                if(!bottommost)
+                    expected.push_back(Key(i) + " del");
+            } else if(i % 5 == 0)
+            {
+                if(!bottommost)
+                    expected.push_back(Key(i) + " del");
+            } else if(i % 7 == 0)
+            {
+                for (auto & c : value)
+                {
+                    c = toupper(c);
+                }
+                expected.push_back(Key(i) + " " + value);
+            } else
+            {
+                expected.push_back(Key(i) + " " + value);
+            }
+        }
+        ASSERT_EQ(Contents(cache,version),expected);
+        ASSERT_EQ(filter->calls_,1000 - 91);
+    }
+}
+
+//removes versions from sequence 4 on
+class NewerFilter : public CompactionFilter
+{
+public:
+    FilterDecision Filter(int,const std::string_view&,SequenceNumber seq,
+                            const std::string_view&,std::string*) const override
+    {
+        return seq >= 4 ? FilterDecision::kRemove : FilterDecision::kKeep;
+    }
+};
+
+TEST(Compaction,FilterVersions)
+{
+    const std::string dbname = "compaction_filter_versions_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    Version version;
+    version.AddFile(0,BuildTable(dbname,1,{{1,10,OpsType::UPDATE},{1,3,OpsType::UPDATE},
+                                            {2,4,OpsType::UPDATE},{2,2,OpsType::UPDATE},
+                                            {3,9,OpsType::UPDATE}}));
+    TableCache cache(dbname,16,Options{});
+    CompactionOptions options;
+    options.compactionFilter_ = std::make_shared<NewerFilter>();
+    options.smallestSnapshot_ = 5;
+    std::atomic<uint64_t> nextFileNumber{2};
+    CompactionJob job(dbname,cache,Options{},options,&nextFileNumber);
+    Compaction compaction;
+    compaction.inputs_.emplace_back(0,version.Files(0)[0]);
+    compaction.outputLevel_ = kNumLevels - 1;
+    compaction.bottommost_ = true;
+    VersionEdit edit;
+    ASSERT_EQ(job.Run(compaction,&edit),0);
+    version.Apply(edit);
+
+    //a removed version past the snapshot becomes a deletion so the one the snapshot
+    //reads does not come back for newer reads
+    ASSERT_EQ(Contents(cache,version),std::vector<std::string>({
+        Key(1) + " del",Key(1) + " value1@3",Key(3) + " del"}));
+    std::string value;
+    ASSERT_EQ(version.Get(cache,InternalKey(Key(1),kDefaultMaxSequenceNumber,OpsType::UPDATE),&value),-1);
+    ASSERT_EQ(version.Get(cache,InternalKey(Key(1),5,OpsType::UPDATE),&value),0);
+    ASSERT_EQ(value,"value1@3");
+    ASSERT_EQ(version.Get(cache,InternalKey(Key(2),kDefaultMaxSequenceNumber,OpsType::UPDATE),&value),-1);
+}
+
+TEST(Compaction,Merge)
+{
+    const std::string dbname = "compaction_merge_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    //operands onto a value, onto a deletion and onto nothing
+    std::vector<std::tuple<int,SequenceNumber,OpsType,std::string>> entries{
+        {0,30,OpsType::MERGE,"1"},{0,20,OpsType::MERGE,"2"},{0,10,OpsType::UPDATE,"10"},{0,5,OpsType::UPDATE,"99"},
+        {1,31,OpsType::MERGE,"5"},{1,11,OpsType::DELETE,""},
+        {2,32,OpsType::MERGE,"3"},{2,22,OpsType::MERGE,"4"},
+        {3,33,OpsType::MERGE,"1"},{3,23,OpsType::MERGE,"2"},{3,13,OpsType::UPDATE,"3"}};
+    FileMeta meta;
+    meta.number_ = 1;
+    {
+        TableBuilder builder(TableFileName(dbname,1));
+        for (const auto & [i,seq,type,value] : entries)
+        {
+            builder.Add(InternalKey(Key(i),seq,type).Encode(),value);
+        }
+        ASSERT_EQ(builder.Finish(),0);
+        meta.fileSize_ = builder.FileSize();
+        meta.smallest_ = InternalKey(Key(0),30,OpsType::MERGE);
+        meta.largest_ = InternalKey(Key(3),13,OpsType::UPDATE);
+    }
+    TableCache cache(dbname,16,Options{});
+    std::atomic<uint64_t> nextFileNumber{2};
+    auto compact = [&](std::shared_ptr<MergeOperator> mergeOperator,bool bottommost,SequenceNumber snapshot){
+        Options options;
+        options.mergeOperator_ = std::move(mergeOperator);
+        CompactionOptions compactionOptions;
+        compactionOptions.smallestSnapshot_ = snapshot;
+        CompactionJob job(dbname,cache,options,compactionOptions,&nextFileNumber);
+        Version version;
+        version.AddFile(0,meta);
+        Compaction compaction;
+        compaction.inputs_.emplace_back(0,meta);
+        compaction.outputLevel_ = bottommost ? kNumLevels - 1 : 1;
+        compaction.bottommost_ = bottommost;
+        VersionEdit edit;
+        EXPECT_EQ(job.Run(compaction,&edit),0);
+        version.Apply(edit);
+        return Contents(cache,version);
+    };
+
+    auto counter = std::make_shared<AddOperator>();
+    ASSERT_EQ(compact(counter,true,kDefaultMaxSequenceNumber),std::vector<std::string>({
+        Key(0) + " 13",Key(1) + " 5",Key(2) + " 7",Key(3) + " 6"}));
+    //older versions may lie in lower levels, operands without a base are only combined
+    ASSERT_EQ(compact(counter,false,kDefaultMaxSequenceNumber),std::vector<std::string>({
+        Key(0) + " 13",Key(1) + " 5",Key(2) + " +7",Key(3) + " 6"}));
+    //a snapshot at 25 still reads the versions below it
+    ASSERT_EQ(compact(counter,false,25),std::vector<std::string>({
+        Key(0) + " +1",Key(0) + " 12",Key(1) + " +5",Key(1) + " del",
+        Key(2) + " +3",Key(2) + " +4",Key(3) + " +1",Key(3) + " 5"}));
+
+    auto append = std::make_shared<AppendOperator>();
+    ASSERT_EQ(compact(append,true,kDefaultMaxSequenceNumber),std::vector<std::string>({
+        Key(0) + " 10,2,1",Key(1) + " 5",Key(2) + " 4,3",Key(3) + " 3,2,1"}));
+    ASSERT_EQ(compact(append,false,kDefaultMaxSequenceNumber),std::vector<std::string>({
+        Key(0) + " 10,2,1",Key(1) + " 5",Key(2) + " +3",Key(2) + " +4",Key(3) + " 3,2,1"}));
+
+    //without an operator the operands are kept as they are
+    ASSERT_EQ(compact(nullptr,false,kDefaultMaxSequenceNumber),std::vector<std::string>({
+        Key(0) + " +1",Key(0) + " +2",Key(0) + " 10",Key(1) + " +5",Key(1) + " del",
+        Key(2) + " +3",Key(2) + " +4",Key(3) + " +1",Key(3) + " +2",Key(3) + " 3"}));
+}
+
+//separated values stay in their blob file unless a filter or a merge needs them
+TEST(Compaction,BlobReferences)
+{
+    const std::string dbname = "compaction_blob_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    auto padded = [](int n){
+        std::string digits = std::to_string(n);
+        return std::string(64 - digits.size(),'0') + digits;
+    };
+    Options options;
+    options.minBlobSize_ = 64;
+    options.mergeOperator_ = std::make_shared<AddOperator>();
+    FileMeta meta;
+    meta.number_ = 1;
+    {
+        BlobFileBuilder blobs(BlobFileName(dbname,2),2,options);
+        TableBuilder builder(TableFileName(dbname,1),options);
+        builder.SetBlobFileBuilder(&blobs);
+        builder.Add(InternalKey(Key(0),300,OpsType::MERGE).Encode(),"5");
+        for (int i = 0; i < 100; i++)
+        {
+            builder.Add(InternalKey(Key(i),i + 1,OpsType::UPDATE).Encode(),padded(i + 10));
+        }
+        ASSERT_EQ(builder.Finish(),0);
+        ASSERT_TRUE(blobs.Finish());
+        meta.fileSize_ = builder.FileSize();
+        meta.smallest_ = InternalKey(Key(0),300,OpsType::MERGE);
+        meta.largest_ = InternalKey(Key(99),100,OpsType::UPDATE);
+    }
+    TableCache cache(dbname,16,options);
+    CompactionOptions compactionOptions;
+    compactionOptions.compactionFilter_ = std::make_shared<TestFilter>();
+    std::atomic<uint64_t> nextFileNumber{3};
+    CompactionJob job(dbname,cache,options,compactionOptions,&nextFileNumber);
+    Version version;
+    version.AddFile(0,meta);
+    Compaction compaction;
+    compaction.inputs_.emplace_back(0,meta);
+    compaction.outputLevel_ = kNumLevels - 1;
+    compaction.bottommost_ = true;
+    VersionEdit edit;
+    ASSERT_EQ(job.Run(compaction,&edit),0);
+    version.Apply(edit);
+
+    ReadOptions raw;
+    raw.resolveBlobs_ = false;
+    MergeIterator it(cache.NewIterators(version.Files(kNumLevels - 1),raw));
+    it.SeekForFirst();
+    //the operand went onto the blob value
+    ASSERT_EQ(it.key(),InternalKey(Key(0),300,OpsType::UPDATE).Encode());
+    ASSERT_EQ(it.value(),"15");
+    it.Next();
+    std::vector<std::string> expected{Key(0) + " 15"};
+    for (int i = 1; i < 100; i++)
+    {
+        if(i % 5 == 0)
+            continue;
+        ASSERT_TRUE(it.Valid());
+        ASSERT_EQ(it.key().substr(0,it.key().size() - 8),Key(i));
+        //values the filter changed are written inline, the others stay references
+        ASSERT_EQ(ExtractOpsType(it.key()),i % 7 == 0 ? OpsType::UPDATE : OpsType::BLOB_INDEX);
+        expected.push_back(Key(i) + " " + padded(i + 10));
+        it.Next();
+    }
+    ASSERT_FALSE(it.Valid());
+    ASSERT_EQ(Contents(cache,version),expected);
+}
+
+TEST(Compaction,CorruptInput)
+{
+    const std::string dbname = "compaction_corrupt_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::vector<std::tuple<int,SequenceNumber,OpsType>> entries;
+    for (int i = 0; i < 20000; i++)
+    {
+        entries.emplace_back(i,i + 1,OpsType::UPDATE);
+    }
+    FileMeta meta = BuildTable(dbname,1,entries);
+    //a flipped byte in the middle fails the checksum of one data block
+    FILE* file = fopen(TableFileName(dbname,1).c_str(),"r+b");
+    ASSERT_NE(file,nullptr);
+    fseek(file,meta.fileSize_ / 2,SEEK_SET);
+    int c = fgetc(file);
+    fseek(file,meta.fileSize_ / 2,SEEK_SET);
+    fputc(c ^ 0xff,file);
+    fclose(file);
+
+    TableCache cache(dbname,16,Options{});
+    std::atomic<uint64_t> nextFileNumber{2};
+    CompactionJob job(dbname,cache,Options{},CompactionOptions{},&nextFileNumber);
+    Compaction compaction;
+    compaction.inputs_.emplace_back(0,meta);
+    compaction.outputLevel_ = kNumLevels - 1;
+    compaction.bottommost_ = true;
+    VersionEdit edit;
+    //the input is kept and no output is left behind
+    ASSERT_EQ(job.Run(compaction,&edit),-1);
+    ASSERT_TRUE(edit.DeletedFiles().empty());
+    ASSERT_TRUE(edit.NewFiles().empty());
+    for (uint64_t number = 2; number < nextFileNumber; number++)
+    {
+        FILE* output = fopen(TableFileName(dbname,number).c_str(),"rb");
+        ASSERT_EQ(output,nullptr);
+    }
+}
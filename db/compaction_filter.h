@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "../util/InternalKey.h"
+
+enum class FilterDecision
+{
+    kKeep,
+    //a deletion takes the entry's place, older versions would show through otherwise.
+    //at the bottom an entry every snapshot reads is dropped along with the older ones
+    kRemove,
+    //the entry is kept with newValue
+    kChangeValue,
+};
+
+//decides the fate of every value a compaction writes, such as dropping expired or soft
+//deleted rows while they are rewritten anyway. deletions are not passed through it.
+//snapshots do not protect a value from it. compactions may run concurrently, so Filter
+//has to be thread safe
+class CompactionFilter
+{
+public:
+    virtual ~CompactionFilter() = default;
+
+    //level is the output level of the compaction
+    virtual FilterDecision Filter(int level,const std::string_view& userKey,SequenceNumber seq,
+                                    const std::string_view& value,std::string* newValue) const = 0;
+};
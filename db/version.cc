@@ -0,0 +1,469 @@
+#include "version.h"
+#include "../sstable/table_cache.h"
+#include "../memtable/memtable.h"
+#include "../sstable/merge.h"
+#include "../util/fname.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+VersionEdit::VersionEdit()
+{
+
+}
+
+VersionEdit::~VersionEdit()
+{
+
+}
+
+void VersionEdit::AddFile(int level,uint64_t file,uint64_t fileSize,
+                            const InternalKey& smallest,const InternalKey& largest)
+{
+    FileMeta meta;
+    meta.number_ = file;
+    meta.fileSize_ = fileSize;
+    meta.smallest_ = smallest;
+    meta.largest_ = largest;
+    newFiles.emplace_back(level,std::move(meta));
+}
+
+Version::Version()
+{
+
+}
+
+Version::~Version()
+{
+
+}
+
+bool Version::AddFile(int level,const FileMeta& file)
+{
+    auto& files = files_[level];
+    if(level == 0)
+    {
+        files.push_back(file);
+        return true;
+    }
+    auto pos = std::lower_bound(files.begin(),files.end(),file,[](const FileMeta& l,const FileMeta& r){
+        return l.smallest_.ExtractUserKey() < r.smallest_.ExtractUserKey();
+    });
+    if(pos != files.end() && pos->smallest_.ExtractUserKey() <= file.largest_.ExtractUserKey())
+        return false;
+    if(pos != files.begin() && std::prev(pos)->largest_.ExtractUserKey() >= file.smallest_.ExtractUserKey())
+        return false;
+    files.insert(pos,file);
+    return true;
+}
+
+void Version::Apply(const VersionEdit& edit)
+{
+    const auto& deleted = edit.DeletedFiles();
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        auto& files = files_[level];
+        files.erase(std::remove_if(files.begin(),files.end(),[&](const FileMeta& file){
+            return deleted.count({level,file.number_}) > 0;
+        }),files.end());
+    }
+    for (const auto & [level,file] : edit.NewFiles())
+    {
+        files_[level].push_back(file);
+    }
+    InternalKeyStringViewComparator compare;
+    for (int level = 1; level < kNumLevels; level++)
+    {
+        std::sort(files_[level].begin(),files_[level].end(),[&](const FileMeta& l,const FileMeta& r){
+            return compare(l.smallest_.Encode(),r.smallest_.Encode()) == 1;
+        });
+    }
+}
+
+int Version::Get(TableCache& cache,const InternalKey& key,std::string* value,MergeContext* context) const
+{
+    MergeContext ownContext;
+    if(context == nullptr)
+        context = &ownContext;
+    const std::string_view userKey = key.ExtractUserKey();
+    std::vector<const FileMeta*> files;
+    for (const auto & file : files_[0])
+    {
+        if(file.smallest_.ExtractUserKey() <= userKey && userKey <= file.largest_.ExtractUserKey())
+            files.push_back(&file);
+    }
+    std::sort(files.begin(),files.end(),[](const FileMeta* l,const FileMeta* r){
+        return l->number_ > r->number_;
+    });
+    for (int level = 1; level < kNumLevels; level++)
+    {
+        for (const auto & file : files_[level])
+        {
+            if(file.smallest_.ExtractUserKey() <= userKey && userKey <= file.largest_.ExtractUserKey())
+            {
+                files.push_back(&file);
+                break;
+            }
+        }
+    }
+
+    std::string newestKey;
+    for (const FileMeta* file : files)
+    {
+        bool deleted = false;
+        int ret = cache.Get(file->number_,file->fileSize_,key.Encode(),context,&newestKey,[value,&deleted](const std::string_view& ikey,const std::string_view& val){
+            deleted = ExtractOpsType(ikey) == OpsType::DELETE;
+            value->assign(val);
+        });
+        if(ret == 0)
+            return deleted ? -1 : 0;
+        if(ret == SSTable::kCorruption)
+            return ret;
+    }
+    if(context->empty() || cache.GetMergeOperator() == nullptr)
+        return -1;
+    if(!context->Fold(*cache.GetMergeOperator(),userKey,nullptr,value))
+        return SSTable::kCorruption;
+    context->Clear();
+    return 0;
+}
+
+void Version::approximateFile(TableCache& cache,const FileMeta& file,const Range& range,
+                                uint64_t* size,uint64_t* keys) const
+{
+    std::string_view smallest = file.smallest_.ExtractUserKey();
+    std::string_view largest = file.largest_.ExtractUserKey();
+    if(largest < range.start_ || smallest >= range.limit_)
+        return;
+    TableProperties properties;
+    bool hasProperties = false;
+    if(file.numEntries_ == 0 || smallest < range.start_ || largest >= range.limit_)
+        hasProperties = cache.GetProperties(file.number_,file.fileSize_,&properties);
+    uint64_t numEntries = file.numEntries_ > 0 ? file.numEntries_ : properties.numEntries_;
+    if(smallest >= range.start_ && largest < range.limit_)
+    {
+        *size += file.fileSize_;
+        *keys += numEntries;
+        return;
+    }
+    uint64_t start = 0;
+    uint64_t limit = 0;
+    InternalKey startKey(range.start_,kDefaultMaxSequenceNumber,kOpsTypeForSeek);
+    InternalKey limitKey(range.limit_,kDefaultMaxSequenceNumber,kOpsTypeForSeek);
+    if(!cache.ApproximateOffsetOf(file.number_,file.fileSize_,startKey.Encode(),&start) ||
+        !cache.ApproximateOffsetOf(file.number_,file.fileSize_,limitKey.Encode(),&limit) || limit <= start)
+        return;
+    *size += limit - start;
+    if(hasProperties && properties.dataSize_ > 0)
+        *keys += numEntries * (limit - start) / properties.dataSize_;
+}
+
+void Version::approximate(TableCache& cache,const Range& range,const MemTable* mem,
+                            uint64_t* size,uint64_t* keys) const
+{
+    *size = 0;
+    *keys = 0;
+    if(range.start_ >= range.limit_)
+        return;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        for (const auto & file : files_[level])
+        {
+            approximateFile(cache,file,range,size,keys);
+        }
+    }
+    if(mem != nullptr)
+    {
+        uint64_t memKeys;
+        uint64_t memSize;
+        mem->ApproximateStats(range.start_,range.limit_,&memKeys,&memSize);
+        *size += memSize;
+        *keys += memKeys;
+    }
+}
+
+std::vector<uint64_t> Version::GetApproximateSizes(TableCache& cache,const std::vector<Range>& ranges,
+                                                    const MemTable* mem) const
+{
+    std::vector<uint64_t> sizes(ranges.size(),0);
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        uint64_t keys;
+        approximate(cache,ranges[i],mem,&sizes[i],&keys);
+    }
+    return sizes;
+}
+
+uint64_t Version::GetApproximateKeys(TableCache& cache,const Range& range,const MemTable* mem) const
+{
+    uint64_t size;
+    uint64_t keys;
+    approximate(cache,range,mem,&size,&keys);
+    return keys;
+}
+
+std::vector<Range> Version::splitRange(TableCache& cache,const Range& range,size_t n) const
+{
+    std::vector<std::string> boundaries;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        for (const auto & file : files_[level])
+        {
+            if(!overlaps(file,range))
+                continue;
+            std::vector<std::string> keys;
+            if(cache.BlockBoundaries(file.number_,file.fileSize_,range.start_,range.limit_,&keys))
+                boundaries.insert(boundaries.end(),std::make_move_iterator(keys.begin()),std::make_move_iterator(keys.end()));
+        }
+    }
+    std::sort(boundaries.begin(),boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(),boundaries.end()),boundaries.end());
+    //a boundary equal to start would give an empty partition
+    if(!boundaries.empty() && boundaries.front() == range.start_)
+        boundaries.erase(boundaries.begin());
+
+    std::vector<Range> partitions;
+    size_t parts = std::min(n,boundaries.size() + 1);
+    std::string start = range.start_;
+    for (size_t i = 1; i < parts; i++)
+    {
+        const std::string& limit = boundaries[i * boundaries.size() / parts];
+        if(limit <= start)
+            continue;
+        partitions.push_back(Range{std::move(start),limit});
+        start = limit;
+    }
+    partitions.push_back(Range{std::move(start),range.limit_});
+    return partitions;
+}
+
+uint64_t Version::ParallelScan(TableCache& cache,const Range& range,const ParallelScanOptions& options,
+                                const ScanCallback& callback) const
+{
+    if(range.start_ >= range.limit_)
+        return 0;
+    size_t threads = std::max<size_t>(options.threads_,1);
+    std::vector<Range> partitions = splitRange(cache,range,threads * std::max<size_t>(options.partitionsPerThread_,1));
+    threads = std::min(threads,partitions.size());
+    std::vector<FileMeta> files;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        for (const auto & file : files_[level])
+        {
+            if(overlaps(file,range))
+                files.push_back(file);
+        }
+    }
+
+    //ordered scans stream each partition through a buffer of up to bufferBytes_ the
+    //caller drains, at most window partitions run ahead of the one being delivered
+    using Entries = std::vector<std::pair<std::string,std::string>>;
+    struct Partition
+    {
+        Entries entries_;
+        size_t bytes_{0};
+        bool done_{false};
+    };
+    std::vector<Partition> results(options.ordered_ ? partitions.size() : 0);
+    const size_t window = 2 * threads;
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next = 0;
+    size_t delivered = 0;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> count{0};
+
+    //entries are handed over in batches to take the lock less often
+    const size_t bufferBytes = std::max<size_t>(options.bufferBytes_,1);
+    const size_t batchBytes = std::max<size_t>(bufferBytes / 8,1);
+    auto handOver = [&](size_t i,Entries& batch,size_t& bytes){
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock,[&](){ return stop || results[i].bytes_ < bufferBytes; });
+        if(!stop)
+        {
+            std::move(batch.begin(),batch.end(),std::back_inserter(results[i].entries_));
+            results[i].bytes_ += bytes;
+            cond.notify_all();
+        }
+        batch.clear();
+        bytes = 0;
+    };
+
+    auto scan = [&](size_t i){
+        ReadOptions readOptions;
+        readOptions.iterateLowerBound_ = partitions[i].start_;
+        readOptions.iterateUpperBound_ = partitions[i].limit_;
+        MergeIterator it(cache.NewIterators(files,readOptions),readOptions);
+        Entries batch;
+        size_t bytes = 0;
+        for (it.SeekForFirst(); it.Valid() && !stop.load(std::memory_order_relaxed); it.Next())
+        {
+            if(options.ordered_)
+            {
+                batch.emplace_back(it.key(),it.value());
+                bytes += it.key().size() + it.value().size();
+                if(bytes >= batchBytes)
+                    handOver(i,batch,bytes);
+            } else if(callback(it.key(),it.value()))
+            {
+                count.fetch_add(1,std::memory_order_relaxed);
+            } else
+            {
+                stop = true;
+            }
+        }
+        if(!batch.empty())
+            handOver(i,batch,bytes);
+    };
+
+    auto worker = [&](){
+        while (true)
+        {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock,[&](){
+                    return stop || next >= partitions.size() || !options.ordered_ || next < delivered + window;
+                });
+                if(stop || next >= partitions.size())
+                    return;
+                i = next++;
+            }
+            scan(i);
+            if(options.ordered_)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[i].done_ = true;
+                cond.notify_all();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back(worker);
+    }
+    if(options.ordered_)
+    {
+        Entries entries;
+        for (size_t i = 0; i < partitions.size() && !stop; i++)
+        {
+            bool done = false;
+            while (!done && !stop)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock,[&](){ return results[i].done_ || !results[i].entries_.empty(); });
+                    //done_ is set after the last hand over, so nothing follows what is taken now
+                    done = results[i].done_;
+                    entries.clear();
+                    entries.swap(results[i].entries_);
+                    results[i].bytes_ = 0;
+                    cond.notify_all();
+                }
+                for (const auto & [key,value] : entries)
+                {
+                    if(!callback(key,value))
+                    {
+                        stop = true;
+                        break;
+                    }
+                    count++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            delivered++;
+            cond.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+    }
+    for (auto & t : workers)
+    {
+        t.join();
+    }
+    return count;
+}
+
+//-1 unless the table looks like the output of a standalone TableBuilder
+static int validateExternalFile(const std::string& path,const IngestOptions& options,TableProperties* properties)
+{
+    std::shared_ptr<SSTable> table = SSTable::newTable(path,Options{});
+    if(!table->isOpen() || table->Properties() == nullptr)
+        return -1;
+    *properties = *table->Properties();
+    //blob references would point into files that are not ingested along
+    if(properties->numEntries_ == 0 || properties->maxSequence_ != 0 ||
+        properties->numBlobIndexes_ > 0 || properties->globalSequence_ != 0)
+        return -1;
+    if(!options.verifyBlocks_)
+        return 0;
+    InternalKeyStringViewComparator compare;
+    std::unique_ptr<SSTable::Iterator> it(table->newIterator());
+    std::string last;
+    uint64_t entries = 0;
+    for (it->SeekForFirst(); it->Valid(); it->Next())
+    {
+        if(entries++ > 0 && compare(last,it->key()) != 1)
+            return -1;
+        last = it->key();
+    }
+    return entries == properties->numEntries_ ? 0 : -1;
+}
+
+int Version::IngestExternalFile(TableCache& cache,const std::string& path,uint64_t fileNumber,SequenceNumber seq,
+                                const IngestOptions& options)
+{
+    TableProperties properties;
+    if(seq == 0 || validateExternalFile(path,options,&properties) != 0)
+        return -1;
+    InternalKey smallest;
+    InternalKey largest;
+    smallest.DecodeFrom(properties.smallestKey_);
+    largest.DecodeFrom(properties.largestKey_);
+    std::string_view smallestUserKey = smallest.ExtractUserKey();
+    std::string_view largestUserKey = largest.ExtractUserKey();
+
+    int target = 0;
+    for (int level = 0; level < kNumLevels; level++)
+    {
+        bool overlapped = std::any_of(files_[level].begin(),files_[level].end(),[&](const FileMeta& file){
+            return file.largest_.ExtractUserKey() >= smallestUserKey && file.smallest_.ExtractUserKey() <= largestUserKey;
+        });
+        if(overlapped)
+            break;
+        target = level;
+    }
+
+    //only the DB's file is stamped unless the caller hands the source over
+    std::string fileName = TableFileName(cache.DBName(),fileNumber);
+    bool placed = options.moveFile_ && LinkFile(path,fileName);
+    if(!placed && (!options.moveFile_ || errno == EXDEV))
+        placed = CopyFile(path,fileName);
+    if(!placed)
+        return -1;
+    if(SSTable::WriteGlobalSequence(fileName,seq) != 0)
+    {
+        std::remove(fileName.c_str());
+        return -1;
+    }
+
+    FileMeta meta;
+    meta.number_ = fileNumber;
+    meta.fileSize_ = RandomAccessFile(fileName).Size();
+    meta.numEntries_ = properties.numEntries_;
+    meta.creationTime_ = properties.creationTime_;
+    meta.smallest_ = InternalKey(smallestUserKey,seq,ExtractOpsType(properties.smallestKey_));
+    meta.largest_ = InternalKey(largestUserKey,seq,ExtractOpsType(properties.largestKey_));
+    VersionEdit edit;
+    edit.AddFile(target,meta);
+    Apply(edit);
+    return target;
+}
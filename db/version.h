@@ -3,15 +3,35 @@
 #include <set>
 #include <vector>
 #include <utility>
+#include <string>
+#include <string_view>
+#include <functional>
 
 #include "../util/InternalKey.h"
+#include "../util/Options.h"
+
+static constexpr int kNumLevels = 7;
 
 struct FileMeta
 {
     uint64_t number_{0};
     uint64_t fileSize_{0};
+    //from the table's properties, 0 when unknown
+    uint64_t numEntries_{0};
+    //seconds since the epoch when the oldest data of the file was written, 0 when unknown
+    uint64_t creationTime_{0};
     InternalKey largest_;
     InternalKey smallest_;
+
+    //false when every key of the file is outside the scan bounds
+    bool OverlapsBounds(const ReadOptions& options) const
+    {
+        if(options.iterateUpperBound_ && smallest_.ExtractUserKey() >= *options.iterateUpperBound_)
+            return false;
+        if(options.iterateLowerBound_ && largest_.ExtractUserKey() < *options.iterateLowerBound_)
+            return false;
+        return true;
+    }
 };
 
 
@@ -19,8 +39,9 @@ class VersionEdit
 {
 private:
     using DeletedFileSet = std::set<std::pair<int,uint64_t>>;
-    SequenceNumber lastSequence_;
+    SequenceNumber lastSequence_{0};
     std::vector<std::pair<int,FileMeta>> newFiles;
+    DeletedFileSet deletedFiles_;
 public:
     VersionEdit();
     ~VersionEdit();
@@ -28,24 +49,140 @@ public:
     void AddFile(int level,uint64_t file,uint64_t fileSize,
                     const InternalKey& smallest,const InternalKey& largest);
 
+    void AddFile(int level,const FileMeta& file)
+    {
+        newFiles.emplace_back(level,file);
+    }
+
+    void RemoveFile(int level,uint64_t file)
+    {
+        deletedFiles_.emplace(level,file);
+    }
+
+    void SetLastSequence(SequenceNumber seq)
+    {
+        lastSequence_ = seq;
+    }
+
+    SequenceNumber LastSequence() const
+    {
+        return lastSequence_;
+    }
+
+    const std::vector<std::pair<int,FileMeta>>& NewFiles() const
+    {
+        return newFiles;
+    }
+
+    const DeletedFileSet& DeletedFiles() const
+    {
+        return deletedFiles_;
+    }
+};
+
+
 
-    void RemoveFile();
+class TableCache;
+class MemTable;
+class MergeContext;
+
+//user keys [start, limit)
+struct Range
+{
+    std::string start_;
+    std::string limit_;
 };
 
+struct ParallelScanOptions
+{
+    size_t threads_{4};
+    //the range is cut into up to threads_ * partitionsPerThread_ partitions, more of
+    //them even out skew between workers
+    size_t partitionsPerThread_{4};
+    //the callback runs in key order on the calling thread, otherwise concurrently
+    //on the workers in no particular order
+    bool ordered_{false};
+    //an ordered scan's worker waits while this many bytes of its partition wait for the
+    //caller, the buffers of all partitions in flight bound the memory of the scan
+    size_t bufferBytes_{1 << 20};
+};
 
+struct IngestOptions
+{
+    //reads every block to check checksums, key order and the entry count before adding
+    bool verifyBlocks_{false};
+    //hard links the table instead of copying it. the link shares the inode, so the file at
+    //the source path is stamped too and belongs to the DB from then on. a copy is made
+    //when the DB is on another filesystem
+    bool moveFile_{false};
+};
+
+//gets internal keys, returns false to stop the scan
+using ScanCallback = std::function<bool(const std::string_view& key,const std::string_view& value)>;
 
 class Version
 {
 private:
+    std::vector<FileMeta> files_[kNumLevels];
+
+    //bytes and entries of the file in range, whole files are counted from their meta,
+    //files the range cuts are measured on their index
+    void approximateFile(TableCache& cache,const FileMeta& file,const Range& range,
+                            uint64_t* size,uint64_t* keys) const;
 
+    void approximate(TableCache& cache,const Range& range,const MemTable* mem,
+                        uint64_t* size,uint64_t* keys) const;
+
+    bool overlaps(const FileMeta& file,const Range& range) const
+    {
+        return file.largest_.ExtractUserKey() >= range.start_ && file.smallest_.ExtractUserKey() < range.limit_;
+    }
+
+    //cuts range at data block boundaries of the overlapping tables into about n
+    //partitions, the index is read but no data block
+    std::vector<Range> splitRange(TableCache& cache,const Range& range,size_t n) const;
 public:
     Version();
     ~Version();
 
-    FileMeta* Get(const InternalKey& key,std::string& val);
-
-    
-
+    //looks key up from the newest table down, level 0 newest file first. context holds the
+    //operands a newer source, e.g. MemTable::Get, left for the key, they and the tables' are
+    //folded onto the first base value, onto none when no table has one.
+    //0 if found, -1 if not or deleted, SSTable::kCorruption if a table or blob cannot be
+    //read or a merge failed
+    int Get(TableCache& cache,const InternalKey& key,std::string* value,MergeContext* context = nullptr) const;
+
+    //files of levels past 0 are kept sorted by key, false when the file overlaps one of them
+    bool AddFile(int level,const FileMeta& file);
+
+    const std::vector<FileMeta>& Files(int level) const
+    {
+        return files_[level];
+    }
+
+    //removes the deleted files and adds the new ones, files of levels past 0 stay sorted by key
+    void Apply(const VersionEdit& edit);
+
+    //bytes each range covers in the tables, and in mem when given, no data block is read
+    std::vector<uint64_t> GetApproximateSizes(TableCache& cache,const std::vector<Range>& ranges,
+                                                const MemTable* mem = nullptr) const;
+
+    //entries in range, duplicates across levels and versions of a key are all counted
+    uint64_t GetApproximateKeys(TableCache& cache,const Range& range,const MemTable* mem = nullptr) const;
+
+    //scans range with one bounded merge iterator per partition on a pool of threads,
+    //every version of every key is passed on as a merge iterator would,
+    //returns the number of entries handed to callback
+    uint64_t ParallelScan(TableCache& cache,const Range& range,const ParallelScanOptions& options,
+                            const ScanCallback& callback) const;
+
+    //copies or links the table at path into the DB directory as fileNumber without rewriting its
+    //entries and adds it to the deepest level that neither it nor any level above overlaps,
+    //level 0 when that does. the table comes from a standalone TableBuilder with every key at
+    //sequence 0 and the DB's file is stamped with seq, which must be newer than every key of
+    //the version and of the memtable. returns the level or -1 when the table is rejected
+    int IngestExternalFile(TableCache& cache,const std::string& path,uint64_t fileNumber,SequenceNumber seq,
+                            const IngestOptions& options = IngestOptions{});
 };
 
 
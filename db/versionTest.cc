@@ -0,0 +1,347 @@
+#include "version.h"
+#include "../sstable/table_cache.h"
+#include "../sstable/table_builder.h"
+#include "../sstable/merge.h"
+#include "../sstable/blob_file.h"
+#include "../memtable/memtable.h"
+#include "../util/fname.h"
+#include "../util/TestMergeOperators.h"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <algorithm>
+
+static std::string Key(int i)
+{
+    char buf[32];
+    snprintf(buf,sizeof(buf),"key%06d",i);
+    return buf;
+}
+
+static FileMeta BuildTable(const std::string& dbname,uint64_t number,int first,int last)
+{
+    TableBuilder builder(TableFileName(dbname,number));
+    FileMeta meta;
+    meta.number_ = number;
+    for (int i = first; i < last; i++)
+    {
+        InternalKey key(Key(i),i + 1,OpsType::UPDATE);
+        builder.Add(key.Encode(),std::string(100,'a' + i % 26));
+        if(i == first)
+            meta.smallest_ = key;
+        meta.largest_ = key;
+    }
+    builder.Finish();
+    meta.fileSize_ = builder.FileSize();
+    return meta;
+}
+
+TEST(Version,ApproximateSizes)
+{
+    const std::string dbname = "version_approx_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    Version version;
+    //level 0 overlaps the first file of level 1
+    FileMeta l0 = BuildTable(dbname,1,0,5000);
+    FileMeta l1a = BuildTable(dbname,2,0,5000);
+    FileMeta l1b = BuildTable(dbname,3,5000,10000);
+    //only one file carries its entry count, the others read it from their properties
+    l1b.numEntries_ = 5000;
+    ASSERT_TRUE(version.AddFile(0,l0));
+    ASSERT_TRUE(version.AddFile(1,l1b));
+    ASSERT_TRUE(version.AddFile(1,l1a));
+    //level 1 stays sorted and overlaps are rejected there, level 0 takes them
+    ASSERT_EQ(version.Files(1)[0].number_,2);
+    ASSERT_FALSE(version.AddFile(1,BuildTable(dbname,4,4000,6000)));
+    ASSERT_EQ(version.Files(1).size(),2);
+
+    Options options;
+    options.blockCache_ = ShardedLRUCache::NewCache(1024);
+    options.compression_ = CompressionType::kNoCompression;
+    TableCache cache(dbname,16,options);
+
+    std::vector<Range> ranges{{Key(2000),Key(4000)},{Key(5000),Key(999999)},{"zzz","zzzz"},{Key(4000),Key(2000)}};
+    std::vector<uint64_t> sizes = version.GetApproximateSizes(cache,ranges);
+    ASSERT_EQ(sizes.size(),ranges.size());
+    //2000 keys in two files, each about a fifth of the 5000-key files
+    ASSERT_NEAR(sizes[0],(l0.fileSize_ + l1a.fileSize_) * 2 / 5.0,l0.fileSize_ * 0.05);
+    ASSERT_EQ(sizes[1],l1b.fileSize_);
+    ASSERT_EQ(sizes[2],0);
+    ASSERT_EQ(sizes[3],0);
+
+    ASSERT_NEAR(version.GetApproximateKeys(cache,ranges[0]),4000,200);
+    ASSERT_EQ(version.GetApproximateKeys(cache,ranges[1]),5000);
+    ASSERT_NEAR(version.GetApproximateKeys(cache,{Key(0),Key(999999)}),15000,200);
+    //only index and properties blocks were read
+    ASSERT_EQ(options.blockCache_->TotalCharge(),0);
+
+    //the memtable is sampled
+    MemTable mem;
+    for (int i = 0; i < 20000; i++)
+    {
+        mem.Add(Key(i),std::string(100,'m'),100000 + i);
+    }
+    uint64_t memKeys = version.GetApproximateKeys(cache,{Key(10000),Key(14000)},&mem);
+    ASSERT_GT(memKeys,4000 * 0.5);
+    ASSERT_LT(memKeys,4000 * 1.5);
+    std::vector<uint64_t> memSizes = version.GetApproximateSizes(cache,{{Key(10000),Key(14000)}},&mem);
+    ASSERT_EQ(memSizes[0],memKeys * (Key(0).size() + 8 + 100));
+}
+
+TEST(Version,ParallelScan)
+{
+    const std::string dbname = "version_scan_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    Version version;
+    //newer versions of part of the keys on level 0
+    version.AddFile(0,BuildTable(dbname,1,3000,6000));
+    version.AddFile(1,BuildTable(dbname,2,0,5000));
+    version.AddFile(1,BuildTable(dbname,3,5000,10000));
+    TableCache cache(dbname,16,Options{});
+
+    Range range{Key(1234),Key(8765)};
+    std::vector<FileMeta> files{version.Files(0)[0],version.Files(1)[0],version.Files(1)[1]};
+    ReadOptions readOptions;
+    readOptions.iterateLowerBound_ = range.start_;
+    readOptions.iterateUpperBound_ = range.limit_;
+    MergeIterator it(cache.NewIterators(files,readOptions),readOptions);
+    std::vector<std::pair<std::string,std::string>> expected;
+    for (it.SeekForFirst(); it.Valid(); it.Next())
+    {
+        expected.emplace_back(it.key(),it.value());
+    }
+    ASSERT_EQ(expected.size(),8765 - 1234 + 6000 - 3000);
+
+    ParallelScanOptions options;
+    options.ordered_ = true;
+    std::vector<std::pair<std::string,std::string>> ordered;
+    ASSERT_EQ(version.ParallelScan(cache,range,options,[&](const std::string_view& key,const std::string_view& value){
+        ordered.emplace_back(key,value);
+        return true;
+    }),expected.size());
+    ASSERT_EQ(ordered,expected);
+    //buffers of a few entries make the workers wait for the caller
+    options.bufferBytes_ = 1024;
+    ordered.clear();
+    ASSERT_EQ(version.ParallelScan(cache,range,options,[&](const std::string_view& key,const std::string_view& value){
+        ordered.emplace_back(key,value);
+        return true;
+    }),expected.size());
+    ASSERT_EQ(ordered,expected);
+
+    options.ordered_ = false;
+    std::mutex mutex;
+    std::vector<std::pair<std::string,std::string>> unordered;
+    ASSERT_EQ(version.ParallelScan(cache,range,options,[&](const std::string_view& key,const std::string_view& value){
+        std::lock_guard<std::mutex> lock(mutex);
+        unordered.emplace_back(key,value);
+        return true;
+    }),expected.size());
+    InternalKeyStringViewComparator compare;
+    std::sort(unordered.begin(),unordered.end(),[&](const auto& l,const auto& r){
+        return compare(l.first,r.first) == 1;
+    });
+    ASSERT_EQ(unordered,expected);
+
+    //the callback stops an ordered scan right away
+    options.ordered_ = true;
+    size_t seen = 0;
+    ASSERT_EQ(version.ParallelScan(cache,range,options,[&](const std::string_view&,const std::string_view&){
+        return ++seen < 100;
+    }),99);
+    ASSERT_EQ(seen,100);
+    ASSERT_EQ(version.ParallelScan(cache,{Key(5),Key(5)},options,[](const std::string_view&,const std::string_view&){
+        return true;
+    }),0);
+}
+
+static void BuildExternalTable(const std::string& path,int first,int last)
+{
+    TableBuilder builder(path);
+    for (int i = first; i < last; i++)
+    {
+        builder.Add(InternalKey(Key(i),0,OpsType::UPDATE).Encode(),"external" + std::to_string(i));
+    }
+    ASSERT_EQ(builder.Finish(),0);
+}
+
+TEST(Version,IngestExternalFile)
+{
+    const std::string dbname = "version_ingest_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    Version version;
+    version.AddFile(1,BuildTable(dbname,1,0,5000));
+    version.AddFile(2,BuildTable(dbname,2,5000,10000));
+    TableCache cache(dbname,16,Options{});
+
+    BuildExternalTable(dbname + "/external1",20000,21000);
+    BuildExternalTable(dbname + "/external2",7000,7500);
+    BuildExternalTable(dbname + "/external3",4000,4500);
+    //nothing overlaps, below level 2 overlaps, level 1 overlaps
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/external1",10,20001),kNumLevels - 1);
+    IngestOptions options;
+    options.verifyBlocks_ = true;
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/external2",11,20002,options),1);
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/external3",12,20003),0);
+    const FileMeta& meta = version.Files(1).back();
+    ASSERT_EQ(meta.number_,11);
+    ASSERT_EQ(meta.numEntries_,500);
+    ASSERT_EQ(meta.smallest_,InternalKey(Key(7000),20002,OpsType::UPDATE));
+    ASSERT_EQ(meta.largest_,InternalKey(Key(7499),20002,OpsType::UPDATE));
+
+    //keys read with the global sequence and only from lookups at or above it
+    std::string value;
+    SequenceNumber seq = 0;
+    auto handle = [&](const std::string_view& key,const std::string_view& val){
+        value = val;
+        seq = ExtractSequence(key);
+    };
+    ASSERT_TRUE(cache.Get(11,meta.fileSize_,InternalKey(Key(7100),kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),handle));
+    ASSERT_EQ(value,"external7100");
+    ASSERT_EQ(seq,20002);
+    ASSERT_TRUE(cache.Get(11,meta.fileSize_,InternalKey(Key(7100),20002,OpsType::UPDATE).Encode(),handle));
+    ASSERT_FALSE(cache.Get(11,meta.fileSize_,InternalKey(Key(7100),20001,OpsType::UPDATE).Encode(),handle));
+    //a seek below the global sequence lands on the next key, the version of its own key sorts before it
+    std::shared_ptr<SSTable::Iterator> ingested = cache.NewIterator(11,meta.fileSize_,ReadOptions{});
+    InternalKey below(Key(7100),20001,kOpsTypeForSeek);
+    ingested->Seek(below.Encode());
+    ASSERT_TRUE(ingested->Valid());
+    ASSERT_EQ(ingested->key(),InternalKey(Key(7101),20002,OpsType::UPDATE).Encode());
+    InternalKey at(Key(7100),20002,kOpsTypeForSeek);
+    ingested->Seek(at.Encode());
+    ASSERT_TRUE(ingested->Valid());
+    ASSERT_EQ(ingested->key(),InternalKey(Key(7100),20002,OpsType::UPDATE).Encode());
+
+    //a merged scan sees the ingested version of a key before the old one
+    ReadOptions readOptions;
+    readOptions.iterateLowerBound_ = Key(4000);
+    readOptions.iterateUpperBound_ = Key(4001);
+    std::vector<FileMeta> files{version.Files(0)[0],version.Files(1)[0]};
+    MergeIterator it(cache.NewIterators(files,readOptions),readOptions);
+    it.SeekForFirst();
+    ASSERT_TRUE(it.Valid());
+    ASSERT_EQ(ExtractSequence(it.key()),20003);
+    ASSERT_EQ(it.value(),"external4000");
+    it.Next();
+    ASSERT_TRUE(it.Valid());
+    ASSERT_EQ(ExtractSequence(it.key()),4001);
+    it.Next();
+    ASSERT_FALSE(it.Valid());
+
+    //level 1 stays sorted by key
+    BuildExternalTable(dbname + "/external4",6000,6500);
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/external4",14,20005),1);
+    ASSERT_EQ(version.Files(1).size(),3);
+    ASSERT_EQ(version.Files(1)[1].number_,14);
+    ASSERT_EQ(version.Files(1)[2].number_,11);
+
+    //a copied source is left as it was
+    std::shared_ptr<SSTable> source = SSTable::newTable(dbname + "/external1");
+    ASSERT_EQ(source->Properties()->globalSequence_,0);
+
+    //a moved source is stamped with the DB's file, tables with sequences of their own
+    //or already ingested are rejected
+    BuildExternalTable(dbname + "/external5",30000,30100);
+    IngestOptions move;
+    move.moveFile_ = true;
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/external5",15,20006,move),kNumLevels - 1);
+    ASSERT_EQ(version.IngestExternalFile(cache,TableFileName(dbname,1),13,20004),-1);
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/external5",13,20004),-1);
+    ASSERT_EQ(version.IngestExternalFile(cache,dbname + "/missing",13,20004),-1);
+    ASSERT_EQ(version.Files(kNumLevels - 1).size(),2);
+}
+
+struct TableEntry
+{
+    std::string key_;
+    SequenceNumber seq_;
+    OpsType type_;
+    std::string value_;
+};
+
+static FileMeta BuildTable(const std::string& dbname,uint64_t number,const std::vector<TableEntry>& entries,
+                            const Options& options,BlobFileBuilder* blobs = nullptr)
+{
+    TableBuilder builder(TableFileName(dbname,number),options);
+    if(blobs != nullptr)
+        builder.SetBlobFileBuilder(blobs);
+    FileMeta meta;
+    meta.number_ = number;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        InternalKey key(entries[i].key_,entries[i].seq_,entries[i].type_);
+        builder.Add(key.Encode(),entries[i].value_);
+        if(i == 0)
+            meta.smallest_ = key;
+        meta.largest_ = key;
+    }
+    builder.Finish();
+    meta.fileSize_ = builder.FileSize();
+    return meta;
+}
+
+TEST(Version,Get)
+{
+    const std::string dbname = "version_get_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    Options options;
+    options.mergeOperator_ = std::make_shared<AppendOperator>();
+    options.minBlobSize_ = 1024;
+    options.compression_ = CompressionType::kNoCompression;
+    const std::string large(2000,'x');
+
+    BlobFileBuilder blobs(BlobFileName(dbname,2),2,options);
+    VersionEdit edit;
+    edit.AddFile(1,BuildTable(dbname,1,{
+        {"a",1,OpsType::UPDATE,"base"},
+        {"b",2,OpsType::UPDATE,large},
+        {"c",3,OpsType::MERGE,"x"},
+        {"d",4,OpsType::UPDATE,"old"},
+    },options,&blobs));
+    ASSERT_TRUE(blobs.Finish());
+    edit.AddFile(0,BuildTable(dbname,3,{
+        {"a",10,OpsType::MERGE,"1"},
+        {"b",11,OpsType::MERGE,"2"},
+        {"c",12,OpsType::MERGE,"y"},
+        {"d",13,OpsType::DELETE,""},
+        {"e",14,OpsType::MERGE,"z"},
+    },options));
+    edit.AddFile(0,BuildTable(dbname,4,{{"a",20,OpsType::MERGE,"2"}},options));
+    Version version;
+    version.Apply(edit);
+    TableCache cache(dbname,16,options);
+
+    //operands are carried from the newer tables down to the base value
+    auto get = [&version,&cache](const std::string& k,std::string* value,SequenceNumber seq = kDefaultMaxSequenceNumber){
+        return version.Get(cache,InternalKey(k,seq,OpsType::UPDATE),value);
+    };
+    std::string value;
+    ASSERT_EQ(get("a",&value),0);
+    ASSERT_EQ(value,"base,1,2");
+    ASSERT_EQ(get("a",&value,15),0);
+    ASSERT_EQ(value,"base,1");
+    //onto a value in a blob file
+    ASSERT_EQ(get("b",&value),0);
+    ASSERT_EQ(value,large + ",2");
+    //onto none when no table has a base value
+    ASSERT_EQ(get("c",&value),0);
+    ASSERT_EQ(value,"x,y");
+    ASSERT_EQ(get("e",&value),0);
+    ASSERT_EQ(value,"z");
+    ASSERT_EQ(get("d",&value),-1);
+    ASSERT_EQ(get("f",&value),-1);
+
+    //a single table does not fold the operands it cannot resolve
+    ASSERT_FALSE(cache.Get(3,version.Files(0)[0].fileSize_,InternalKey("c",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),
+        [](const std::string_view&,const std::string_view&){}));
+
+    //the memtable's operands go first
+    MemTable mem(options.mergeOperator_);
+    mem.Merge("a","3",30);
+    MergeContext context;
+    ASSERT_FALSE(mem.Get("a",value,&context));
+    ASSERT_EQ(version.Get(cache,InternalKey("a",kDefaultMaxSequenceNumber,OpsType::UPDATE),&value,&context),0);
+    ASSERT_EQ(value,"base,1,2,3");
+}
@@ -1,29 +1,70 @@
 #include "memtable.h"
 
 #include <iostream>
+#include <algorithm>
+void MemTable::add(std::string_view key,std::string_view value,SequenceNumber seq,OpsType type)
+{
+    if(storage_.insert(InternalKey(key,seq,type),std::string(value)))
+    {
+        entries_.fetch_add(1,std::memory_order_relaxed);
+        dataSize_.fetch_add(key.size() + 8 + value.size(),std::memory_order_relaxed);
+    }
+}
+
 void MemTable::Add(std::string_view key,std::string_view value,SequenceNumber seq)
 {
-    storage_.insert(InternalKey(key,seq,OpsType::UPDATE),std::string(value));
+    add(key,value,seq,OpsType::UPDATE);
+}
+
+void MemTable::Merge(std::string_view key,std::string_view operand,SequenceNumber seq)
+{
+    add(key,operand,seq,OpsType::MERGE);
+}
+
+void MemTable::ApproximateStats(const std::string_view& start,const std::string_view& limit,
+                                uint64_t* count,uint64_t* size) const
+{
+    InternalKey startKey(start,kDefaultMaxSequenceNumber,kOpsTypeForSeek);
+    InternalKey limitKey(limit,kDefaultMaxSequenceNumber,kOpsTypeForSeek);
+    uint64_t entries = entries_.load(std::memory_order_relaxed);
+    *count = std::min<uint64_t>(storage_.ApproximateCount(startKey,limitKey),entries);
+    *size = entries == 0 ? 0 : *count * (dataSize_.load(std::memory_order_relaxed) / entries);
 }
 
 bool MemTable::Get(std::string_view key,std::string& value)
 {
-    InternalKey ikey(key,kDefaultMaxSequenceNumber,OpsType::UPDATE);
-    auto it = newIterator();
-    it->Seek(ikey);
-    InternalKey findKey = it->key();
-    if(findKey.ExtractUserKey() == key)
-    {
-        value = it->value();
-        delete it;
+    MergeContext context;
+    if(Get(key,value,&context))
         return true;
-    } else
-    {
-        delete it;
+    if(context.empty() || mergeOperator_ == nullptr)
         return false;
-    }
-  
+    return context.Fold(*mergeOperator_,key,nullptr,&value);
+}
 
+bool MemTable::Get(std::string_view key,std::string& value,MergeContext* context)
+{
+    InternalKey ikey(key,kDefaultMaxSequenceNumber,kOpsTypeForSeek);
+    std::unique_ptr<IteratorBase<InternalKey,std::string_view>> it(newIterator());
+    for (it->Seek(ikey); it->Valid() && it->key().ExtractUserKey() == key; it->Next())
+    {
+        InternalKey::ParsedInternalKey parsed;
+        it->key().ParseInternalKey(parsed);
+        if(parsed.type_ != OpsType::MERGE || mergeOperator_ == nullptr)
+        {
+            if(context->empty())
+            {
+                value = it->value();
+                return true;
+            }
+            std::string_view base = it->value();
+            if(!context->Fold(*mergeOperator_,key,&base,&value))
+                return false;
+            context->Clear();
+            return true;
+        }
+        context->PushOperand(it->value());
+    }
+    return false;
 }
 
 class MemTable::IteratorImpl : public IteratorBase<InternalKey,std::string_view>
@@ -4,17 +4,28 @@
 #include "../util/Compare.h"
 #include "../util/IteratorBase.h"
 #include "../util/InternalKey.h"
+#include "../util/MergeOperator.h"
 #include <string_view>
+#include <atomic>
+#include <memory>
 
 class MemTable
 {
 private:
     using KVSkipList = SkipList<InternalKey,std::string,InternalKeyComparator>;
     KVSkipList storage_;     
+    //entries and their key plus value bytes, for size estimates
+    std::atomic<uint64_t> entries_{0};
+    std::atomic<uint64_t> dataSize_{0};
+    //folds MERGE entries in Get, null keeps the newest entry as it is
+    std::shared_ptr<MergeOperator> mergeOperator_;
     class IteratorImpl;
+
+    void add(std::string_view key,std::string_view value,SequenceNumber seq,OpsType type);
 public:
-    MemTable()
-     : storage_(InternalKeyComparator{})
+    explicit MemTable(std::shared_ptr<MergeOperator> mergeOperator = nullptr)
+     : storage_(InternalKeyComparator{}),
+       mergeOperator_(std::move(mergeOperator))
     {
         
     }
@@ -32,9 +43,22 @@ public:
 
     void Add(std::string_view key,std::string_view value,SequenceNumber seq);
 
+    //operand for the MergeOperator, folded onto the older versions on reads
+    void Merge(std::string_view key,std::string_view operand,SequenceNumber seq);
+
+    //operands without a base value in the memtable are folded onto none
     bool Get(std::string_view key,std::string& value);
+
+    //true when the memtable resolves the key. otherwise its operands, if any, are
+    //pushed onto context and the lookup goes on in the tables
+    bool Get(std::string_view key,std::string& value,MergeContext* context);
     
     IteratorBase<InternalKey,std::string_view>* newIterator();
+
+    //entries and bytes with user keys in [start,limit), sampled from the skiplist's
+    //upper levels, bytes assume the average entry size
+    void ApproximateStats(const std::string_view& start,const std::string_view& limit,
+                            uint64_t* count,uint64_t* size) const;
     
 };
 
@@ -4,6 +4,7 @@
 #include <random>
 #include <iostream>
 #include "memtable.h"
+#include "../util/TestMergeOperators.h"
 
 static std::string_view RandomString()
 {
@@ -92,4 +93,46 @@ TEST(MemTable,SequenceTest)
     std::string value;
     table.Get(randomKey,value);
     ASSERT_EQ(value,std::to_string(i - 1));
-}
\ No newline at end of file
+}
+
+TEST(MemTable,Merge)
+{
+    auto op = std::make_shared<AddOperator>();
+    MemTable table(op);
+    table.Add("counter","10",1);
+    table.Merge("counter","5",2);
+    table.Merge("counter","-3",3);
+    std::string value;
+    ASSERT_TRUE(table.Get("counter",value));
+    ASSERT_EQ(value,"12");
+    //a newer value hides the older operands
+    table.Add("counter","1",4);
+    table.Merge("counter","1",5);
+    ASSERT_TRUE(table.Get("counter",value));
+    ASSERT_EQ(value,"2");
+
+    table.Merge("fresh","7",6);
+    table.Merge("fresh","1",7);
+    ASSERT_TRUE(table.Get("fresh",value));
+    ASSERT_EQ(value,"8");
+    ASSERT_FALSE(table.Get("missing",value));
+
+    //with a context the operands wait for the older value in the tables
+    MergeContext context;
+    ASSERT_FALSE(table.Get("fresh",value,&context));
+    ASSERT_EQ(context.size(),2);
+    std::string_view base = "100";
+    ASSERT_TRUE(context.Fold(*op,"fresh",&base,&value));
+    ASSERT_EQ(value,"108");
+    context.Clear();
+    ASSERT_TRUE(table.Get("counter",value,&context));
+    ASSERT_EQ(value,"2");
+    ASSERT_TRUE(context.empty());
+
+    //without an operator the newest operand is read as it is
+    MemTable plain;
+    plain.Add("k","1",1);
+    plain.Merge("k","2",2);
+    ASSERT_TRUE(plain.Get("k",value));
+    ASSERT_EQ(value,"2");
+}
@@ -54,6 +54,8 @@ private:
     Fn compare_;
     uint16_t currentHeight_;
     static constexpr uint16_t kDefaultMaxHeight = 12;
+    //a node reaches level i with probability kBranching^-i
+    static constexpr uint16_t kBranching = 4;
     Node* head_;
 
     bool lessThan(const KeyType& l,const KeyType& r) const
@@ -87,6 +89,27 @@ private:
         
     }
 
+    //first node >= key among the nodes that reach stopLevel
+    Node* findEqualOrGraterAt(const KeyType& key,uint16_t stopLevel) const
+    {
+        Node* current = head_;
+        uint16_t level = currentHeight_ - 1;
+        while (true)
+        {
+            Node* next = current->Next(level);
+            if(next != nullptr && lessThan(next->key(),key))
+            {
+                current = next;
+            } else if (level == stopLevel)
+            {
+                return next;
+            } else
+            {
+                level--;
+            }
+        }
+    }
+
     Node* findLessThan(const KeyType& key) const
     {
         uint16_t level = currentHeight_;
@@ -122,7 +145,6 @@ private:
 
     int16_t randomHeight()
     {
-        static constexpr uint16_t kBranching = 4;
         int height = 1;
         while (height < kDefaultMaxHeight && std::rand() % kBranching == 0)
             height++;
@@ -201,6 +223,30 @@ public:
         return true;
     }
 
+    //number of keys in [start,limit), counted on the highest level that has enough
+    //nodes in the range and scaled up, walks a few dozen nodes whatever the range size
+    size_t ApproximateCount(const KeyType& start,const KeyType& limit) const
+    {
+        static constexpr size_t kMinSamples = 64;
+        size_t scale = 1;
+        for (uint16_t i = 1; i < currentHeight_; i++)
+        {
+            scale *= kBranching;
+        }
+        for (int level = currentHeight_ - 1; level >= 0; level--,scale /= kBranching)
+        {
+            size_t count = 0;
+            for (Node* node = findEqualOrGraterAt(start,level);
+                    node != nullptr && lessThan(node->key(),limit); node = node->Next(level))
+            {
+                count++;
+            }
+            if(count >= kMinSamples || level == 0)
+                return count * scale;
+        }
+        return 0;
+    }
+
     std::pair<bool,ValueType> find(const KeyType& key)
     {
         Node* node = findEqualOrGrater(key,nullptr);
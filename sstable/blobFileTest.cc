@@ -0,0 +1,280 @@
+#include "blob_file.h"
+#include "blob_gc.h"
+#include "table_cache.h"
+#include "../util/fname.h"
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+static std::string RandomValue(std::mt19937& generator,size_t size)
+{
+    std::string value(size,0);
+    for (auto & c : value)
+    {
+        c = 'a' + generator() % 26;
+    }
+    return value;
+}
+
+static uint64_t FileSize(const std::string& fileName)
+{
+    struct stat st;
+    ::stat(fileName.c_str(),&st);
+    return st.st_size;
+}
+
+TEST(blob,BuildAndRead)
+{
+    const std::string dbname = "blob_file_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::mt19937 generator(1);
+    std::vector<std::pair<std::string,std::string>> blobs;
+    std::vector<BlobIndex> indexes;
+    BlobFileBuilder builder(BlobFileName(dbname,7),7);
+    for (size_t i = 0; i < 100; i++)
+    {
+        blobs.emplace_back("key" + std::to_string(i),RandomValue(generator,generator() % 8192));
+        indexes.push_back(builder.Add(blobs.back().first,blobs.back().second));
+    }
+    ASSERT_TRUE(builder.Finish());
+    ASSERT_EQ(builder.FileSize(),FileSize(builder.FileName()));
+
+    BlobFileReader reader(BlobFileName(dbname,7));
+    ASSERT_TRUE(reader.isOpen());
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        ASSERT_EQ(indexes[i].fileNumber_,7);
+        std::string encoded;
+        indexes[i].EncodeTo(encoded);
+        BlobIndex decoded;
+        ASSERT_TRUE(decoded.DecodeFrom(encoded));
+        std::string value;
+        ASSERT_TRUE(reader.Get(decoded,&value));
+        ASSERT_EQ(value,blobs[i].second);
+    }
+    size_t n = 0;
+    ASSERT_TRUE(reader.ForEach([&](const std::string_view& key,const std::string_view& value,const BlobIndex& index){
+        ASSERT_EQ(key,blobs[n].first);
+        ASSERT_EQ(value,blobs[n].second);
+        ASSERT_EQ(index.offset_,indexes[n].offset_);
+        n++;
+    }));
+    ASSERT_EQ(n,blobs.size());
+
+    //a reference past the end and a corrupted record
+    std::string value;
+    BlobIndex past = indexes.back();
+    past.offset_ += past.size_;
+    ASSERT_FALSE(reader.Get(past,&value));
+    {
+        int fd = ::open(BlobFileName(dbname,7).c_str(),O_WRONLY);
+        char c = 0;
+        ::pwrite(fd,&c,1,indexes[3].offset_ + kBlobRecordHeaderSize + 1);
+        ::close(fd);
+    }
+    BlobFileReader corrupted(BlobFileName(dbname,7));
+    ASSERT_FALSE(corrupted.Get(indexes[3],&value));
+    ASSERT_TRUE(corrupted.Get(indexes[4],&value));
+}
+
+//large values of a table go to a blob file, reads see them as ordinary values
+TEST(blob,SeparatedValues)
+{
+    const std::string dbname = "blob_table_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::mt19937 generator(2);
+    std::map<std::string,std::string> kvMap;
+    uint64_t totalValueSize = 0;
+    for (size_t i = 0; i < 1000; i++)
+    {
+        char key[32];
+        snprintf(key,sizeof(key),"key%06zu",i);
+        kvMap[key] = RandomValue(generator,i % 4 == 0 ? 16 : 4096 + generator() % 4096);
+        totalValueSize += kvMap[key].size();
+    }
+
+    Options options;
+    options.minBlobSize_ = 1024;
+    options.compression_ = CompressionType::kNoCompression;
+    BlobFileBuilder blobs(BlobFileName(dbname,2),2,options);
+    TableBuilder builder(TableFileName(dbname,1),options);
+    builder.SetBlobFileBuilder(&blobs);
+    SequenceNumber seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        builder.Add(InternalKey(k,seq++,OpsType::UPDATE).Encode(),v);
+    }
+    ASSERT_EQ(builder.Finish(),0);
+    ASSERT_TRUE(blobs.Finish());
+    ASSERT_EQ(blobs.BlobsNum(),750);
+    //the table holds only references for the large values
+    ASSERT_LT(builder.FileSize() * 20,totalValueSize);
+
+    TableCache cache(dbname,16,options);
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        std::string value;
+        OpsType type = OpsType::DELETE;
+        ASSERT_TRUE(cache.Get(1,builder.FileSize(),ikey.Encode(),[&](const std::string_view& key,const std::string_view& val){
+            value = val;
+            type = ExtractOpsType(key);
+        }));
+        ASSERT_EQ(value,v);
+        ASSERT_EQ(type,OpsType::UPDATE);
+    }
+    //a snapshot at the sequence of a blob reference sees it
+    auto second = std::next(kvMap.begin());
+    std::string exactValue;
+    ASSERT_TRUE(cache.Get(1,builder.FileSize(),InternalKey(second->first,2,OpsType::UPDATE).Encode(),[&exactValue](const std::string_view&,const std::string_view& val){
+        exactValue = val;
+    }));
+    ASSERT_EQ(exactValue,second->second);
+
+    std::vector<std::string> ikeys;
+    for (const auto & [k,v] : kvMap)
+    {
+        ikeys.push_back(std::string(InternalKey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode()));
+    }
+    std::vector<std::string_view> keys(ikeys.begin(),ikeys.end());
+    std::vector<std::string> values(keys.size());
+    std::vector<bool> results;
+    cache.MultiGet(1,builder.FileSize(),keys,results,[&values](size_t i,const std::string_view&,const std::string_view& value){
+        values[i] = value;
+    });
+    size_t i = 0;
+    for (const auto & [k,v] : kvMap)
+    {
+        ASSERT_TRUE(results[i]);
+        ASSERT_EQ(values[i++],v);
+    }
+
+    std::shared_ptr<SSTable::Iterator> it = cache.NewIterator(1,builder.FileSize(),ReadOptions{});
+    it->SeekForFirst();
+    for (const auto & [k,v] : kvMap)
+    {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(it->key().substr(0,it->key().size() - 8),k);
+        ASSERT_EQ(ExtractOpsType(it->key()),OpsType::UPDATE);
+        ASSERT_EQ(it->value(),v);
+        it->Next();
+    }
+    ASSERT_FALSE(it->Valid());
+
+    //a missing blob file is an error, not a miss
+    cache.GetBlobCache()->Evict(2);
+    std::remove(BlobFileName(dbname,2).c_str());
+    InternalKey large("key000001",kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    ASSERT_FALSE(cache.Get(1,builder.FileSize(),large.Encode(),[](const std::string_view&,const std::string_view&){}));
+    InternalKey small("key000000",kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    ASSERT_TRUE(cache.Get(1,builder.FileSize(),small.Encode(),[](const std::string_view&,const std::string_view&){}));
+    //an iterator stops at the first reference it cannot read instead of showing it
+    std::shared_ptr<SSTable::Iterator> broken = cache.NewIterator(1,builder.FileSize(),ReadOptions{});
+    broken->SeekForFirst();
+    ASSERT_TRUE(broken->Valid());
+    ASSERT_EQ(broken->key().substr(0,broken->key().size() - 8),"key000000");
+    ASSERT_FALSE(broken->Corrupted());
+    broken->Next();
+    ASSERT_FALSE(broken->Valid());
+    ASSERT_TRUE(broken->Corrupted());
+}
+
+TEST(blob,GarbageCollection)
+{
+    const std::string dbname = "blob_gc_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    std::mt19937 generator(3);
+    std::map<std::string,std::string> kvMap;
+    for (size_t i = 0; i < 400; i++)
+    {
+        char key[32];
+        snprintf(key,sizeof(key),"key%06zu",i);
+        kvMap[key] = RandomValue(generator,2048);
+    }
+    Options options;
+    options.minBlobSize_ = 1024;
+
+    //table 1 and blob file 2 hold every key
+    FileMeta first;
+    first.number_ = 1;
+    {
+        BlobFileBuilder blobs(BlobFileName(dbname,2),2,options);
+        TableBuilder builder(TableFileName(dbname,1),options);
+        builder.SetBlobFileBuilder(&blobs);
+        SequenceNumber seq = 1;
+        for (const auto & [k,v] : kvMap)
+        {
+            builder.Add(InternalKey(k,seq++,OpsType::UPDATE).Encode(),v);
+        }
+        ASSERT_EQ(builder.Finish(),0);
+        ASSERT_TRUE(blobs.Finish());
+        first.fileSize_ = builder.FileSize();
+    }
+    //table 3 keeps every other key of table 1, as a compaction dropping deleted keys would
+    FileMeta second;
+    second.number_ = 3;
+    {
+        std::shared_ptr<SSTable> table = SSTable::newTable(TableFileName(dbname,1),options,1);
+        std::unique_ptr<SSTable::Iterator> it(table->newIterator());
+        TableBuilder builder(TableFileName(dbname,3),options);
+        size_t i = 0;
+        for (it->SeekForFirst(); it->Valid(); it->Next())
+        {
+            if(i++ % 2 == 0)
+                builder.Add(it->key(),it->value());
+        }
+        ASSERT_EQ(builder.Finish(),0);
+        second.fileSize_ = builder.FileSize();
+    }
+
+    TableCache cache(dbname,16,options);
+    BlobGarbageCollector collector(dbname,cache.GetBlobCache(),options);
+    std::map<uint64_t,uint64_t> liveBytes;
+    ASSERT_EQ(collector.LiveBytes({first},liveBytes),0);
+    ASSERT_EQ(liveBytes[2],FileSize(BlobFileName(dbname,2)));
+    liveBytes.clear();
+    ASSERT_EQ(collector.LiveBytes({second},liveBytes),0);
+    ASSERT_NEAR(liveBytes[2] * 2.0,FileSize(BlobFileName(dbname,2)),4096);
+    std::set<uint64_t> picked = collector.PickFiles(liveBytes,{2},0.6);
+    ASSERT_EQ(picked,std::set<uint64_t>{2});
+    ASSERT_TRUE(collector.PickFiles(liveBytes,{2},0.4).empty());
+
+    //table 4 and blob file 5 replace table 3 and blob file 2
+    FileMeta relocated;
+    relocated.number_ = 4;
+    {
+        BlobFileBuilder blobs(BlobFileName(dbname,5),5,options);
+        TableBuilder builder(TableFileName(dbname,4),options);
+        ASSERT_EQ(collector.Relocate(second,picked,builder,blobs),0);
+        ASSERT_EQ(builder.Finish(),0);
+        ASSERT_TRUE(blobs.Finish());
+        relocated.fileSize_ = builder.FileSize();
+        ASSERT_EQ(blobs.BlobsNum(),kvMap.size() / 2);
+    }
+    ASSERT_NEAR(FileSize(BlobFileName(dbname,5)) * 2.0,FileSize(BlobFileName(dbname,2)),4096);
+    cache.GetBlobCache()->Evict(2);
+    std::remove(BlobFileName(dbname,2).c_str());
+
+    size_t i = 0;
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        std::string value;
+        bool found = cache.Get(4,relocated.fileSize_,ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+            value = val;
+        });
+        ASSERT_EQ(found,i++ % 2 == 0);
+        if(found)
+        {
+            ASSERT_EQ(value,v);
+        }
+    }
+    liveBytes.clear();
+    ASSERT_EQ(collector.LiveBytes({relocated},liveBytes),0);
+    ASSERT_EQ(liveBytes.size(),1);
+    ASSERT_EQ(liveBytes[5],FileSize(BlobFileName(dbname,5)));
+}
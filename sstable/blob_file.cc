@@ -0,0 +1,169 @@
+#include "blob_file.h"
+#include "../util/checksum.h"
+#include "../util/format.h"
+#include "../util/fname.h"
+
+void BlobIndex::EncodeTo(std::string& dst) const
+{
+    AppendUINT64(dst,fileNumber_);
+    AppendUINT64(dst,offset_);
+    AppendUINT64(dst,size_);
+}
+
+bool BlobIndex::DecodeFrom(const std::string_view& src)
+{
+    if(src.size() != kEncodedLength)
+        return false;
+    memcpy(&fileNumber_,src.data(),sizeof(uint64_t));
+    memcpy(&offset_,src.data() + sizeof(uint64_t),sizeof(uint64_t));
+    memcpy(&size_,src.data() + 2 * sizeof(uint64_t),sizeof(uint64_t));
+    return size_ >= kBlobRecordHeaderSize + kBlobRecordTrailerSize;
+}
+
+BlobFileBuilder::BlobFileBuilder(std::string fileName,uint64_t fileNumber,const Options& options)
+ : fileName_(std::move(fileName)),
+   fileNumber_(fileNumber),
+   file_(std::make_unique<WritableFile>(fileName_,options.tableWriteBufferSize_,options.bytesPerSync_)),
+   ok_(file_->isOpen())
+{
+
+}
+
+BlobIndex BlobFileBuilder::Add(const std::string_view& userKey,const std::string_view& value)
+{
+    record_.clear();
+    AppendUINT32(record_,userKey.size());
+    AppendUINT32(record_,value.size());
+    record_.append(userKey);
+    record_.append(value);
+    AppendUINT32(record_,CRC32C(record_.data(),record_.size()));
+    BlobIndex index{fileNumber_,file_->Size(),record_.size()};
+    ok_ = ok_ && file_->Append(record_);
+    blobsNum_++;
+    return index;
+}
+
+bool BlobFileBuilder::Finish()
+{
+    ok_ = ok_ && file_->Sync() && file_->Close();
+    return ok_;
+}
+
+BlobFileReader::BlobFileReader(std::string fileName,bool verifyChecksums)
+ : file_(std::move(fileName)),
+   verifyChecksums_(verifyChecksums)
+{
+
+}
+
+bool BlobFileReader::readRecord(const BlobIndex& index,std::string& record,std::string_view& key,std::string_view& value) const
+{
+    if(index.size_ < kBlobRecordHeaderSize + kBlobRecordTrailerSize || index.offset_ + index.size_ > file_.Size())
+        return false;
+    record.resize(index.size_);
+    char* data = record.data();
+    if(!file_.Read(index.offset_,index.size_,data))
+        return false;
+    uint32_t keySize;
+    uint32_t valueSize;
+    memcpy(&keySize,data,sizeof(keySize));
+    memcpy(&valueSize,data + sizeof(keySize),sizeof(valueSize));
+    if(kBlobRecordHeaderSize + static_cast<uint64_t>(keySize) + valueSize + kBlobRecordTrailerSize != index.size_)
+        return false;
+    if(verifyChecksums_)
+    {
+        uint32_t crc;
+        memcpy(&crc,data + index.size_ - kBlobRecordTrailerSize,sizeof(crc));
+        if(crc != CRC32C(data,index.size_ - kBlobRecordTrailerSize))
+            return false;
+    }
+    key = std::string_view(data + kBlobRecordHeaderSize,keySize);
+    value = std::string_view(data + kBlobRecordHeaderSize + keySize,valueSize);
+    return true;
+}
+
+bool BlobFileReader::Get(const BlobIndex& index,std::string* value) const
+{
+    std::string record;
+    std::string_view key;
+    std::string_view val;
+    if(!readRecord(index,record,key,val))
+        return false;
+    value->assign(val.data(),val.size());
+    return true;
+}
+
+static void blobFileDeleter(const std::string& key,void* value)
+{
+    BlobFileReader* reader = static_cast<BlobFileReader*>(value);
+    delete reader;
+}
+
+BlobCache::BlobCache(const std::string& dbname,int entries,const Options& options)
+ : dbname_(dbname),
+   cache_(new ShardedLRUCache(entries)),
+   verifyChecksums_(options.verifyChecksums_)
+{
+
+}
+
+BlobCache::~BlobCache()
+{
+    delete cache_;
+}
+
+Entry* BlobCache::findFile(uint64_t fileNumber)
+{
+    std::string key;
+    AppendUINT64(key,fileNumber);
+    Entry* entry = cache_->Lookup(key);
+    if(entry == nullptr)
+    {
+        BlobFileReader* reader = new BlobFileReader(BlobFileName(dbname_,fileNumber),verifyChecksums_);
+        if(!reader->isOpen())
+        {
+            delete reader;
+            return nullptr;
+        }
+        entry = cache_->Insert(key,reader,1,blobFileDeleter);
+    }
+    return entry;
+}
+
+bool BlobCache::Get(const BlobIndex& index,std::string* value)
+{
+    Entry* entry = findFile(index.fileNumber_);
+    if(entry == nullptr)
+        return false;
+    BlobFileReader* reader = static_cast<BlobFileReader*>(entry->value_);
+    bool ok = reader->Get(index,value);
+    cache_->Release(entry);
+    return ok;
+}
+
+void BlobCache::Evict(uint64_t fileNumber)
+{
+    std::string key;
+    AppendUINT64(key,fileNumber);
+    cache_->Erase(key);
+}
+
+void BlobResolvingIterator::resolve() const
+{
+    if(resolved_)
+        return;
+    resolved_ = true;
+    isBlob_ = false;
+    failed_ = false;
+    std::string_view ikey = it_->key();
+    if(ExtractOpsType(ikey) != OpsType::BLOB_INDEX)
+        return;
+    if(!blobCache_->Resolve(it_->value(),&value_))
+    {
+        failed_ = true;
+        return;
+    }
+    key_.assign(ikey.data(),ikey.size());
+    SetOpsType(key_,OpsType::UPDATE);
+    isBlob_ = true;
+}
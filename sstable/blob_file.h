@@ -0,0 +1,199 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include "../util/Options.h"
+#include "../util/FileSystem.h"
+#include "../util/LRUCache.h"
+#include "../util/IteratorBase.h"
+#include "../util/InternalKey.h"
+
+//where a separated value lives, stored as the value of a BLOB_INDEX entry
+struct BlobIndex
+{
+    uint64_t fileNumber_{0};
+    //offset and size of the whole record
+    uint64_t offset_{0};
+    uint64_t size_{0};
+
+    static constexpr size_t kEncodedLength = 3 * sizeof(uint64_t);
+
+    void EncodeTo(std::string& dst) const;
+
+    bool DecodeFrom(const std::string_view& src);
+};
+
+//blob file layout: [record]...
+//record: keySize(uint32) | valueSize(uint32) | user key | value | crc32c(uint32) over the rest
+//the key lets garbage collection tell which entry a record belongs to
+static constexpr size_t kBlobRecordHeaderSize = 2 * sizeof(uint32_t);
+static constexpr size_t kBlobRecordTrailerSize = sizeof(uint32_t);
+
+//appends separated values, files are never modified once finished
+class BlobFileBuilder
+{
+private:
+    std::string fileName_;
+    uint64_t fileNumber_;
+    std::unique_ptr<WritableFile> file_;
+    bool ok_;
+    uint64_t blobsNum_{0};
+    std::string record_;
+public:
+    BlobFileBuilder(std::string fileName,uint64_t fileNumber,const Options& options = Options{});
+    ~BlobFileBuilder() = default;
+
+    BlobFileBuilder(const BlobFileBuilder&) = delete;
+    BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+    //the reference is only usable when ok() still holds after Finish
+    BlobIndex Add(const std::string_view& userKey,const std::string_view& value);
+
+    bool Finish();
+
+    bool ok() const { return ok_; }
+
+    uint64_t FileNumber() const { return fileNumber_; }
+
+    uint64_t FileSize() const { return file_->Size(); }
+
+    uint64_t BlobsNum() const { return blobsNum_; }
+
+    const std::string& FileName() const { return fileName_; }
+};
+
+class BlobFileReader
+{
+private:
+    RandomAccessFile file_;
+    bool verifyChecksums_;
+public:
+    explicit BlobFileReader(std::string fileName,bool verifyChecksums = true);
+
+    bool isOpen() const { return file_.isOpen(); }
+
+    //false on a failed read, a checksum mismatch or a reference outside the file
+    bool Get(const BlobIndex& index,std::string* value) const;
+
+    //calls handle(userKey,value,index) for every record in file order,
+    //stops at the end or at the first bad record and returns false for the latter
+    template<typename F>
+    bool ForEach(F&& handle) const
+    {
+        uint64_t offset = 0;
+        std::string record;
+        while (offset < file_.Size())
+        {
+            char header[kBlobRecordHeaderSize];
+            if(!file_.Read(offset,sizeof(header),header))
+                return false;
+            uint32_t keySize;
+            uint32_t valueSize;
+            memcpy(&keySize,header,sizeof(keySize));
+            memcpy(&valueSize,header + sizeof(keySize),sizeof(valueSize));
+            BlobIndex index{0,offset,kBlobRecordHeaderSize + keySize + valueSize + kBlobRecordTrailerSize};
+            std::string_view key;
+            std::string_view value;
+            if(!readRecord(index,record,key,value))
+                return false;
+            handle(key,value,index);
+            offset += index.size_;
+        }
+        return true;
+    }
+
+private:
+    bool readRecord(const BlobIndex& index,std::string& record,std::string_view& key,std::string_view& value) const;
+};
+
+//open blob files keyed by file number, shared by every reader of a DB
+class BlobCache
+{
+private:
+    const std::string dbname_;
+    ShardedLRUCache* cache_;
+    bool verifyChecksums_;
+
+    Entry* findFile(uint64_t fileNumber);
+public:
+    BlobCache(const std::string& dbname,int entries,const Options& options = Options{});
+    ~BlobCache();
+
+    BlobCache(const BlobCache&) = delete;
+    BlobCache& operator=(const BlobCache&) = delete;
+
+    bool Get(const BlobIndex& index,std::string* value);
+
+    //the value of a BLOB_INDEX entry
+    bool Resolve(const std::string_view& encodedIndex,std::string* value)
+    {
+        BlobIndex index;
+        return index.DecodeFrom(encodedIndex) && Get(index,value);
+    }
+
+    void Evict(uint64_t fileNumber);
+};
+
+//reads values of BLOB_INDEX entries from their blob files, the entries then look like UPDATEs.
+//at an entry whose blob cannot be read the iterator turns invalid and Corrupted
+class BlobResolvingIterator : public IteratorBase<std::string_view,std::string_view>
+{
+private:
+    using Iterator = IteratorBase<std::string_view,std::string_view>;
+    std::shared_ptr<Iterator> it_;
+    std::shared_ptr<BlobCache> blobCache_;
+    //resolved on first access of the current entry
+    mutable bool resolved_{false};
+    mutable bool isBlob_{false};
+    mutable bool failed_{false};
+    mutable std::string key_;
+    mutable std::string value_;
+
+    void resolve() const;
+public:
+    BlobResolvingIterator(std::shared_ptr<Iterator> it,std::shared_ptr<BlobCache> blobCache)
+     : it_(std::move(it)),
+       blobCache_(std::move(blobCache))
+    {
+
+    }
+
+    bool Valid() const override
+    {
+        if(!it_->Valid())
+            return false;
+        resolve();
+        return !failed_;
+    }
+
+    void SeekForFirst() override { resolved_ = false; it_->SeekForFirst(); }
+
+    void SeekForLast() override { resolved_ = false; it_->SeekForLast(); }
+
+    void Seek(const std::string_view& target) override { resolved_ = false; it_->Seek(target); }
+
+    void Next() override { resolved_ = false; it_->Next(); }
+
+    void Prev() override { resolved_ = false; it_->Prev(); }
+
+    std::string_view key() const override
+    {
+        resolve();
+        return isBlob_ ? std::string_view(key_) : it_->key();
+    }
+
+    std::string_view value() const override
+    {
+        resolve();
+        return isBlob_ ? std::string_view(value_) : it_->value();
+    }
+
+    bool Corrupted() const override
+    {
+        return failed_ || it_->Corrupted();
+    }
+};
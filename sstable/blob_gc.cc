@@ -0,0 +1,81 @@
+#include "blob_gc.h"
+#include "table.h"
+#include "../util/fname.h"
+
+#include <sys/stat.h>
+
+BlobGarbageCollector::BlobGarbageCollector(std::string dbname,std::shared_ptr<BlobCache> blobCache,const Options& options)
+ : dbname_(std::move(dbname)),
+   blobCache_(std::move(blobCache)),
+   options_(options)
+{
+
+}
+
+int BlobGarbageCollector::LiveBytes(const std::vector<FileMeta>& tables,std::map<uint64_t,uint64_t>& liveBytes) const
+{
+    for (const auto & meta : tables)
+    {
+        std::shared_ptr<SSTable> table = SSTable::newTable(TableFileName(dbname_,meta.number_),options_,meta.number_);
+        if(!table->isOpen())
+            return -1;
+        std::unique_ptr<SSTable::Iterator> it(table->newIterator());
+        for (it->SeekForFirst(); it->Valid(); it->Next())
+        {
+            if(ExtractOpsType(it->key()) != OpsType::BLOB_INDEX)
+                continue;
+            BlobIndex index;
+            if(!index.DecodeFrom(it->value()))
+                return -1;
+            liveBytes[index.fileNumber_] += index.size_;
+        }
+    }
+    return 0;
+}
+
+std::set<uint64_t> BlobGarbageCollector::PickFiles(const std::map<uint64_t,uint64_t>& liveBytes,
+                                                    const std::vector<uint64_t>& blobFiles,double minLiveRatio) const
+{
+    std::set<uint64_t> picked;
+    for (uint64_t number : blobFiles)
+    {
+        struct stat st;
+        if(::stat(BlobFileName(dbname_,number).c_str(),&st) != 0 || st.st_size == 0)
+            continue;
+        auto it = liveBytes.find(number);
+        uint64_t live = it == liveBytes.end() ? 0 : it->second;
+        if(live < minLiveRatio * st.st_size)
+            picked.insert(number);
+    }
+    return picked;
+}
+
+int BlobGarbageCollector::Relocate(const FileMeta& meta,const std::set<uint64_t>& gcFiles,
+                                    TableBuilder& builder,BlobFileBuilder& blobs) const
+{
+    std::shared_ptr<SSTable> table = SSTable::newTable(TableFileName(dbname_,meta.number_),options_,meta.number_);
+    if(!table->isOpen())
+        return -1;
+    std::unique_ptr<SSTable::Iterator> it(table->newIterator());
+    std::string value;
+    std::string encoded;
+    for (it->SeekForFirst(); it->Valid(); it->Next())
+    {
+        std::string_view key = it->key();
+        BlobIndex index;
+        if(ExtractOpsType(key) != OpsType::BLOB_INDEX || !index.DecodeFrom(it->value()) ||
+            gcFiles.count(index.fileNumber_) == 0)
+        {
+            builder.Add(key,it->value());
+            continue;
+        }
+        if(!blobCache_->Get(index,&value))
+            return -1;
+        encoded.clear();
+        blobs.Add(key.substr(0,key.size() - 8),value).EncodeTo(encoded);
+        if(!blobs.ok())
+            return -1;
+        builder.Add(key,encoded);
+    }
+    return 0;
+}
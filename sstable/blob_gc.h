@@ -0,0 +1,39 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "blob_file.h"
+#include "table_builder.h"
+#include "../db/version.h"
+#include "../util/Options.h"
+
+//blob files only ever grow, values overwritten or deleted stay behind as garbage
+//the collector measures how much of each file is still referenced and moves the live
+//values out of mostly dead files so that those can be deleted
+class BlobGarbageCollector
+{
+private:
+    const std::string dbname_;
+    std::shared_ptr<BlobCache> blobCache_;
+    Options options_;
+public:
+    BlobGarbageCollector(std::string dbname,std::shared_ptr<BlobCache> blobCache,const Options& options = Options{});
+
+    //record bytes each blob file holds for the BLOB_INDEX entries of the tables,
+    //the tables must be every live table of the DB, -1 when one cannot be read
+    int LiveBytes(const std::vector<FileMeta>& tables,std::map<uint64_t,uint64_t>& liveBytes) const;
+
+    //blob files whose live bytes fell below minLiveRatio of their size
+    std::set<uint64_t> PickFiles(const std::map<uint64_t,uint64_t>& liveBytes,
+                                    const std::vector<uint64_t>& blobFiles,double minLiveRatio) const;
+
+    //copies table into builder, values held in gcFiles move to blobs and the copy references
+    //them there, every other entry is copied unchanged, -1 on a failed read or write
+    //the caller finishes builder and blobs, then swaps the tables and deletes gcFiles
+    int Relocate(const FileMeta& table,const std::set<uint64_t>& gcFiles,
+                    TableBuilder& builder,BlobFileBuilder& blobs) const;
+};
@@ -1,8 +1,15 @@
 #include "block.h"
+#include "../util/Hash.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOCK_PREFIX_SIMD 1
+#endif
+
 using KeyLengType = uint32_t;
 static constexpr size_t LengthStore = sizeof(KeyLengType);
 using ValueLengType = KeyLengType;
@@ -36,6 +43,127 @@ static const char* locateWithRestartIndex(uint32_t index,uint32_t restartNum,uin
 }
 
 
+//the user key prefix as a number that orders like the bytes
+static uint64_t keyPrefix(const std::string_view& key)
+{
+    size_t userKeySize = key.size() >= 8 ? key.size() - 8 : key.size();
+    uint8_t bytes[kRestartPrefixSize] = {0};
+    memcpy(bytes,key.data(),std::min(userKeySize,kRestartPrefixSize));
+    uint64_t prefix;
+    memcpy(&prefix,bytes,sizeof(prefix));
+    return __builtin_bswap64(prefix);
+}
+
+static uint64_t loadPrefix(const uint8_t* prefixes,uint32_t index)
+{
+    uint64_t prefix;
+    memcpy(&prefix,prefixes + index * kRestartPrefixSize,sizeof(prefix));
+    return __builtin_bswap64(prefix);
+}
+
+//number of the n prefixes below target, or not above it when inclusive
+using CountPrefixes = uint32_t (*)(const uint8_t* prefixes,uint32_t n,uint64_t target,bool inclusive);
+
+static uint32_t countPrefixesScalar(const uint8_t* prefixes,uint32_t n,uint64_t target,bool inclusive)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t prefix = loadPrefix(prefixes,i);
+        count += prefix < target || (inclusive && prefix == target);
+    }
+    return count;
+}
+
+#ifdef BLOCK_PREFIX_SIMD
+//there is no unsigned 64-bit compare, flipping the sign bit makes the signed one order unsigned values
+static constexpr uint64_t kSignBit = 1ull << 63;
+
+__attribute__((target("avx2")))
+static uint32_t countPrefixesAVX2(const uint8_t* prefixes,uint32_t n,uint64_t target,bool inclusive)
+{
+    const __m256i swap = _mm256_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,
+                                          7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+    const __m256i flip = _mm256_set1_epi64x(static_cast<int64_t>(kSignBit));
+    const __m256i t = _mm256_set1_epi64x(static_cast<int64_t>(target ^ kSignBit));
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefixes + i * kRestartPrefixSize));
+        p = _mm256_xor_si256(_mm256_shuffle_epi8(p,swap),flip);
+        __m256i mask = inclusive ? _mm256_cmpgt_epi64(p,t) : _mm256_cmpgt_epi64(t,p);
+        uint32_t bits = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+        count += inclusive ? 4 - bits : bits;
+    }
+    return count + countPrefixesScalar(prefixes + i * kRestartPrefixSize,n - i,target,inclusive);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t countPrefixesSSE(const uint8_t* prefixes,uint32_t n,uint64_t target,bool inclusive)
+{
+    const __m128i swap = _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+    const __m128i flip = _mm_set1_epi64x(static_cast<int64_t>(kSignBit));
+    const __m128i t = _mm_set1_epi64x(static_cast<int64_t>(target ^ kSignBit));
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefixes + i * kRestartPrefixSize));
+        p = _mm_xor_si128(_mm_shuffle_epi8(p,swap),flip);
+        __m128i mask = inclusive ? _mm_cmpgt_epi64(p,t) : _mm_cmpgt_epi64(t,p);
+        uint32_t bits = __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+        count += inclusive ? 2 - bits : bits;
+    }
+    return count + countPrefixesScalar(prefixes + i * kRestartPrefixSize,n - i,target,inclusive);
+}
+#endif
+
+//picked once from the running cpu, the build sets no -m flags
+static CountPrefixes chooseCountPrefixes()
+{
+#ifdef BLOCK_PREFIX_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return countPrefixesAVX2;
+    if(__builtin_cpu_supports("sse4.2"))
+        return countPrefixesSSE;
+#endif
+    return countPrefixesScalar;
+}
+
+static const CountPrefixes countPrefixes = chooseCountPrefixes();
+
+//binary search over the contiguous array until the window fits a few vector compares
+static constexpr uint32_t kPrefixWindow = 32;
+
+//first index whose prefix is not below target, or above it when inclusive
+static uint32_t prefixBound(const uint8_t* prefixes,uint32_t n,uint64_t target,bool inclusive)
+{
+    uint32_t lo = 0;
+    uint32_t hi = n;
+    while (hi - lo > kPrefixWindow)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint64_t prefix = loadPrefix(prefixes,mid);
+        if(prefix < target || (inclusive && prefix == target))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo + countPrefixes(prefixes + lo * kRestartPrefixSize,hi - lo,target,inclusive);
+}
+
+//narrows the restart binary search to the restarts whose prefix ties with the target's,
+//restarts before them hold smaller keys and restarts after them larger ones
+static void narrowWithPrefixes(const uint8_t* prefixes,uint32_t n,const std::string_view& target,int& l,int& r)
+{
+    uint64_t prefix = keyPrefix(target);
+    uint32_t lower = prefixBound(prefixes,n,prefix,false);
+    uint32_t upper = lower + prefixBound(prefixes + lower * kRestartPrefixSize,n - lower,prefix,true);
+    l = lower;
+    r = static_cast<int>(upper) - 1;
+}
 
 //IndexBlock
 template<>
@@ -116,6 +244,10 @@ public:
     {
         int l = 0;
         int r = restartsNum_ - 1;
+        if(block_->HasPrefixArray())
+        {
+            narrowWithPrefixes(block_->prefixes_,restartsNum_,target,l,r);
+        }
         bool find = false;
         std::string_view key;
         while (l <= r)
@@ -139,6 +271,12 @@ public:
             }
         }
 
+        //target is past the last key
+        if(l == static_cast<int>(restartsNum_))
+        {
+            currentIndex_ = restartsNum_;
+            return;
+        }
         if(!find)
         {
             key = keyForRestartPoint(l); 
@@ -167,7 +305,8 @@ public:
 
     void Prev() override
     {
-        if(--currentIndex_ >= 0)
+        //currentIndex_ is unsigned, stepping before the first entry wraps it out of range
+        if(currentIndex_-- > 0)
         {
             key_ = keyForRestartPoint(currentIndex_);
             value_ = valueForKey(key_);
@@ -286,6 +425,10 @@ public:
     {
         int l = 0;
         int r = restartsNum_ - 1; 
+        if(block_->HasPrefixArray())
+        {
+            narrowWithPrefixes(block_->prefixes_,restartsNum_,target,l,r);
+        }
         bool find = false;
         std::string_view key;
         while (l <= r)
@@ -336,6 +479,52 @@ public:
         
     }
 
+    //jumps to the restart interval the hash index names for the user key and
+    //scans only that interval, Seek handles blocks without an index and collisions
+    void SeekForGet(const std::string_view& target) override
+    {
+        if(!block_->HasHashIndex() || target.size() < 8)
+        {
+            Seek(target);
+            return;
+        }
+        std::string_view userKey(target.data(),target.size() - 8);
+        uint8_t restart = block_->buckets_[Hash(userKey) % block_->numBuckets_];
+        if(restart == kHashIndexCollision)
+        {
+            Seek(target);
+            return;
+        }
+        //no entry of the user key in this block
+        if(restart == kHashIndexEmpty || restart >= restartsNum_)
+        {
+            currentOffset_ = restartsOffset_;
+            return;
+        }
+        uint64_t intervalEnd = restartsOffset_;
+        if(restart + 1u < restartsNum_)
+        {
+            intervalEnd = locateWithRestartIndex(restart + 1,restartsNum_,size_,data_) - data_;
+        }
+        currentIndex_ = restart;
+        key_ = readKey(locateWithRestartIndex(restart,restartsNum_,size_,data_));
+        value_ = valueForKey(key_);
+        currentOffset_ = key_.data() - data_ - LengthStore;
+        //key_ < target
+        while (block_->compare_(key_,target) == 1)
+        {
+            currentOffset_ += key_.length() + value_.length() + 2 * LengthStore;
+            //every entry of the user key is in this interval
+            if(currentOffset_ >= intervalEnd)
+            {
+                currentOffset_ = restartsOffset_;
+                return;
+            }
+            key_ = readKey(data_ + currentOffset_);
+            value_ = valueForKey(key_);
+        }
+    }
+
     void Next() override
     {
         if(currentOffset_ + 2 * LengthStore + key_.length() + value_.length() >= restartsOffset_)
@@ -379,6 +568,7 @@ public:
             currentIndex_ -= 1;
         }
         key_ = key;
+        value_ = valueForKey(key_);
         currentOffset_ = key_.data() - data_ - LengthStore;
         while (block_->compare_(key_,target) != 0)
         {
@@ -404,17 +594,106 @@ public:
 };
 
 
+//KVBlock with fixed-size entries
+template<>
+class KVBlock::FixedSizeIterator : public IteratorBase<std::string_view,std::string_view>
+{
+private:
+    Block* block_;
+    const char* data_;
+    uint32_t entriesNum_;
+    uint32_t keySize_;
+    uint32_t entrySize_;
+    uint32_t currentIndex_;
+
+    std::string_view keyAt(uint32_t index) const
+    {
+        return std::string_view(data_ + static_cast<uint64_t>(index) * entrySize_,keySize_);
+    }
+
+public:
+    FixedSizeIterator(Block* block,const char* data,uint32_t entriesNum,uint32_t keySize,uint32_t valueSize)
+     : block_(block),
+       data_(data),
+       entriesNum_(entriesNum),
+       keySize_(keySize),
+       entrySize_(keySize + valueSize),
+       currentIndex_(entriesNum)
+    {
+
+    }
+
+    bool Valid() const override
+    {
+        return currentIndex_ < entriesNum_;
+    }
+
+    void SeekForFirst() override
+    {
+        currentIndex_ = 0;
+    }
+
+    void SeekForLast() override
+    {
+        //wraps out of range when the block is empty
+        currentIndex_ = entriesNum_ - 1;
+    }
+
+    //lower bound, the loop halves the range with a conditional move instead of a branch
+    void Seek(const std::string_view& target) override
+    {
+        if(entriesNum_ == 0)
+        {
+            currentIndex_ = 0;
+            return;
+        }
+        uint32_t base = 0;
+        uint32_t n = entriesNum_;
+        while (n > 1)
+        {
+            uint32_t half = n / 2;
+            //key < target
+            base = block_->compare_(keyAt(base + half),target) == 1 ? base + half : base;
+            n -= half;
+        }
+        currentIndex_ = base + (block_->compare_(keyAt(base),target) == 1);
+    }
+
+    void Next() override
+    {
+        currentIndex_++;
+    }
+
+    void Prev() override
+    {
+        currentIndex_--;
+    }
+
+    std::string_view key() const override
+    {
+        return keyAt(currentIndex_);
+    }
+
+    std::string_view value() const override
+    {
+        return std::string_view(data_ + static_cast<uint64_t>(currentIndex_) * entrySize_ + keySize_,entrySize_ - keySize_);
+    }
+};
 
 template<>
 IndexIterator* IndexBlock::newIterator() 
 {
-    return new Iterator(this,content_.data_,restartNum_,content_.size_);
+    return new Iterator(this,content_.data_,restartNum_,restartsEnd_);
 }
 
 
 template<>
 KVIterator* KVBlock::newIterator()
 {
-    uint64_t restartOffset = content_.size_ - restartNum_ * RestartStore - LengthStore;
-    return new Iterator(this,content_.data_,restartNum_,restartOffset,content_.size_);
+    if(FixedSize())
+    {
+        return new FixedSizeIterator(this,content_.data_,restartNum_,fixedKeySize_,fixedValueSize_);
+    }
+    uint64_t restartOffset = restartsEnd_ - restartNum_ * RestartStore - LengthStore;
+    return new Iterator(this,content_.data_,restartNum_,restartOffset,restartsEnd_);
 }
@@ -9,6 +9,27 @@
 #include "../util/IteratorBase.h"
 
 
+//the u32 restart count that ends a block carries format flags in its high bits
+static constexpr uint32_t kBlockFlagsMask = 0xff000000u;
+
+//a hash index from user key to restart interval sits between the restarts and the count:
+//[u8 restart index or marker per bucket][u32 numBuckets]
+static constexpr uint32_t kBlockHashIndexFlag = 1u << 31;
+static constexpr uint8_t kHashIndexEmpty = 255;
+static constexpr uint8_t kHashIndexCollision = 254;
+//blocks with more restarts than fit a bucket are not hash indexed
+static constexpr uint32_t kHashIndexMaxRestarts = 253;
+
+//the first 8 bytes of each restart key's user key, zero padded, sit between the
+//restarts and the hash index as a contiguous array searched before the restart keys
+static constexpr uint32_t kBlockPrefixArrayFlag = 1u << 30;
+static constexpr size_t kRestartPrefixSize = sizeof(uint64_t);
+
+//every entry has the same key and value size, entries are stored back to back without
+//lengths or restarts and found by position: [key value]...[u32 keySize][u32 valueSize]
+//the count is then the number of entries
+static constexpr uint32_t kBlockFixedSizeFlag = 1u << 29;
+
 struct BlockContent
 {
     const char* data_;
@@ -24,29 +45,69 @@ private:
     
     Comparator compare_;
     BlockContent content_;
+    uint32_t flags_;
+    //the number of entries in a fixed-size block
     uint32_t restartNum_;
+    //the block size as the restart lookups see it, the optional sections
+    //between the restarts and the count are cut off
+    uint64_t restartsEnd_;
+    //hash index buckets, nullptr when the block has none
+    const uint8_t* buckets_{nullptr};
+    uint32_t numBuckets_{0};
+    //restart key prefixes, nullptr when the block has none
+    const uint8_t* prefixes_{nullptr};
+    uint32_t fixedKeySize_{0};
+    uint32_t fixedValueSize_{0};
     Block(const Block&) = delete;
     Block& operator=(const Block&) = delete;
 
-    uint32_t readNumRestarts()
+    uint32_t readUINT32(size_t offset) const
     {
-        size_t offset = content_.size_ - sizeof(uint32_t);
-        char* start = const_cast<char*>(content_.data_ + offset);
         uint32_t num = 0;
-        memcpy(&num,start,sizeof(uint32_t));
+        memcpy(&num,content_.data_ + offset,sizeof(uint32_t));
         return num;
     }
 
+    uint32_t readNumRestarts()
+    {
+        return readUINT32(content_.size_ - sizeof(uint32_t));
+    }
+
+    void readSections()
+    {
+        restartsEnd_ = content_.size_;
+        if(flags_ & kBlockFixedSizeFlag)
+        {
+            fixedKeySize_ = readUINT32(content_.size_ - 3 * sizeof(uint32_t));
+            fixedValueSize_ = readUINT32(content_.size_ - 2 * sizeof(uint32_t));
+            return;
+        }
+        if(flags_ & kBlockHashIndexFlag)
+        {
+            numBuckets_ = readUINT32(content_.size_ - 2 * sizeof(uint32_t));
+            restartsEnd_ -= numBuckets_ + sizeof(uint32_t);
+            buckets_ = reinterpret_cast<const uint8_t*>(content_.data_ + restartsEnd_ - sizeof(uint32_t));
+        }
+        if(flags_ & kBlockPrefixArrayFlag)
+        {
+            restartsEnd_ -= restartNum_ * kRestartPrefixSize;
+            prefixes_ = reinterpret_cast<const uint8_t*>(content_.data_ + restartsEnd_ - sizeof(uint32_t));
+        }
+    }
+
 public:
 
     class Iterator;
 
+    class FixedSizeIterator;
+
     explicit Block(BlockContent&& content,Comparator comparator)
      : content_(std::move(content)),
        compare_(std::move(comparator)),
-       restartNum_(readNumRestarts())
+       flags_(readNumRestarts() & kBlockFlagsMask),
+       restartNum_(readNumRestarts() & ~kBlockFlagsMask)
     {
-
+        readSections();
     }
 
     ~Block()
@@ -63,11 +124,31 @@ public:
         return content_.size_;
     }    
 
+    std::string_view data() const
+    {
+        return std::string_view(content_.data_,content_.size_);
+    }
+
     uint32_t NumRestarts() const
     {
         return restartNum_;
     }
 
+    bool HasHashIndex() const
+    {
+        return buckets_ != nullptr;
+    }
+
+    bool HasPrefixArray() const
+    {
+        return prefixes_ != nullptr;
+    }
+
+    bool FixedSize() const
+    {
+        return flags_ & kBlockFixedSizeFlag;
+    }
+
     IteratorBase<K,V>* newIterator() ;
 
    
@@ -5,6 +5,7 @@
 
 
 #include <map>
+#include <set>
 #include <vector>
 #include <random>
 static std::string_view RandomString()
@@ -131,6 +132,13 @@ TEST(BLOCKBUILDER,indexBuilder)
         } while (it->Valid());
         ASSERT_EQ(count,locationMap.size());  
     }
+
+    {
+        //past the last key
+        InternalKey ikey(std::string(64,'z'),kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        it->Seek(ikey.Encode());
+        ASSERT_FALSE(it->Valid());
+    }
 }
 
 
@@ -232,3 +240,246 @@ TEST(BLOCKBUILDER,KVBuilder)
 
 
 
+TEST(BLOCKBUILDER,HashIndex)
+{
+    //several versions per user key, some spanning restart intervals
+    std::map<std::string,std::vector<SequenceNumber>> versions;
+    std::mt19937 generator(7);
+    for (size_t i = 0; i < 300; i++)
+    {
+        std::string key = std::string(RandomString());
+        size_t n = generator() % 4 + 1;
+        for (size_t j = 0; j < n; j++)
+        {
+            versions[key].push_back(100 - j * 10);
+        }
+    }
+    KVBlockBuilder builder(KVBlockBuilder::kDefaultInterval,true);
+    for (const auto & [k,seqs] : versions)
+    {
+        for (SequenceNumber seq : seqs)
+        {
+            InternalKey ikey(k,seq,OpsType::UPDATE);
+            builder.Add(ikey.Encode(),k + std::to_string(seq));
+        }
+    }
+    uint64_t estimate = builder.CurrentSize();
+    std::string_view content = builder.Finish();
+    ASSERT_EQ(estimate,content.size());
+    KVBlock kvBlock_(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    ASSERT_TRUE(kvBlock_.HasHashIndex());
+    std::shared_ptr<KVIterator> it = std::shared_ptr<KVIterator>(kvBlock_.newIterator());
+
+    for (const auto & [k,seqs] : versions)
+    {
+        //the newest version, the newest visible at a snapshot, none visible
+        InternalKey newest(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        it->SeekForGet(newest.Encode());
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),k);
+        ASSERT_EQ(it->value(),k + std::to_string(seqs.front()));
+
+        InternalKey snapshot(k,seqs.back() + 5,OpsType::UPDATE);
+        it->SeekForGet(snapshot.Encode());
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),k);
+        ASSERT_EQ(it->value(),k + std::to_string(seqs.back()));
+
+        InternalKey old(k,1,OpsType::UPDATE);
+        it->SeekForGet(old.Encode());
+        ASSERT_TRUE(!it->Valid() || ExtraceUserKey(it->key()) != k);
+
+        //entries after a hashed lookup are reachable as usual
+        it->SeekForGet(newest.Encode());
+        for (size_t j = 1; j < seqs.size(); j++)
+        {
+            it->Next();
+            ASSERT_EQ(it->value(),k + std::to_string(seqs[j]));
+        }
+    }
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        std::string absent = std::string(RandomString()) + "_absent";
+        InternalKey ikey(absent,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        it->SeekForGet(ikey.Encode());
+        ASSERT_TRUE(!it->Valid() || ExtraceUserKey(it->key()) != absent);
+    }
+
+    //the hash index does not disturb ordinary iteration
+    it->SeekForFirst();
+    size_t count = 0;
+    while (it->Valid())
+    {
+        count++;
+        it->Next();
+    }
+    size_t total = 0;
+    for (const auto & [k,seqs] : versions)
+    {
+        total += seqs.size();
+    }
+    ASSERT_EQ(count,total);
+}
+
+TEST(BLOCKBUILDER,PrefixArray)
+{
+    //short keys, keys sharing their first 8 bytes and distinct ones
+    std::set<std::string> userKeys;
+    std::mt19937 generator(11);
+    for (size_t i = 0; i < 2000; i++)
+    {
+        std::string key = std::string(RandomString()).substr(0,generator() % 12 + 1);
+        userKeys.insert(key);
+        userKeys.insert("common_prefix_" + key);
+    }
+    userKeys.insert(std::string(3,'\0'));
+    userKeys.insert(std::string(8,'\xff') + "tail");
+
+    //plain blocks as the reference
+    KVBlockBuilder plainKV;
+    KVBlockBuilder prefixKV(KVBlockBuilder::kDefaultInterval,true,true);
+    IndexBlockBuilder plainIndex;
+    IndexBlockBuilder prefixIndex(IndexBlockBuilder::kDefaultInterval,false,true);
+    size_t i = 0;
+    for (const auto & k : userKeys)
+    {
+        InternalKey ikey(k,100,OpsType::UPDATE);
+        plainKV.Add(ikey.Encode(),k);
+        prefixKV.Add(ikey.Encode(),k);
+        plainIndex.Add(ikey.Encode(),{i,i});
+        prefixIndex.Add(ikey.Encode(),{i,i});
+        i++;
+    }
+    uint64_t estimate = prefixKV.CurrentSize();
+    std::string_view content = prefixKV.Finish();
+    ASSERT_EQ(estimate,content.size());
+    KVBlock prefixKVBlock(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    content = plainKV.Finish();
+    KVBlock plainKVBlock(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    content = prefixIndex.Finish();
+    IndexBlock prefixIndexBlock(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    content = plainIndex.Finish();
+    IndexBlock plainIndexBlock(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    ASSERT_TRUE(prefixKVBlock.HasPrefixArray());
+    ASSERT_TRUE(prefixKVBlock.HasHashIndex());
+    ASSERT_TRUE(prefixIndexBlock.HasPrefixArray());
+    ASSERT_FALSE(plainKVBlock.HasPrefixArray());
+    ASSERT_EQ(prefixIndexBlock.NumRestarts(),plainIndexBlock.NumRestarts());
+
+    std::unique_ptr<KVIterator> prefixKVIt(prefixKVBlock.newIterator());
+    std::unique_ptr<KVIterator> plainKVIt(plainKVBlock.newIterator());
+    std::unique_ptr<IndexIterator> prefixIndexIt(prefixIndexBlock.newIterator());
+    std::unique_ptr<IndexIterator> plainIndexIt(plainIndexBlock.newIterator());
+
+    std::vector<std::string> targets(userKeys.begin(),userKeys.end());
+    for (const auto & k : userKeys)
+    {
+        targets.push_back(k + "0");
+        targets.push_back(k.substr(0,k.size() - 1));
+    }
+    targets.push_back("");
+    targets.push_back(std::string(16,'\xff'));
+    for (const auto & target : targets)
+    {
+        for (SequenceNumber seq : {SequenceNumber(1),SequenceNumber(100),kDefaultMaxSequenceNumber})
+        {
+            InternalKey ikey(target,seq,OpsType::UPDATE);
+            prefixKVIt->Seek(ikey.Encode());
+            plainKVIt->Seek(ikey.Encode());
+            ASSERT_EQ(prefixKVIt->Valid(),plainKVIt->Valid());
+            if(plainKVIt->Valid())
+            {
+                ASSERT_EQ(prefixKVIt->key(),plainKVIt->key());
+            }
+            prefixIndexIt->Seek(ikey.Encode());
+            plainIndexIt->Seek(ikey.Encode());
+            ASSERT_EQ(prefixIndexIt->Valid(),plainIndexIt->Valid());
+            if(plainIndexIt->Valid())
+            {
+                ASSERT_EQ(prefixIndexIt->key(),plainIndexIt->key());
+                ASSERT_EQ(prefixIndexIt->value(),plainIndexIt->value());
+            }
+        }
+    }
+}
+
+TEST(BLOCKBUILDER,FixedSize)
+{
+    std::map<std::string,std::string> kvMap;
+    for (size_t i = 0; i < 200; i++)
+    {
+        std::string key = std::string(RandomString()).substr(0,16);
+        kvMap[key] = key.substr(0,8);
+    }
+    KVBlockBuilder plain;
+    KVBlockBuilder fixed(KVBlockBuilder::kDefaultInterval,false,false,true);
+    SequenceNumber seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,seq++,OpsType::UPDATE);
+        plain.Add(ikey.Encode(),v);
+        fixed.Add(ikey.Encode(),v);
+    }
+    uint64_t estimate = fixed.CurrentSize();
+    std::string_view content = fixed.Finish();
+    ASSERT_EQ(estimate,content.size());
+    ASSERT_LT(content.size(),plain.CurrentSize());
+    KVBlock fixedBlock(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    ASSERT_TRUE(fixedBlock.FixedSize());
+    std::unique_ptr<KVIterator> it(fixedBlock.newIterator());
+
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        it->SeekForGet(ikey.Encode());
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),k);
+        ASSERT_EQ(it->value(),v);
+        //between this key and the next
+        InternalKey after(k + "0",kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        it->Seek(after.Encode());
+        auto next = kvMap.upper_bound(k);
+        if(next == kvMap.end())
+        {
+            ASSERT_FALSE(it->Valid());
+        } else
+        {
+            ASSERT_EQ(ExtraceUserKey(it->key()),next->first);
+        }
+    }
+    InternalKey before("",kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    it->Seek(before.Encode());
+    ASSERT_EQ(ExtraceUserKey(it->key()),kvMap.begin()->first);
+
+    it->SeekForLast();
+    auto rit = kvMap.rbegin();
+    for (; it->Valid(); it->Prev(), rit++)
+    {
+        ASSERT_EQ(ExtraceUserKey(it->key()),rit->first);
+    }
+    ASSERT_TRUE(rit == kvMap.rend());
+
+    //an entry of another size switches the block to the variable layout
+    fixed.Reset();
+    seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,seq++,OpsType::UPDATE);
+        fixed.Add(ikey.Encode(),seq == 100 ? v + "longer" : v);
+    }
+    content = fixed.Finish();
+    KVBlock variableBlock(BlockContent{content.data(),content.size(),false},InternalKeyStringViewComparator{});
+    ASSERT_FALSE(variableBlock.FixedSize());
+    it.reset(variableBlock.newIterator());
+    it->SeekForFirst();
+    seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),k);
+        ASSERT_EQ(it->value(),++seq == 100 ? v + "longer" : v);
+        it->Next();
+    }
+    ASSERT_FALSE(it->Valid());
+}
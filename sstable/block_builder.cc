@@ -1,11 +1,45 @@
 #include "block_builder.h"
 
+template<>
+void KVBlockBuilder::ConvertToVariable();
+
 template<>
 void KVBlockBuilder::Add(const std::string_view& key,const std::string_view& value)
 {
+    if(fixed_)
+    {
+        if(size_ == 0)
+        {
+            fixedKeySize_ = key.size();
+            fixedValueSize_ = value.size();
+        }
+        if(key.size() == fixedKeySize_ && value.size() == fixedValueSize_)
+        {
+            buffer_.append(key);
+            buffer_.append(value);
+            size_++;
+            lastkey_ = key;
+            return;
+        }
+        ConvertToVariable();
+    }
+
     if(size_++ % interval_ == 0)
     {
-        restarts_.push_back(buffer_.size());
+        AddRestart(key);
+    }
+
+    if(hashIndex_)
+    {
+        assert(key.size() >= 8);
+        std::string_view userKey(key.data(),key.size() - 8);
+        uint32_t restart = restarts_.size() - 1;
+        //versions of one user key are adjacent
+        if(hashes_.empty() || hashes_.back().second != restart ||
+            lastkey_.size() < 8 || std::string_view(lastkey_.data(),lastkey_.size() - 8) != userKey)
+        {
+            hashes_.emplace_back(Hash(userKey),restart);
+        }
     }
 
     AppendUINT32(buffer_,key.length());
@@ -17,11 +51,28 @@ void KVBlockBuilder::Add(const std::string_view& key,const std::string_view& val
     lastkey_ = key;
 }
 
+template<>
+void KVBlockBuilder::ConvertToVariable()
+{
+    std::string entries = std::move(buffer_);
+    size_t n = size_;
+    fixed_ = false;
+    buffer_ = std::string{};
+    lastkey_ = std::string{};
+    size_ = 0;
+    size_t entrySize = fixedKeySize_ + fixedValueSize_;
+    for (size_t i = 0; i < n; i++)
+    {
+        const char* entry = entries.data() + i * entrySize;
+        Add(std::string_view(entry,fixedKeySize_),std::string_view(entry + fixedKeySize_,fixedValueSize_));
+    }
+}
+
 template<>
 void IndexBlockBuilder::Add(const std::string_view& key,const std::pair<size_t,size_t>& value)
 {
 
-    restarts_.push_back(buffer_.size());
+    AddRestart(key);
 
 
     AppendUINT32(buffer_,key.length());
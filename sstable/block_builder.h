@@ -1,12 +1,15 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include <string_view>
 #include <string>
 
+#include "block.h"
 #include "../util/format.h"
+#include "../util/Hash.h"
 
 template<typename V>
 class BlockBuilder
@@ -19,15 +22,83 @@ private:
 
     std::vector<uint32_t> restarts_;
     bool finished_;
-    static constexpr int kDefaultInterval = 16;
+    //(user key hash, restart index) of every user key, consecutive duplicates dropped
+    bool hashIndex_;
+    std::vector<std::pair<uint32_t,uint32_t>> hashes_;
+    //user key prefixes of the restart keys, big-endian so they compare as numbers
+    bool prefixArray_;
+    std::string prefixes_;
+    //fixed-size layout while every entry matches the first one's sizes
+    bool fixedSize_;
+    bool fixed_;
+    size_t fixedKeySize_;
+    size_t fixedValueSize_;
+
+    //re-adds the entries of a fixed-size block in the variable layout
+    void ConvertToVariable();
+    //hashes per bucket, lower means fewer collisions and a larger index
+    static constexpr double kHashUtilRatio = 0.75;
+
+    size_t numBuckets() const
+    {
+        return static_cast<size_t>(hashes_.size() / kHashUtilRatio) + 1;
+    }
+
+    bool buildHashIndex() const
+    {
+        return hashIndex_ && !hashes_.empty() && restarts_.size() <= kHashIndexMaxRestarts;
+    }
+
+    void AddRestart(const std::string_view& key)
+    {
+        restarts_.push_back(buffer_.size());
+        if(prefixArray_)
+        {
+            size_t userKeySize = key.size() >= 8 ? key.size() - 8 : key.size();
+            size_t n = std::min(userKeySize,kRestartPrefixSize);
+            prefixes_.append(key.data(),n);
+            prefixes_.append(kRestartPrefixSize - n,'\0');
+        }
+    }
+
+    void AppendHashIndex()
+    {
+        std::string buckets(numBuckets(),static_cast<char>(kHashIndexEmpty));
+        for (const auto & [hash,restart] : hashes_)
+        {
+            uint8_t& bucket = reinterpret_cast<uint8_t&>(buckets[hash % buckets.size()]);
+            if(bucket == kHashIndexEmpty)
+            {
+                bucket = restart;
+            } else if (bucket != restart)
+            {
+                bucket = kHashIndexCollision;
+            }
+        }
+        buffer_.append(buckets);
+        AppendUINT32(buffer_,buckets.size());
+    }
 public:
-    BlockBuilder(int blockStartInterval = kDefaultInterval)
+    static constexpr int kDefaultInterval = 16;
+
+    //hashIndex appends a user key to restart interval hash index for SeekForGet,
+    //prefixArray an array of restart key prefixes that Seek searches with SIMD compares,
+    //keys must be internal keys for either
+    //fixedSize drops lengths and restarts while all entries have the same sizes,
+    //a block switches back to the variable layout at the first entry that differs
+    BlockBuilder(int blockStartInterval = kDefaultInterval,bool hashIndex = false,bool prefixArray = false,bool fixedSize = false)
     : buffer_(),
       lastkey_(),
       interval_(blockStartInterval),
       size_(0),
       restarts_(),
-      finished_(false)
+      finished_(false),
+      hashIndex_(hashIndex),
+      prefixArray_(prefixArray),
+      fixedSize_(fixedSize),
+      fixed_(fixedSize),
+      fixedKeySize_(0),
+      fixedValueSize_(0)
     {
 
     }
@@ -48,16 +119,38 @@ public:
         buffer_ = std::string{};
         lastkey_ = std::string{};
         restarts_.clear();
+        hashes_.clear();
+        prefixes_.clear();
         size_ = 0;
+        fixed_ = fixedSize_;
     }
 
     std::string_view Finish()
     {
+        if(fixed_ && size_ > 0)
+        {
+            AppendUINT32(buffer_,fixedKeySize_);
+            AppendUINT32(buffer_,fixedValueSize_);
+            AppendUINT32(buffer_,size_ | kBlockFixedSizeFlag);
+            finished_ = true;
+            return std::string_view(buffer_.data(),buffer_.size());
+        }
         for (auto & restart : restarts_)
         {
             AppendUINT32(buffer_,restart);
         }
-        AppendUINT32(buffer_,restarts_.size());
+        uint32_t flags = 0;
+        if(prefixArray_)
+        {
+            buffer_.append(prefixes_);
+            flags |= kBlockPrefixArrayFlag;
+        }
+        if(buildHashIndex())
+        {
+            AppendHashIndex();
+            flags |= kBlockHashIndexFlag;
+        }
+        AppendUINT32(buffer_,restarts_.size() | flags);
         finished_ = true;
         return std::string_view(buffer_.data(),buffer_.size());
     }
@@ -69,9 +162,14 @@ public:
 
     uint64_t CurrentSize() const
     {
+        if(fixed_ && size_ > 0)
+        {
+            return buffer_.size() + 3 * sizeof(uint32_t);
+        }
         return buffer_.size() + 
                 restarts_.size() * sizeof(uint32_t) + 
-                    sizeof(uint32_t);
+                    sizeof(uint32_t) + prefixes_.size() +
+                        (buildHashIndex() ? numBuckets() + sizeof(uint32_t) : 0);
     }
 };
 
@@ -3,8 +3,11 @@
 #include <string_view>
 #include <vector>
 #include <memory>
+#include <optional>
+#include <string>
 
 #include "../util/IteratorBase.h"
+#include "../util/MergeOperator.h"
 #include "table.h"
 
 class MergeIterator : public IteratorBase<std::string_view,std::string_view>
@@ -17,18 +20,20 @@ private:
     {
         assert(!itList_.empty());
         auto it = itList_.begin();
-        std::string_view key = (*it)->key();
-        current_ = *it;
+        std::shared_ptr<Iterator> largest = nullptr;
         while (it != itList_.end())
         {
-            //key < it->key()
-            if(compare_(key,(*it)->key()) == 1)
+            //largest->key() < it->key()
+            if((*it)->Valid() && (largest == nullptr || compare_(largest->key(),(*it)->key()) == 1))
             {
-                key = (*it)->key();
-                current_ = *it;
+                largest = *it;
             }
             it++;
         }
+        current_ = largest;
+        //children without bounds of their own
+        if(current_ && lowerBound_ && userKey(current_->key()) < *lowerBound_)
+            current_ = nullptr;
     }
 
     void findSmallest()
@@ -53,6 +58,13 @@ private:
             it++;
         }
         current_ = smallest;
+        if(current_ && upperBound_ && userKey(current_->key()) >= *upperBound_)
+            current_ = nullptr;
+    }
+
+    static std::string_view userKey(const std::string_view& ikey)
+    {
+        return std::string_view(ikey.data(),ikey.size() - 8);
     }
 
 public:
@@ -60,9 +72,13 @@ public:
     using Iterator = SSTable::Iterator;
     using IteratorList = std::vector<std::shared_ptr<Iterator>>;
     
-    MergeIterator(IteratorList&& tablesIterators)
+    //children are expected to honour the same bounds, keys past them are
+    //dropped here as well
+    MergeIterator(IteratorList&& tablesIterators,const ReadOptions& options = ReadOptions{})
      : itList_(std::move(tablesIterators)),
-       current_(nullptr)
+       current_(nullptr),
+       lowerBound_(options.iterateLowerBound_),
+       upperBound_(options.iterateUpperBound_)
     {
 
     }
@@ -77,6 +93,14 @@ public:
 
     void SeekForFirst() override
     {
+        if(lowerBound_)
+        {
+            Seek(InternalKey(*lowerBound_,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode());
+            return;
+        }
+        current_ = nullptr;
+        if(itList_.empty())
+            return;
         for (const auto & it : itList_)
         {
             it->SeekForFirst();
@@ -87,6 +111,9 @@ public:
 
     void SeekForLast() override
     {
+        current_ = nullptr;
+        if(itList_.empty())
+            return;
         for (const auto & it : itList_)
         {
             it->SeekForLast();
@@ -98,6 +125,10 @@ public:
     //TODO
     void Seek(const std::string_view& target) override
     {
+        current_ = nullptr;
+        //nothing at or after target is inside the bounds, leave the children alone
+        if(itList_.empty() || (upperBound_ && userKey(target) >= *upperBound_))
+            return;
         for (auto & it : itList_)
         {
             it->Seek(target);
@@ -135,6 +166,16 @@ public:
         return current_->value();
     }
 
+    bool Corrupted() const override
+    {
+        for (const auto & it : itList_)
+        {
+            if(it->Corrupted())
+                return true;
+        }
+        return false;
+    }
+
 private:
 
     IteratorList itList_;
@@ -142,6 +183,276 @@ private:
 
     InternalKeyStringViewComparator compare_{};
 
+    std::optional<std::string> lowerBound_;
+    std::optional<std::string> upperBound_;
+
     DIRECTION direction_;
 };
 
+
+//a key whose newest entry is a MERGE shows up once, as an UPDATE holding its operands
+//folded onto the older versions, which are skipped. entries of other keys pass through.
+//the child is usually a MergeIterator over every table that may hold the key, with
+//blobs resolved. a key whose operands fail to merge keeps its newest MERGE entry
+class MergeResolvingIterator : public IteratorBase<std::string_view,std::string_view>
+{
+private:
+    using Iterator = IteratorBase<std::string_view,std::string_view>;
+    using Entries = std::vector<std::pair<std::string,std::string>>;
+
+    //PASS shows the child's entry, FOLDED a folded key, BUFFERED a key read backwards
+    enum class MODE { PASS,FOLDED,BUFFERED };
+
+    std::shared_ptr<Iterator> it_;
+    std::shared_ptr<MergeOperator> mergeOperator_;
+    MODE mode_{MODE::PASS};
+    //the child sits past the current key in this direction, except for PASS
+    bool forward_{true};
+    //user key of the entries passed through, the child is inside its versions
+    std::string passKey_;
+    bool passing_{false};
+    std::string key_;
+    std::string value_;
+    //versions of one key oldest first, pos_ is the current one
+    Entries buffer_;
+    size_t pos_{0};
+
+    static std::string_view userKey(const std::string_view& ikey)
+    {
+        return std::string_view(ikey.data(),ikey.size() - 8);
+    }
+
+    //versions newest first
+    void fold(const Entries& versions)
+    {
+        MergeContext context;
+        const std::string* base = nullptr;
+        for (const auto & [key,value] : versions)
+        {
+            OpsType type = ExtractOpsType(key);
+            if(type == OpsType::MERGE)
+            {
+                context.PushOperand(value);
+                continue;
+            }
+            if(type != OpsType::DELETE)
+                base = &value;
+            break;
+        }
+        key_ = versions.front().first;
+        std::string_view baseValue = base != nullptr ? std::string_view(*base) : std::string_view();
+        if(context.Fold(*mergeOperator_,userKey(key_),base != nullptr ? &baseValue : nullptr,&value_))
+            SetOpsType(key_,OpsType::UPDATE);
+        else
+            value_ = versions.front().second;
+        mode_ = MODE::FOLDED;
+    }
+
+    void resolveForward()
+    {
+        forward_ = true;
+        mode_ = MODE::PASS;
+        if(!it_->Valid())
+        {
+            passing_ = false;
+            return;
+        }
+        std::string_view user = userKey(it_->key());
+        if(passing_ && user == passKey_)
+            return;
+        if(mergeOperator_ == nullptr || ExtractOpsType(it_->key()) != OpsType::MERGE)
+        {
+            passKey_ = user;
+            passing_ = true;
+            return;
+        }
+        passing_ = false;
+        Entries versions;
+        std::string current(user);
+        for (; it_->Valid() && userKey(it_->key()) == current; it_->Next())
+        {
+            versions.emplace_back(it_->key(),it_->value());
+        }
+        fold(versions);
+    }
+
+    //the child is on the oldest version of a key or invalid
+    void resolveBackward()
+    {
+        forward_ = false;
+        passing_ = false;
+        mode_ = MODE::PASS;
+        if(!it_->Valid())
+            return;
+        buffer_.clear();
+        pos_ = 0;
+        std::string current(userKey(it_->key()));
+        for (; it_->Valid() && userKey(it_->key()) == current; it_->Prev())
+        {
+            buffer_.emplace_back(it_->key(),it_->value());
+        }
+        if(mergeOperator_ != nullptr && ExtractOpsType(buffer_.back().first) == OpsType::MERGE)
+        {
+            fold(Entries(buffer_.rbegin(),buffer_.rend()));
+            return;
+        }
+        mode_ = MODE::BUFFERED;
+    }
+
+    //the child on the first entry of the next key
+    void seekPast(const std::string& user)
+    {
+        passing_ = false;
+        it_->Seek(InternalKey(user,0,OpsType::DELETE).Encode());
+        while (it_->Valid() && userKey(it_->key()) == user)
+        {
+            it_->Next();
+        }
+    }
+
+    //the child on the last entry of the previous key
+    void seekBefore(const std::string& user)
+    {
+        it_->Seek(InternalKey(user,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode());
+        if(it_->Valid())
+            it_->Prev();
+        else
+            it_->SeekForLast();
+        while (it_->Valid() && userKey(it_->key()) >= user)
+        {
+            it_->Prev();
+        }
+    }
+
+public:
+    MergeResolvingIterator(std::shared_ptr<Iterator> it,std::shared_ptr<MergeOperator> mergeOperator)
+     : it_(std::move(it)),
+       mergeOperator_(std::move(mergeOperator))
+    {
+
+    }
+
+    bool Valid() const override
+    {
+        return mode_ != MODE::PASS || it_->Valid();
+    }
+
+    void SeekForFirst() override
+    {
+        passing_ = false;
+        it_->SeekForFirst();
+        resolveForward();
+    }
+
+    void SeekForLast() override
+    {
+        it_->SeekForLast();
+        resolveBackward();
+    }
+
+    void Seek(const std::string_view& target) override
+    {
+        passing_ = false;
+        it_->Seek(target);
+        resolveForward();
+    }
+
+    void Next() override
+    {
+        assert(Valid());
+        switch (mode_)
+        {
+        case MODE::PASS:
+            it_->Next();
+            break;
+        case MODE::FOLDED:
+            if(!forward_)
+                seekPast(std::string(userKey(key_)));
+            break;
+        case MODE::BUFFERED:
+            if(pos_ > 0)
+            {
+                pos_--;
+                return;
+            }
+            seekPast(std::string(userKey(buffer_[0].first)));
+            break;
+        }
+        resolveForward();
+    }
+
+    void Prev() override
+    {
+        assert(Valid());
+        switch (mode_)
+        {
+        case MODE::PASS:
+        {
+            //the versions of the current key are read again to step back among them
+            std::string current(it_->key());
+            std::string user(userKey(current));
+            Entries versions;
+            size_t index = 0;
+            for (it_->Seek(InternalKey(user,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode());
+                    it_->Valid() && userKey(it_->key()) == user; it_->Next())
+            {
+                if(it_->key() == current)
+                    index = versions.size();
+                versions.emplace_back(it_->key(),it_->value());
+            }
+            seekBefore(user);
+            if(index == 0)
+                break;
+            forward_ = false;
+            passing_ = false;
+            buffer_.assign(versions.rbegin(),versions.rend());
+            pos_ = versions.size() - index;
+            mode_ = MODE::BUFFERED;
+            return;
+        }
+        case MODE::FOLDED:
+            if(forward_)
+                seekBefore(std::string(userKey(key_)));
+            break;
+        case MODE::BUFFERED:
+            if(pos_ + 1 < buffer_.size())
+            {
+                pos_++;
+                return;
+            }
+            break;
+        }
+        resolveBackward();
+    }
+
+    std::string_view key() const override
+    {
+        switch (mode_)
+        {
+        case MODE::FOLDED:
+            return key_;
+        case MODE::BUFFERED:
+            return buffer_[pos_].first;
+        default:
+            return it_->key();
+        }
+    }
+
+    std::string_view value() const override
+    {
+        switch (mode_)
+        {
+        case MODE::FOLDED:
+            return value_;
+        case MODE::BUFFERED:
+            return buffer_[pos_].second;
+        default:
+            return it_->value();
+        }
+    }
+
+    bool Corrupted() const override
+    {
+        return it_->Corrupted();
+    }
+};
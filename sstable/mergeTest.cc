@@ -8,6 +8,9 @@
 #include "./table_builder.h"
 #include "./table.h"
 #include "./merge.h"
+#include "./table_cache.h"
+#include "../util/fname.h"
+#include "../util/TestMergeOperators.h"
 
 using KVMap = std::map<std::string,std::string>;
 static std::string_view ExtraceUserKey(std::string_view ikey)
@@ -94,4 +97,128 @@ TEST(MergeIterator,Merge)
 
 
 
-}
\ No newline at end of file
+}
+
+TEST(MergeIterator,Bounds)
+{
+    const std::string dbname = "merge_bounds_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    //four files over disjoint key ranges
+    std::vector<FileMeta> files;
+    std::vector<std::string> keys;
+    SequenceNumber seq = 1;
+    for (uint64_t fileNumber = 1; fileNumber <= 4; fileNumber++)
+    {
+        TableBuilder builder(TableFileName(dbname,fileNumber));
+        FileMeta meta;
+        meta.number_ = fileNumber;
+        for (int i = 0; i < 500; i++)
+        {
+            char buf[32];
+            snprintf(buf,sizeof(buf),"key%02llu_%04d",static_cast<unsigned long long>(fileNumber),i);
+            InternalKey key(buf,seq++,OpsType::UPDATE);
+            builder.Add(key.Encode(),buf);
+            keys.push_back(buf);
+            if(i == 0)
+                meta.smallest_ = key;
+            meta.largest_ = key;
+        }
+        ASSERT_EQ(builder.Finish(),0);
+        meta.fileSize_ = builder.FileSize();
+        files.push_back(meta);
+    }
+
+    ReadOptions bounds;
+    bounds.iterateLowerBound_ = "key02_0100";
+    bounds.iterateUpperBound_ = "key03_0250";
+    TableCache tables(dbname,16);
+    MergeIterator::IteratorList iterators = tables.NewIterators(files,bounds);
+    //files 1 and 4 are not opened
+    ASSERT_EQ(iterators.size(),2);
+    MergeIterator it(std::move(iterators),bounds);
+    size_t i = 500 + 100;
+    for (it.SeekForFirst(); it.Valid(); it.Next(),i++)
+    {
+        ASSERT_EQ(ExtraceUserKey(it.key()),keys[i]);
+    }
+    ASSERT_EQ(i,1000 + 250);
+
+    it.Seek(InternalKey("key03_0300",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode());
+    ASSERT_FALSE(it.Valid());
+    it.Seek(InternalKey("key02_0499",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode());
+    ASSERT_TRUE(it.Valid());
+    ASSERT_EQ(ExtraceUserKey(it.key()),"key02_0499");
+    it.Next();
+    ASSERT_EQ(ExtraceUserKey(it.key()),"key03_0000");
+}
+
+TEST(MergeIterator,MergeResolving)
+{
+    const std::string dbname = "merge_resolving_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    using Entry = std::tuple<std::string,SequenceNumber,OpsType,std::string>;
+    //the older table holds the bases, the newer one the operands
+    std::vector<std::vector<Entry>> tables{
+        {{"a",1,OpsType::UPDATE,"10"},{"b",2,OpsType::UPDATE,"1"},{"d",4,OpsType::UPDATE,"4"},{"e",5,OpsType::UPDATE,"9"}},
+        {{"a",10,OpsType::MERGE,"5"},{"b",11,OpsType::UPDATE,"7"},{"c",13,OpsType::MERGE,"3"},{"c",12,OpsType::MERGE,"2"},
+         {"e",14,OpsType::MERGE,"1"},{"e",6,OpsType::DELETE,""}}};
+    std::vector<FileMeta> files;
+    for (size_t i = 0; i < tables.size(); i++)
+    {
+        TableBuilder builder(TableFileName(dbname,i + 1));
+        for (const auto & [k,seq,type,v] : tables[i])
+        {
+            builder.Add(InternalKey(k,seq,type).Encode(),v);
+        }
+        ASSERT_EQ(builder.Finish(),0);
+        FileMeta meta;
+        meta.number_ = i + 1;
+        meta.fileSize_ = builder.FileSize();
+        files.push_back(meta);
+    }
+    TableCache cache(dbname,16);
+    MergeResolvingIterator it(std::make_shared<MergeIterator>(cache.NewIterators(files,ReadOptions{})),
+                                std::make_shared<AddOperator>());
+    std::vector<std::pair<std::string,std::string>> expected{
+        {std::string(InternalKey("a",10,OpsType::UPDATE).Encode()),"15"},
+        {std::string(InternalKey("b",11,OpsType::UPDATE).Encode()),"7"},
+        {std::string(InternalKey("b",2,OpsType::UPDATE).Encode()),"1"},
+        {std::string(InternalKey("c",13,OpsType::UPDATE).Encode()),"5"},
+        {std::string(InternalKey("d",4,OpsType::UPDATE).Encode()),"4"},
+        {std::string(InternalKey("e",14,OpsType::UPDATE).Encode()),"1"}};
+    size_t i = 0;
+    for (it.SeekForFirst(); it.Valid(); it.Next(),i++)
+    {
+        ASSERT_EQ(it.key(),expected[i].first);
+        ASSERT_EQ(it.value(),expected[i].second);
+    }
+    ASSERT_EQ(i,expected.size());
+    for (it.SeekForLast(); it.Valid(); it.Prev())
+    {
+        i--;
+        ASSERT_EQ(it.key(),expected[i].first);
+        ASSERT_EQ(it.value(),expected[i].second);
+    }
+    ASSERT_EQ(i,0);
+
+    //changing direction around folded and passed keys
+    it.Seek(InternalKey("b",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode());
+    ASSERT_EQ(it.key(),expected[1].first);
+    it.Prev();
+    ASSERT_EQ(it.key(),expected[0].first);
+    it.Next();
+    ASSERT_EQ(it.key(),expected[1].first);
+    it.Next();
+    it.Next();
+    ASSERT_EQ(it.value(),"5");
+    it.Prev();
+    ASSERT_EQ(it.key(),expected[2].first);
+    it.Next();
+    it.Next();
+    ASSERT_EQ(it.key(),expected[4].first);
+    it.Prev();
+    ASSERT_EQ(it.key(),expected[3].first);
+    it.Prev();
+    it.Prev();
+    ASSERT_EQ(it.key(),expected[1].first);
+}
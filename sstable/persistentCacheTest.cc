@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <csignal>
+#include <sys/resource.h>
+
+#include "./persistent_cache.h"
+#include "./table_builder.h"
+#include "./table_cache.h"
+#include "../util/fname.h"
+
+using KVMap = std::map<std::string,std::string>;
+
+static std::string_view RandomString()
+{
+    static std::string src = std::string("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
+    std::random_device rd;
+    std::mt19937 generator(rd());
+    std::shuffle(src.begin(), src.end(), generator);
+    return std::string_view(src.data(),32); 
+}
+
+static PersistentCacheOptions TestOptions(const std::string& path)
+{
+    std::system(("rm -rf " + path).c_str());
+    PersistentCacheOptions options;
+    options.path_ = path;
+    options.segmentSize_ = 16 * 1024;
+    options.capacity_ = 1 << 20;
+    return options;
+}
+
+static std::string TestBlock(int i)
+{
+    return std::string(1000 + i,'a' + i % 26);
+}
+
+TEST(PersistentCache,ReloadAfterRestart)
+{
+    PersistentCacheOptions options = TestOptions("pcache_reload");
+    {
+        auto cache = PersistentCache::NewCache(options);
+        ASSERT_NE(cache,nullptr);
+        for (int i = 0; i < 100; i++)
+        {
+            cache->Insert(1,i * 4096,TestBlock(i));
+        }
+        ASSERT_GT(cache->GetStats().segments_,1);
+    }
+    auto cache = PersistentCache::NewCache(options);
+    ASSERT_NE(cache,nullptr);
+    for (int i = 0; i < 100; i++)
+    {
+        size_t size = 0;
+        char* data = cache->Lookup(1,i * 4096,&size);
+        ASSERT_NE(data,nullptr);
+        ASSERT_EQ(std::string(data,size),TestBlock(i));
+        free(data);
+    }
+    size_t size = 0;
+    ASSERT_EQ(cache->Lookup(2,0,&size),nullptr);
+    ASSERT_EQ(cache->GetStats().hits_,100);
+}
+
+TEST(PersistentCache,DropsOldestSegments)
+{
+    PersistentCacheOptions options = TestOptions("pcache_capacity");
+    options.capacity_ = 64 * 1024;
+    auto cache = PersistentCache::NewCache(options);
+    for (int i = 0; i < 200; i++)
+    {
+        cache->Insert(1,i,TestBlock(i));
+    }
+    auto stats = cache->GetStats();
+    ASSERT_LE(stats.usage_,options.capacity_);
+    size_t size = 0;
+    ASSERT_EQ(cache->Lookup(1,0,&size),nullptr);
+    char* data = cache->Lookup(1,199,&size);
+    ASSERT_NE(data,nullptr);
+    free(data);
+}
+
+TEST(PersistentCache,HotKeys)
+{
+    PersistentCacheOptions options = TestOptions("pcache_hotkeys");
+    options.dumpHotKeys_ = true;
+    options.maxHotKeys_ = 2;
+    {
+        auto cache = PersistentCache::NewCache(options);
+        for (int i = 0; i < 10; i++)
+        {
+            cache->Insert(3,i,TestBlock(i));
+        }
+        size_t size = 0;
+        free(cache->Lookup(3,4,&size));
+    }
+    auto cache = PersistentCache::NewCache(options);
+    auto keys = cache->LoadHotKeys();
+    ASSERT_EQ(keys.size(),2);
+    ASSERT_EQ(keys[0].fileNumber_,3);
+    ASSERT_EQ(keys[0].offset_,4);
+    ASSERT_EQ(keys[0].size_,TestBlock(4).size());
+    ASSERT_EQ(keys[1].offset_,9);
+}
+
+TEST(PersistentCache,WarmRestart)
+{
+    const std::string dbname = "pcache_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    const uint64_t fileNumber = 7;
+    KVMap kvMap;
+    {
+        TableBuilder builder(TableFileName(dbname,fileNumber));
+        for (size_t i = 0; i < 4096; i++)
+        {
+            std::string randomKey = std::string(RandomString());
+            kvMap.insert(std::make_pair(randomKey,randomKey));
+        }
+        SequenceNumber seq = 1;
+        for (const auto & [k,v] : kvMap)
+        {
+            InternalKey ikey(k,seq++,OpsType::UPDATE);
+            builder.Add(ikey.Encode(),v);
+        }
+        builder.Finish();
+    }
+
+    PersistentCacheOptions pcacheOptions = TestOptions("pcache_db_cache");
+    pcacheOptions.dumpHotKeys_ = true;
+    auto lookupAll = [&kvMap](TableCache& tables){
+        for (const auto & [k,v] : kvMap)
+        {
+            InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+            std::string value;
+            ASSERT_TRUE(tables.Get(fileNumber,0,ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+                value = val;
+            }));
+            ASSERT_EQ(value,v);
+        }
+    };
+    {
+        Options options;
+        options.persistentCache_ = PersistentCache::NewCache(pcacheOptions);
+        TableCache tables(dbname,16,options);
+        lookupAll(tables);
+        ASSERT_GT(options.persistentCache_->GetStats().inserts_,0);
+    }
+
+    Options options;
+    options.blockCache_ = ShardedLRUCache::NewCache(1024);
+    options.persistentCache_ = PersistentCache::NewCache(pcacheOptions);
+    TableCache tables(dbname,16,options);
+    tables.PrefetchHotBlocks();
+    tables.WaitForPrefetch();
+    auto stats = options.persistentCache_->GetStats();
+    ASSERT_GT(stats.hits_,0);
+    ASSERT_EQ(stats.inserts_,0);
+    lookupAll(tables);
+    //every block came from the prefetch, nothing was read again
+    ASSERT_EQ(options.persistentCache_->GetStats().hits_,stats.hits_);
+}
+
+//tables opened without a file number would all share key 0
+TEST(PersistentCache,NeedsFileNumber)
+{
+    std::remove("pcache_unnumbered.table");
+    {
+        TableBuilder builder("pcache_unnumbered.table");
+        for (int i = 0; i < 1000; i++)
+        {
+            builder.Add(InternalKey("key" + std::to_string(1000 + i),i + 1,OpsType::UPDATE).Encode(),TestBlock(i));
+        }
+        ASSERT_EQ(builder.Finish(),0);
+    }
+    Options options;
+    options.persistentCache_ = PersistentCache::NewCache(TestOptions("pcache_unnumbered"));
+    std::shared_ptr<SSTable> table = SSTable::newTable("pcache_unnumbered.table",options);
+    ASSERT_TRUE(table->isOpen());
+    std::string value;
+    ASSERT_EQ(table->InternalGet(InternalKey("key1500",kDefaultMaxSequenceNumber,kMaxOpsType).Encode(),[&value](const std::string_view&,const std::string_view& val){
+        value = val;
+    }),0);
+    ASSERT_EQ(value,TestBlock(500));
+    ASSERT_EQ(options.persistentCache_->GetStats().inserts_,0);
+    ASSERT_EQ(options.persistentCache_->GetStats().misses_,0);
+}
+
+//a failed write must not leave its size in the usage or a hole in the segment
+TEST(PersistentCache,FailedWrite)
+{
+    PersistentCacheOptions options = TestOptions("pcache_failed");
+    auto cache = PersistentCache::NewCache(options);
+    ASSERT_NE(cache,nullptr);
+    //writes past the limit fail with EFBIG instead of raising SIGXFSZ
+    auto handler = std::signal(SIGXFSZ,SIG_IGN);
+    rlimit old;
+    getrlimit(RLIMIT_FSIZE,&old);
+    rlimit limit = old;
+    limit.rlim_cur = 8 * 1024;
+    setrlimit(RLIMIT_FSIZE,&limit);
+    for (int i = 0; i < 10; i++)
+    {
+        cache->Insert(1,i,TestBlock(i));
+    }
+    setrlimit(RLIMIT_FSIZE,&old);
+    std::signal(SIGXFSZ,handler);
+    auto stats = cache->GetStats();
+    ASSERT_GT(stats.inserts_,0);
+    ASSERT_LT(stats.inserts_,10);
+    ASSERT_LE(stats.usage_,limit.rlim_cur);
+
+    //the next record goes where the failed one would have
+    cache->Insert(1,100,TestBlock(0));
+    ASSERT_EQ(cache->GetStats().inserts_,stats.inserts_ + 1);
+    cache.reset();
+    cache = PersistentCache::NewCache(options);
+    size_t size = 0;
+    char* data = cache->Lookup(1,100,&size);
+    ASSERT_NE(data,nullptr);
+    ASSERT_EQ(std::string(data,size),TestBlock(0));
+    free(data);
+}
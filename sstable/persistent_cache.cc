@@ -0,0 +1,393 @@
+#include "persistent_cache.h"
+#include "../util/CRC.h"
+#include "../util/format.h"
+
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+static constexpr uint32_t kRecordMagic = 0x4c504331;
+//magic | crc | fileNumber | offset | size
+static constexpr size_t kRecordHeaderSize = 4 + 4 + 8 + 8 + 4;
+static constexpr char kSegmentSuffix[] = ".pcache";
+
+static uint32_t recordCRC(const char* begin,size_t size)
+{
+    static const CRC::Table<crcpp_uint32,32> table(CRC::CRC_32());
+    return CRC::Calculate(begin,size,table);
+}
+
+static bool preadFull(int fd,char* buf,size_t size,size_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::pread(fd,buf,size,offset);
+        if(n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool pwriteFull(int fd,const char* buf,size_t size,size_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::pwrite(fd,buf,size,offset);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+PersistentCache::SegmentFile::~SegmentFile()
+{
+    if(fd_ >= 0)
+        ::close(fd_);
+}
+
+PersistentCache::PersistentCache(const PersistentCacheOptions& options)
+ : options_(options)
+{
+
+}
+
+PersistentCache::~PersistentCache()
+{
+    if(opened_ && options_.dumpHotKeys_)
+    {
+        DumpHotKeys();
+    }
+}
+
+std::shared_ptr<PersistentCache> PersistentCache::NewCache(const PersistentCacheOptions& options)
+{
+    auto cache = std::make_shared<PersistentCache>(options);
+    if(cache->Open() != 0)
+        return nullptr;
+    return cache;
+}
+
+std::string PersistentCache::cacheKey(uint64_t fileNumber,uint64_t offset)
+{
+    std::string key;
+    AppendUINT64(key,fileNumber);
+    AppendUINT64(key,offset);
+    return key;
+}
+
+std::string PersistentCache::segmentName(uint64_t number) const
+{
+    char buf[32];
+    snprintf(buf,sizeof(buf),"/%06llu",static_cast<unsigned long long>(number));
+    return options_.path_ + buf + kSegmentSuffix;
+}
+
+std::string PersistentCache::hotKeysName() const
+{
+    return options_.path_ + "/HOTKEYS";
+}
+
+int PersistentCache::Open()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    assert(!opened_);
+    ::mkdir(options_.path_.c_str(),0755);
+    DIR* dir = ::opendir(options_.path_.c_str());
+    if(dir == nullptr)
+    {
+        perror("open persistent cache");
+        return -1;
+    }
+    std::vector<uint64_t> numbers;
+    while (struct dirent* ent = ::readdir(dir))
+    {
+        std::string name = ent->d_name;
+        size_t suffix = name.rfind(kSegmentSuffix);
+        if(suffix == std::string::npos || suffix + strlen(kSegmentSuffix) != name.size() || suffix == 0)
+            continue;
+        numbers.push_back(strtoull(name.c_str(),nullptr,10));
+    }
+    ::closedir(dir);
+    std::sort(numbers.begin(),numbers.end());
+    for (uint64_t number : numbers)
+    {
+        if(!loadSegment(number))
+        {
+            ::unlink(segmentName(number).c_str());
+        }
+        nextSegment_ = number + 1;
+    }
+    while (stats_.usage_ > options_.capacity_ && segments_.size() > 1)
+    {
+        dropOldestSegmentLocked();
+    }
+    //never append to a segment written by a previous run
+    if(!newSegmentLocked())
+        return -1;
+    opened_ = true;
+    return 0;
+}
+
+bool PersistentCache::loadSegment(uint64_t number)
+{
+    int fd = ::open(segmentName(number).c_str(),O_CLOEXEC | O_RDONLY);
+    if(fd < 0)
+        return false;
+    Segment segment;
+    segment.file_ = std::make_shared<SegmentFile>();
+    segment.file_->fd_ = fd;
+    size_t fileSize = lseek(fd,0,SEEK_END);
+    size_t pos = 0;
+    char header[kRecordHeaderSize];
+    //only headers are read, a torn tail ends the segment
+    while (pos + kRecordHeaderSize <= fileSize && preadFull(fd,header,kRecordHeaderSize,pos))
+    {
+        uint32_t magic;
+        BlockKey key;
+        uint32_t size;
+        memcpy(&magic,header,4);
+        memcpy(&key.fileNumber_,header + 8,8);
+        memcpy(&key.offset_,header + 16,8);
+        memcpy(&size,header + 24,4);
+        if(magic != kRecordMagic || pos + kRecordHeaderSize + size > fileSize)
+            break;
+        key.size_ = size;
+        std::string k = cacheKey(key.fileNumber_,key.offset_);
+        eraseLocked(k);
+        lru_.push_front(k);
+        index_[k] = Location{number,pos,key,lru_.begin()};
+        segment.keys_.push_back(std::move(k));
+        pos += kRecordHeaderSize + size;
+    }
+    if(segment.keys_.empty())
+        return false;
+    segment.size_ = pos;
+    stats_.usage_ += pos;
+    segments_[number] = std::move(segment);
+    stats_.segments_ = segments_.size();
+    return true;
+}
+
+bool PersistentCache::newSegmentLocked()
+{
+    uint64_t number = nextSegment_++;
+    int fd = ::open(segmentName(number).c_str(),O_CLOEXEC | O_CREAT | O_TRUNC | O_RDWR,0644);
+    if(fd < 0)
+    {
+        perror("create persistent cache segment");
+        return false;
+    }
+    Segment segment;
+    segment.file_ = std::make_shared<SegmentFile>();
+    segment.file_->fd_ = fd;
+    segments_[number] = std::move(segment);
+    stats_.segments_ = segments_.size();
+    return true;
+}
+
+void PersistentCache::dropOldestSegmentLocked()
+{
+    auto it = segments_.begin();
+    assert(it != segments_.end());
+    for (const auto & key : it->second.keys_)
+    {
+        auto loc = index_.find(key);
+        //the block may have been rewritten to a newer segment
+        if(loc != index_.end() && loc->second.segment_ == it->first)
+            eraseLocked(key);
+    }
+    stats_.usage_ -= it->second.size_;
+    ::unlink(segmentName(it->first).c_str());
+    segments_.erase(it);
+    stats_.segments_ = segments_.size();
+}
+
+void PersistentCache::eraseLocked(const std::string& key)
+{
+    auto it = index_.find(key);
+    if(it == index_.end())
+        return;
+    lru_.erase(it->second.lru_);
+    index_.erase(it);
+}
+
+void PersistentCache::Insert(uint64_t fileNumber,uint64_t offset,const std::string_view& block)
+{
+    std::string record;
+    record.reserve(kRecordHeaderSize + block.size());
+    AppendUINT32(record,kRecordMagic);
+    AppendUINT32(record,0);
+    AppendUINT64(record,fileNumber);
+    AppendUINT64(record,offset);
+    AppendUINT32(record,block.size());
+    record.append(block.data(),block.size());
+    uint32_t crc = recordCRC(record.data() + 8,record.size() - 8);
+    memcpy(record.data() + 4,&crc,sizeof(crc));
+
+    std::string key = cacheKey(fileNumber,offset);
+    uint64_t number;
+    size_t pos;
+    std::shared_ptr<SegmentFile> file;
+    {
+        //space is reserved under the lock, the write goes on without it
+        std::lock_guard<std::mutex> lk(mutex_);
+        if(!opened_ || index_.count(key))
+            return;
+        auto current = std::prev(segments_.end());
+        if(current->second.size_ >= options_.segmentSize_)
+        {
+            if(!newSegmentLocked())
+                return;
+            current = std::prev(segments_.end());
+        }
+        number = current->first;
+        pos = current->second.size_;
+        file = current->second.file_;
+        current->second.size_ += record.size();
+        stats_.usage_ += record.size();
+    }
+    bool ok = pwriteFull(file->fd_,record.data(),record.size(),pos);
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto segment = segments_.find(number);
+    if(!ok && segment != segments_.end() && segment->second.size_ == pos + record.size())
+    {
+        //nothing was reserved after the record, give its space back
+        segment->second.size_ = pos;
+        stats_.usage_ -= record.size();
+    }
+    //a failed record ends the segment on reload and keeps the space reserved
+    //behind it until the segment is dropped, one inserted meanwhile wins
+    if(!ok || segment == segments_.end() || index_.count(key))
+        return;
+    lru_.push_front(key);
+    index_[key] = Location{number,pos,BlockKey{fileNumber,offset,block.size()},lru_.begin()};
+    segment->second.keys_.push_back(key);
+    stats_.inserts_++;
+    while (stats_.usage_ > options_.capacity_ && segments_.size() > 1)
+    {
+        dropOldestSegmentLocked();
+    }
+}
+
+char* PersistentCache::Lookup(uint64_t fileNumber,uint64_t offset,size_t* size)
+{
+    std::string key = cacheKey(fileNumber,offset);
+    std::shared_ptr<SegmentFile> file;
+    size_t pos;
+    size_t blockSize;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto it = index_.find(key);
+        if(it == index_.end())
+        {
+            stats_.misses_++;
+            return nullptr;
+        }
+        lru_.splice(lru_.begin(),lru_,it->second.lru_);
+        file = segments_[it->second.segment_].file_;
+        pos = it->second.pos_;
+        blockSize = it->second.key_.size_;
+    }
+
+    //the segment stays open while we hold file, even if it gets dropped
+    size_t recordSize = kRecordHeaderSize + blockSize;
+    char* record = static_cast<char*>(malloc(recordSize));
+    uint32_t crc = 0;
+    bool ok = preadFull(file->fd_,record,recordSize,pos);
+    if(ok)
+    {
+        memcpy(&crc,record + 4,sizeof(crc));
+        ok = crc == recordCRC(record + 8,recordSize - 8);
+    }
+    std::lock_guard<std::mutex> lk(mutex_);
+    if(!ok)
+    {
+        free(record);
+        eraseLocked(key);
+        stats_.misses_++;
+        return nullptr;
+    }
+    stats_.hits_++;
+    memmove(record,record + kRecordHeaderSize,blockSize);
+    *size = blockSize;
+    return record;
+}
+
+std::vector<PersistentCache::BlockKey> PersistentCache::HotKeys() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    std::vector<BlockKey> keys;
+    for (const auto & key : lru_)
+    {
+        if(keys.size() >= options_.maxHotKeys_)
+            break;
+        keys.push_back(index_.at(key).key_);
+    }
+    return keys;
+}
+
+int PersistentCache::DumpHotKeys() const
+{
+    std::string buf;
+    for (const auto & key : HotKeys())
+    {
+        AppendUINT64(buf,key.fileNumber_);
+        AppendUINT64(buf,key.offset_);
+        AppendUINT64(buf,key.size_);
+    }
+    std::string tmp = hotKeysName() + ".tmp";
+    int fd = ::open(tmp.c_str(),O_CLOEXEC | O_CREAT | O_TRUNC | O_WRONLY,0644);
+    if(fd < 0)
+        return -1;
+    ssize_t written = ::write(fd,buf.data(),buf.size());
+    ::close(fd);
+    if(written != static_cast<ssize_t>(buf.size()))
+        return -1;
+    return ::rename(tmp.c_str(),hotKeysName().c_str());
+}
+
+std::vector<PersistentCache::BlockKey> PersistentCache::LoadHotKeys() const
+{
+    std::vector<BlockKey> keys;
+    int fd = ::open(hotKeysName().c_str(),O_CLOEXEC | O_RDONLY);
+    if(fd < 0)
+        return keys;
+    size_t size = lseek(fd,0,SEEK_END);
+    std::string buf(size,0);
+    if(preadFull(fd,buf.data(),size,0))
+    {
+        for (size_t pos = 0; pos + 3 * sizeof(uint64_t) <= size; pos += 3 * sizeof(uint64_t))
+        {
+            BlockKey key;
+            memcpy(&key.fileNumber_,buf.data() + pos,8);
+            memcpy(&key.offset_,buf.data() + pos + 8,8);
+            memcpy(&key.size_,buf.data() + pos + 16,8);
+            keys.push_back(key);
+        }
+    }
+    ::close(fd);
+    return keys;
+}
+
+PersistentCache::Stats PersistentCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_;
+}
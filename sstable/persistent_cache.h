@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <memory>
+
+struct PersistentCacheOptions
+{
+    //directory holding the cache segments
+    std::string path_;
+    //a new segment is started once the current one reaches this size
+    size_t segmentSize_{64 << 20};
+    //oldest segments are dropped once the total exceeds this
+    size_t capacity_{1 << 30};
+    //write the most recently used block keys on close
+    bool dumpHotKeys_{false};
+    size_t maxHotKeys_{4096};
+};
+
+//block cache tier on local files, keyed by (file number, offset)
+//blocks are appended to segment files, segments are dropped whole
+//record: magic | crc32 | fileNumber | offset | size | block
+class PersistentCache
+{
+public:
+    struct BlockKey
+    {
+        uint64_t fileNumber_{0};
+        uint64_t offset_{0};
+        uint64_t size_{0};
+    };
+
+    struct Stats
+    {
+        uint64_t hits_{0};
+        uint64_t misses_{0};
+        uint64_t inserts_{0};
+        size_t usage_{0};
+        size_t segments_{0};
+    };
+
+    explicit PersistentCache(const PersistentCacheOptions& options);
+    ~PersistentCache();
+
+    PersistentCache(const PersistentCache&) = delete;
+    PersistentCache& operator=(const PersistentCache&) = delete;
+
+    //returns nullptr when the cache directory cannot be used
+    static std::shared_ptr<PersistentCache> NewCache(const PersistentCacheOptions& options);
+
+    //rebuilds the index from segment headers, block data is not read
+    int Open();
+
+    void Insert(uint64_t fileNumber,uint64_t offset,const std::string_view& block);
+
+    //returns a malloc'd copy of the block owned by the caller, nullptr on miss
+    char* Lookup(uint64_t fileNumber,uint64_t offset,size_t* size);
+
+    //most recently used first
+    std::vector<BlockKey> HotKeys() const;
+
+    int DumpHotKeys() const;
+
+    //keys written by the last DumpHotKeys
+    std::vector<BlockKey> LoadHotKeys() const;
+
+    Stats GetStats() const;
+
+private:
+    struct SegmentFile
+    {
+        int fd_{-1};
+        ~SegmentFile();
+    };
+
+    struct Segment
+    {
+        std::shared_ptr<SegmentFile> file_;
+        size_t size_{0};
+        std::vector<std::string> keys_;
+    };
+
+    struct Location
+    {
+        uint64_t segment_;
+        size_t pos_;
+        BlockKey key_;
+        std::list<std::string>::iterator lru_;
+    };
+
+    static std::string cacheKey(uint64_t fileNumber,uint64_t offset);
+
+    std::string segmentName(uint64_t number) const;
+
+    std::string hotKeysName() const;
+
+    bool loadSegment(uint64_t number);
+
+    bool newSegmentLocked();
+
+    void dropOldestSegmentLocked();
+
+    void eraseLocked(const std::string& key);
+
+    PersistentCacheOptions options_;
+
+    std::map<uint64_t,Segment> segments_;
+
+    std::unordered_map<std::string,Location> index_;
+
+    //front is the most recently used
+    std::list<std::string> lru_;
+
+    uint64_t nextSegment_{1};
+
+    bool opened_{false};
+
+    Stats stats_;
+
+    mutable std::mutex mutex_;
+};
@@ -1,77 +1,622 @@
 #include "table.h"
+#include "persistent_cache.h"
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
-void SSTable::loadIndexblock()
+void SSTable::OpenTable(const std::string& filename,const Options& options,uint64_t fileNumber)
+{
+    fileName_ = filename;
+    fileNumber_ = fileNumber;
+    //the tier is keyed by file number, tables opened without one would share keys
+    persistentCache_ = fileNumber != 0 ? options.persistentCache_ : nullptr;
+    verifyChecksums_ = options.verifyChecksums_;
+    asyncReader_ = options.asyncReader_;
+    maxReadaheadBlocks_ = options.maxReadaheadBlocks_;
+    mergeOperator_ = options.mergeOperator_;
+    loadIndexblock(options);
+    //TODO
+    secondaryCache_ = options.secondaryCache_;
+    cache_ = options.blockCache_;
+    if(cache_ == nullptr)
+    {
+        //a private cache gets the hook here, a shared one where it was set up
+        cache_ = ShardedLRUCache::NewCache(64);
+        if(secondaryCache_)
+            installEvictionHook(*cache_,secondaryCache_);
+    }
+}
+
+void SSTable::installEvictionHook(ShardedLRUCache& cache,const std::shared_ptr<CompressedSecondaryCache>& secondaryCache)
+{
+    //demote evicted blocks into the compressed tier
+    cache.SetEvictionHook([secondary = secondaryCache](const std::string& key,void* value){
+        if(isPartitionCacheKey(key))
+        {
+            secondary->Insert(key,static_cast<IndexBlock*>(value)->data());
+            return;
+        }
+        KVBlock* block = static_cast<KVBlock*>(value);
+        secondary->Insert(key,block->data());
+    });
+}
+
+void SSTable::InstallSecondaryCache(const Options& options)
+{
+    if(options.blockCache_ && options.secondaryCache_)
+        installEvictionHook(*options.blockCache_,options.secondaryCache_);
+}
+
+void SSTable::loadIndexblock(const Options& options)
 {
     assert(!opened_);
-    fd_ = ::open(fileName_.c_str(),O_CLOEXEC | O_RDONLY,0644);
-    if(fd_ < 0)
+    file_ = std::make_unique<RandomAccessFile>(fileName_);
+    if(!file_->isOpen())
     {
-        perror("open file");
+        file_.reset();
+        return;
     } 
-    assert(fd_ >= 0);
-    totalSize_ = lseek(fd_,0,SEEK_END);      
-    lseek(fd_,-sizeof(size_t),SEEK_END);
-    ::read(fd_,&indexDataoffset_,sizeof(size_t));
-    
-    size_t IndexBlockSize = totalSize_ - indexDataoffset_ - sizeof(size_t);
-    void* buffer = malloc(IndexBlockSize);
-    assert(lseek(fd_,indexDataoffset_,SEEK_SET) == indexDataoffset_);
-    assert(::read(fd_,buffer,IndexBlockSize) == IndexBlockSize);
-    BlockContent indexContent{static_cast<char*>(buffer),IndexBlockSize,true};
+    totalSize_ = file_->Size();
+    //over the limit the table is read with pread
+    if(options.useMmapReads_)
+        file_->Map(options.mmapLimiter_,options.accessPattern_);
+    if(file_->Mapped() != nullptr)
+    {
+        size_t words = (totalSize_ / 8 + 63) / 64;
+        verifiedMapped_ = std::make_unique<std::atomic<uint64_t>[]>(words);
+        for(size_t i = 0;i < words;i++)
+            verifiedMapped_[i].store(0,std::memory_order_relaxed);
+    }
+    char footerContent[Footer::kEncodedLength];
+    bool ok = totalSize_ >= Footer::kEncodedLength &&
+                file_->Read(totalSize_ - Footer::kEncodedLength,Footer::kEncodedLength,footerContent) &&
+                footer_.DecodeFrom(footerContent);
+    //the index is read once, always verify it
+    BlockContent indexContent{nullptr,0,true};
+    if(ok)
+    {
+        //the properties are stored uncompressed and bound every other block
+        loadProperties();
+        setMaxBlockLength(options);
+        indexContent = readBlock(footer_.indexHandle_,true);
+    }
+    if(indexContent.data_ == nullptr)
+    {
+        fprintf(stderr,"%s: corrupted table\n",fileName_.c_str());
+        file_.reset();
+        return;
+    }
     indexBlock_ = std::make_unique<IndexBlock>(std::move(indexContent),InternalKeyStringViewComparator{});
+    partitionedIndex_ = footer_.formatVersion_ == kPartitionedIndexFormatVersion;
     opened_ = true;
 }
 
+uint64_t SSTable::ApproximateOffsetOf(const std::string_view& key)
+{
+    assert(opened_);
+    std::unique_ptr<IndexIterator> iit(newIndexIterator());
+    iit->Seek(key);
+    if(iit->Valid())
+        return iit->value().first;
+    //data blocks start at 0 and are back to back
+    if(properties_)
+        return properties_->dataSize_;
+    return footer_.indexHandle_.first;
+}
+
+std::vector<std::string> SSTable::BlockBoundaries(const std::string_view& start,const std::string_view& limit)
+{
+    assert(opened_);
+    std::vector<std::string> keys;
+    std::unique_ptr<IndexIterator> it(newIndexIterator());
+    for (it->Seek(InternalKey(start,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode()); it->Valid(); it->Next())
+    {
+        std::string_view userKey = it->key().substr(0,it->key().size() - 8);
+        if(userKey >= limit)
+            break;
+        keys.emplace_back(userKey);
+    }
+    return keys;
+}
+
+void SSTable::loadProperties()
+{
+    if(footer_.metaHandle_.second == 0)
+        return;
+    BlockContent content = readBlock(footer_.metaHandle_,true);
+    if(content.data_ == nullptr)
+    {
+        //the table is still readable without them
+        fprintf(stderr,"%s: corrupted properties block\n",fileName_.c_str());
+        return;
+    }
+    auto properties = std::make_unique<TableProperties>();
+    if(properties->DecodeFrom(std::string_view(content.data_,content.size_)))
+    {
+        globalSequence_ = properties->globalSequence_;
+        properties_ = std::move(properties);
+    }
+    if(content.owned_)
+        free(const_cast<char*>(content.data_));
+}
+
+//a block is cut once it passes blockSize_ so only one large entry makes it longer,
+//and no block holds more than all keys and values of the table around their overhead
+void SSTable::setMaxBlockLength(const Options& options)
+{
+    maxBlockLength_ = options.blockSize_ * kMaxBlockSizeMultiple;
+    if(properties_)
+    {
+        size_t raw = properties_->rawKeySize_ + properties_->rawValueSize_;
+        size_t entries = properties_->numEntries_ + properties_->numDataBlocks_;
+        maxBlockLength_ = std::max(maxBlockLength_,raw + entries * kMaxEntryOverhead);
+    }
+}
+
+int SSTable::WriteGlobalSequence(const std::string& fileName,SequenceNumber seq)
+{
+    RandomAccessFile file(fileName);
+    Footer footer;
+    char footerContent[Footer::kEncodedLength];
+    if(!file.isOpen() || file.Size() < Footer::kEncodedLength ||
+        !file.Read(file.Size() - Footer::kEncodedLength,Footer::kEncodedLength,footerContent) ||
+        !footer.DecodeFrom(footerContent))
+        return -1;
+    const BlockHandle& handle = footer.metaHandle_;
+    if(handle.second < TableProperties::kGlobalSequenceOffset + sizeof(seq))
+        return -1;
+    std::string block(handle.second + kBlockTrailerSize,0);
+    if(!file.Read(handle.first,block.size(),block.data()) || !VerifyBlockTrailer(block.data(),handle.second) ||
+        BlockTrailerType(block.data(),handle.second) != CompressionType::kNoCompression)
+        return -1;
+    block.resize(handle.second);
+    memcpy(block.data() + TableProperties::kGlobalSequenceOffset,&seq,sizeof(seq));
+    AppendBlockTrailer(block,block,CompressionType::kNoCompression);
+    return WriteFileAt(fileName,handle.first,block) ? 0 : -1;
+}
+
+BlockContent SSTable::readBlock(const std::pair<size_t,size_t>& location,bool verify)
+{
+    size_t offset = location.first;
+    size_t size = location.second;
+    if(offset + size + kBlockTrailerSize > totalSize_)
+        return BlockContent{nullptr,0,true};
+    const char* mapped = file_->Mapped();
+    if(mapped != nullptr)
+    {
+        //zero copy, uncompressed blocks point into the mapping
+        const char* buf = mapped + offset;
+        if(verify && !verifyMapped(buf,offset,size))
+            return BlockContent{nullptr,0,true};
+        CompressionType type = BlockTrailerType(buf,size);
+        if(type == CompressionType::kNoCompression)
+            return BlockContent{buf,size,false};
+        return uncompressBlock(type,std::string_view(buf,size));
+    }
+    char* buf = static_cast<char*>(malloc(size + kBlockTrailerSize));
+    if(!file_->Read(offset,size + kBlockTrailerSize,buf))
+    {
+        free(buf);
+        return BlockContent{nullptr,0,true};
+    }
+    return decodeBlock(buf,size,verify);
+}
+
+bool SSTable::verifyMapped(const char* buf,size_t offset,size_t size)
+{
+    std::atomic<uint64_t>& word = verifiedMapped_[offset / 8 / 64];
+    uint64_t mask = uint64_t{1} << (offset / 8 % 64);
+    if(word.load(std::memory_order_relaxed) & mask)
+        return true;
+    if(!VerifyBlockTrailer(buf,size))
+        return false;
+    //two readers may both verify a block before the bit is set, that only costs a crc
+    word.fetch_or(mask,std::memory_order_relaxed);
+    return true;
+}
+
+BlockContent SSTable::decodeBlock(char* buf,size_t size,bool verify)
+{
+    if(verify && !VerifyBlockTrailer(buf,size))
+    {
+        free(buf);
+        return BlockContent{nullptr,0,true};
+    }
+    CompressionType type = BlockTrailerType(buf,size);
+    if(type == CompressionType::kNoCompression)
+        return BlockContent{buf,size,true};
+    BlockContent content = uncompressBlock(type,std::string_view(buf,size));
+    free(buf);
+    return content;
+}
+
+std::vector<BlockContent> SSTable::readBlocks(const std::vector<std::pair<size_t,size_t>>& locations,bool verify)
+{
+    std::vector<BlockContent> contents(locations.size(),BlockContent{nullptr,0,true});
+    readBlocks(locations,verify,[&contents](size_t i,BlockContent content){
+        contents[i] = content;
+    });
+    return contents;
+}
+
+void SSTable::readBlocks(const std::vector<std::pair<size_t,size_t>>& locations,bool verify,
+                         const std::function<void(size_t,BlockContent)>& done)
+{
+    if(asyncReader_ == nullptr || file_->Mapped() != nullptr)
+    {
+        for (size_t i = 0; i < locations.size(); i++)
+        {
+            BlockContent content = readBlock(locations[i],verify);
+            if(content.data_ != nullptr)
+                done(i,content);
+        }
+        return;
+    }
+    std::vector<ReadRequest> requests;
+    //requests[i] reads locations[slots[i]]
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < locations.size(); i++)
+    {
+        auto [offset,size] = locations[i];
+        if(offset + size + kBlockTrailerSize > totalSize_)
+            continue;
+        char* buf = static_cast<char*>(malloc(size + kBlockTrailerSize));
+        requests.push_back(ReadRequest{file_.get(),offset,size + kBlockTrailerSize,buf});
+        slots.push_back(i);
+    }
+    asyncReader_->Read(requests.data(),requests.size(),[&](size_t i){
+        ReadRequest& request = requests[i];
+        if(!request.ok_)
+        {
+            free(request.scratch_);
+            return;
+        }
+        BlockContent content = decodeBlock(request.scratch_,request.size_ - kBlockTrailerSize,verify);
+        if(content.data_ != nullptr)
+            done(slots[i],content);
+    });
+}
 
-SSTable::~SSTable()
+BlockContent SSTable::uncompressBlock(CompressionType type,const std::string_view& compressed)
 {
-    if(opened_)
+    //decompress straight into the buffer the block (and the cache) will own
+    const CompressionCodec* codec = CompressionRegistry::instance().Get(type);
+    size_t length = 0;
+    char* data = nullptr;
+    if(codec != nullptr && codec->uncompressedLength_(compressed,&length) && length <= maxBlockLength_)
     {
-        ::close(fd_);
-        fd_ = -1;
+        data = static_cast<char*>(malloc(length));
+        if(!codec->uncompress_(compressed,data,length))
+        {
+            free(data);
+            data = nullptr;
+        }
     }
+    if(data == nullptr)
+        length = 0;
+    return BlockContent{data,length,true};
+}
+
+
+SSTable::~SSTable() = default;
+
+std::shared_ptr<KVIterator> SSTable::mappedKVBlockReader(const std::pair<size_t,size_t>& value)
+{
+    BlockContent content = readBlock(value,verifyChecksums_);
+    if(content.data_ == nullptr)
+        return nullptr;
+    KVBlock* block = new KVBlock(std::move(content),InternalKeyStringViewComparator{});
+    return std::shared_ptr<KVIterator>(block->newIterator(),[block](KVIterator* it){
+        delete it;
+        delete block;
+    });
 }
 
 std::shared_ptr<KVIterator> SSTable::KVBlockReader(const std::pair<size_t,size_t>& value)
 {
-    std::string cacheKey = pairToString(value);
+    //uncompressed blocks of a mapped table are read in place, compressed ones
+    //are decompressed once and cached like any other block
+    if(readInPlace(value))
+        return mappedKVBlockReader(value);
+
+    std::string cacheKey = blockCacheKey(value);
     Entry* entry_ = cache_->Lookup(cacheKey);  
-    KVBlock* block = nullptr;
-    if(entry_ != nullptr)
+    if(entry_ == nullptr)
+    {
+        BlockContent content = lookupLowerTiers(cacheKey,value);
+        if(content.data_ == nullptr)
+        {
+            //cached blocks are verified once here, hits are not checked again
+            content = loadKVBlock(value);
+            if(content.data_ == nullptr)
+                return nullptr;
+            if(persistentCache_)
+                persistentCache_->Insert(fileNumber_,value.first,std::string_view(content.data_,content.size_));
+        }
+        entry_ = insertKVBlock(cacheKey,std::move(content));
+    }
+    return cachedKVIterator(entry_);
+}
+
+std::vector<std::shared_ptr<KVIterator>> SSTable::KVBlockReaders(const std::vector<std::pair<size_t,size_t>>& locations)
+{
+    std::vector<std::shared_ptr<KVIterator>> kvits(locations.size());
+    std::vector<std::pair<size_t,size_t>> misses;
+    //misses[i] belongs to kvits[slots[i]]
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < locations.size(); i++)
     {
-        block = static_cast<KVBlock*>(entry_->value_);
-    } else
+        if(readInPlace(locations[i]))
+        {
+            kvits[i] = mappedKVBlockReader(locations[i]);
+            continue;
+        }
+        std::string cacheKey = blockCacheKey(locations[i]);
+        Entry* entry = cache_->Lookup(cacheKey);
+        if(entry == nullptr)
+        {
+            BlockContent content = lookupLowerTiers(cacheKey,locations[i]);
+            if(content.data_ == nullptr)
+            {
+                misses.push_back(locations[i]);
+                slots.push_back(i);
+                continue;
+            }
+            entry = insertKVBlock(cacheKey,std::move(content));
+        }
+        kvits[i] = cachedKVIterator(entry);
+    }
+    std::vector<BlockContent> contents = readBlocks(misses,verifyChecksums_);
+    for (size_t i = 0; i < misses.size(); i++)
     {
-        BlockContent content = loadKVBlock(value);
-        block = new KVBlock(std::move(content),InternalKeyStringViewComparator{});
-        entry_ = cache_->Insert(pairToString(value),block,1,KVBlockDestroy);
+        if(contents[i].data_ == nullptr)
+            continue;
+        if(persistentCache_)
+            persistentCache_->Insert(fileNumber_,misses[i].first,std::string_view(contents[i].data_,contents[i].size_));
+        kvits[slots[i]] = cachedKVIterator(insertKVBlock(blockCacheKey(misses[i]),std::move(contents[i])));
+    }
+    return kvits;
+}
 
+BlockContent SSTable::lookupLowerTiers(const std::string& cacheKey,const std::pair<size_t,size_t>& value)
+{
+    BlockContent content{nullptr,0,true};
+    if(secondaryCache_)
+    {
+        //promote from the compressed tier
+        size_t size = 0;
+        char* data = secondaryCache_->Lookup(cacheKey,&size);
+        content = BlockContent{data,size,true};
     }
-    std::shared_ptr<KVIterator> it = std::shared_ptr<KVIterator>(block->newIterator(),[cache = cache_,entry = entry_](KVIterator* it){
-        cache->Release(entry);
-        delete it;
+    if(content.data_ == nullptr && persistentCache_)
+    {
+        size_t size = 0;
+        char* data = persistentCache_->Lookup(fileNumber_,value.first,&size);
+        content = BlockContent{data,size,true};
+    }
+    return content;
+}
+
+void SSTable::PrefetchBlocks(const std::vector<std::pair<size_t,size_t>>& locations,
+                            const std::function<void(size_t)>& arrived)
+{
+    assert(opened_);
+    std::vector<std::pair<size_t,size_t>> misses;
+    //misses[i] is locations[slots[i]]
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < locations.size(); i++)
+    {
+        const auto & location = locations[i];
+        if(readInPlace(location))
+        {
+            file_->Advise(AccessPattern::kWillNeed,location.first,location.second + kBlockTrailerSize);
+            if(arrived)
+                arrived(i);
+            continue;
+        }
+        std::string cacheKey = blockCacheKey(location);
+        Entry* entry = cache_->Lookup(cacheKey);
+        if(entry == nullptr)
+        {
+            BlockContent content = lookupLowerTiers(cacheKey,location);
+            if(content.data_ == nullptr)
+            {
+                misses.push_back(location);
+                slots.push_back(i);
+                continue;
+            }
+            entry = insertKVBlock(cacheKey,std::move(content));
+        }
+        cache_->Release(entry);
+        if(arrived)
+            arrived(i);
+    }
+    readBlocks(misses,verifyChecksums_,[&](size_t i,BlockContent content){
+        if(persistentCache_)
+            persistentCache_->Insert(fileNumber_,misses[i].first,std::string_view(content.data_,content.size_));
+        cache_->Release(insertKVBlock(blockCacheKey(misses[i]),std::move(content)));
+        if(arrived)
+            arrived(slots[i]);
     });
-    return it;
+}
+
+void SSTable::readahead(const std::vector<std::pair<size_t,size_t>>& locations)
+{
+    if(locations.empty())
+        return;
+    //blocks of a table are laid out back to back
+    size_t begin = locations.front().first;
+    size_t end = locations.back().first + locations.back().second + kBlockTrailerSize;
+    file_->Readahead(begin,end - begin);
+}
+
+std::vector<std::pair<size_t,size_t>> SSTable::BlockLocations()
+{
+    assert(opened_);
+    std::vector<std::pair<size_t,size_t>> locations;
+    std::unique_ptr<IndexIterator> it(newIndexIterator());
+    for (it->SeekForFirst(); it->Valid(); it->Next())
+    {
+        locations.push_back(it->value());
+    }
+    return locations;
 }
 
 BlockContent SSTable::loadKVBlock(const std::pair<size_t,size_t>& location)
 {
-    size_t offset = location.first;
-    size_t size = location.second;
-    void* buf = malloc(size);
-    assert(lseek(fd_,offset,SEEK_SET) == offset);
-    ssize_t hasRead = ::read(fd_,buf,size);
-    assert(hasRead == size);
-    BlockContent content{static_cast<char*>(buf),size,true};
-    return content;
+    return readBlock(location,verifyChecksums_);
 }
 
 
+std::shared_ptr<IndexIterator> SSTable::IndexPartitionReader(const std::pair<size_t,size_t>& location)
+{
+    if(readInPlace(location))
+    {
+        BlockContent content = readBlock(location,true);
+        if(content.data_ == nullptr)
+            return nullptr;
+        IndexBlock* block = new IndexBlock(std::move(content),InternalKeyStringViewComparator{});
+        return std::shared_ptr<IndexIterator>(block->newIterator(),[block](IndexIterator* it){
+            delete it;
+            delete block;
+        });
+    }
+    std::string cacheKey = partitionCacheKey(location);
+    Entry* entry = cache_->Lookup(cacheKey);
+    if(entry == nullptr)
+    {
+        BlockContent content = lookupLowerTiers(cacheKey,location);
+        if(content.data_ == nullptr)
+        {
+            //index blocks are always verified
+            content = readBlock(location,true);
+            if(content.data_ == nullptr)
+                return nullptr;
+            if(persistentCache_)
+                persistentCache_->Insert(fileNumber_,location.first,std::string_view(content.data_,content.size_));
+        }
+        IndexBlock* block = new IndexBlock(std::move(content),InternalKeyStringViewComparator{});
+        entry = cache_->Insert(cacheKey,block,1,IndexBlockDestroy);
+    }
+    IndexBlock* block = static_cast<IndexBlock*>(entry->value_);
+    return std::shared_ptr<IndexIterator>(block->newIterator(),[cache = cache_,entry](IndexIterator* it){
+        cache->Release(entry);
+        delete it;
+    });
+}
+
+//walks the top-level index and the partition each entry points at
+//a partition that fails to load ends the iteration
+class SSTable::PartitionedIndexIterator : public IndexIterator
+{
+private:
+    SSTable* table_;
+    std::unique_ptr<IndexIterator> top_;
+    std::shared_ptr<IndexIterator> partition_;
+    std::pair<size_t,size_t> partitionLocation_{0,0};
+    bool corrupted_{false};
+
+    bool loadPartition()
+    {
+        if(!top_->Valid())
+        {
+            partition_.reset();
+            corrupted_ = false;
+            return false;
+        }
+        if(partition_ && partitionLocation_ == top_->value())
+            return true;
+        partitionLocation_ = top_->value();
+        partition_ = table_->IndexPartitionReader(partitionLocation_);
+        corrupted_ = partition_ == nullptr;
+        return !corrupted_;
+    }
+public:
+    explicit PartitionedIndexIterator(SSTable* table)
+     : table_(table),
+       top_(table->indexBlock_->newIterator())
+    {
+
+    }
+
+    ~PartitionedIndexIterator() override = default;
+
+    bool Valid() const override
+    {
+        return partition_ && top_->Valid() && partition_->Valid();
+    }
+
+    void SeekForFirst() override
+    {
+        top_->SeekForFirst();
+        if(loadPartition())
+            partition_->SeekForFirst();
+    }
+
+    void SeekForLast() override
+    {
+        top_->SeekForLast();
+        if(loadPartition())
+            partition_->SeekForLast();
+    }
+
+    //the top-level key is the last key of its partition, so the partition
+    //found holds an entry >= target
+    void Seek(const std::string_view& target) override
+    {
+        top_->Seek(target);
+        if(loadPartition())
+            partition_->Seek(target);
+    }
+
+    void Next() override
+    {
+        assert(Valid());
+        partition_->Next();
+        if(partition_->Valid())
+            return;
+        top_->Next();
+        if(loadPartition())
+            partition_->SeekForFirst();
+    }
+
+    void Prev() override
+    {
+        assert(Valid());
+        partition_->Prev();
+        if(partition_->Valid())
+            return;
+        top_->Prev();
+        if(loadPartition())
+            partition_->SeekForLast();
+    }
+
+    std::string_view key() const override
+    {
+        return partition_->key();
+    }
+
+    std::pair<size_t,size_t> value() const override
+    {
+        return partition_->value();
+    }
+
+    bool Corrupted() const override
+    {
+        return corrupted_;
+    }
+};
+
+IndexIterator* SSTable::newIndexIterator()
+{
+    if(partitionedIndex_)
+        return new PartitionedIndexIterator(this);
+    return indexBlock_->newIterator();
+}
+
 class SSTable::IteratorImpl : public IteratorBase<std::string_view,std::string_view>
 {
 private:
@@ -81,34 +626,191 @@ private:
     std::shared_ptr<IndexIterator> IndexIt_;
     std::shared_ptr<KVIterator> KVIt_;
     std::pair<size_t,size_t> locationCache_;
-   
-    void updateKVIt()
+
+    //readahead starts after this many blocks read back to back
+    static constexpr size_t kReadaheadTrigger = 2;
+    static constexpr size_t kInitialReadahead = 2;
+    size_t sequentialBlocks_{0};
+    size_t readaheadWindow_{0};
+    //blocks left that the last readahead covered
+    size_t readaheadRemaining_{0};
+
+    //an async readahead batch, read on its own thread while the iterator
+    //walks the blocks before it
+    struct InFlight
     {
-        if(locationCache_ == IndexIt_->value())
+        std::vector<std::pair<size_t,size_t>> locations_;
+        std::vector<bool> arrived_;
+        //set when the batch finished, blocks that failed never arrive
+        bool done_{false};
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::thread worker_;
+    };
+    std::unique_ptr<InFlight> inFlight_;
+
+    //blocks until location is in the cache when the batch in flight covers it
+    void waitFor(const std::pair<size_t,size_t>& location)
+    {
+        if(!inFlight_)
+            return;
+        auto it = std::find(inFlight_->locations_.begin(),inFlight_->locations_.end(),location);
+        if(it == inFlight_->locations_.end())
             return;
+        size_t i = it - inFlight_->locations_.begin();
+        std::unique_lock<std::mutex> lk(inFlight_->mutex_);
+        inFlight_->cond_.wait(lk,[this,i]{ return inFlight_->done_ || inFlight_->arrived_[i]; });
+    }
+
+    void finishInFlight()
+    {
+        if(inFlight_)
+            inFlight_->worker_.join();
+        inFlight_.reset();
+    }
+
+    void startInFlight(std::vector<std::pair<size_t,size_t>> locations)
+    {
+        finishInFlight();
+        inFlight_ = std::make_unique<InFlight>();
+        InFlight* batch = inFlight_.get();
+        batch->arrived_.assign(locations.size(),false);
+        batch->locations_ = std::move(locations);
+        SSTable* table = table_;
+        batch->worker_ = std::thread([table,batch]{
+            table->PrefetchBlocks(batch->locations_,[batch](size_t i){
+                std::lock_guard<std::mutex> lk(batch->mutex_);
+                batch->arrived_[i] = true;
+                batch->cond_.notify_all();
+            });
+            std::lock_guard<std::mutex> lk(batch->mutex_);
+            batch->done_ = true;
+            batch->cond_.notify_all();
+        });
+    }
+
+    //false when the block cannot be read, the iterator turns invalid
+    //forward is set when Next moved onto the block
+    bool updateKVIt(bool forward = false)
+    {
+        if(KVIt_ && locationCache_ == IndexIt_->value())
+            return true;
+        std::pair<size_t,size_t> location = IndexIt_->value();
+        if(forward && KVIt_ && location.first == locationCache_.first + locationCache_.second + kBlockTrailerSize)
+        {
+            sequentialBlocks_++;
+        } else
+        {
+            sequentialBlocks_ = 0;
+            readaheadWindow_ = 0;
+            readaheadRemaining_ = 0;
+        }
         //update new KVIterator
-        locationCache_ = IndexIt_->value();
+        locationCache_ = location;
+        if(sequentialBlocks_ >= kReadaheadTrigger)
+            readahead();
+        waitFor(locationCache_);
         KVIt_ = table_->KVBlockReader(locationCache_);
+        corrupted_ = KVIt_ == nullptr;
+        return !corrupted_;
+    }
+
+    //reads ahead the blocks after the current one once the last window is used up,
+    //the window doubles each time up to maxReadaheadBlocks_, an async batch stays
+    //in flight and the iterator only waits on a block it reaches before it arrived
+    void readahead()
+    {
+        if(readaheadRemaining_ > 0)
+        {
+            readaheadRemaining_--;
+            return;
+        }
+        if(table_->maxReadaheadBlocks_ == 0)
+            return;
+        readaheadWindow_ = readaheadWindow_ == 0 ? kInitialReadahead : readaheadWindow_ * 2;
+        readaheadWindow_ = std::min(readaheadWindow_,table_->maxReadaheadBlocks_);
+        std::vector<std::pair<size_t,size_t>> locations;
+        std::unique_ptr<IndexIterator> ahead(table_->newIndexIterator());
+        ahead->Seek(IndexIt_->key());
+        for (ahead->Next(); ahead->Valid() && locations.size() < readaheadWindow_; ahead->Next())
+        {
+            locations.push_back(ahead->value());
+        }
+        readaheadRemaining_ = locations.size();
+        if(locations.empty())
+            return;
+        if(table_->asyncReadahead())
+            startInFlight(std::move(locations));
+        else
+            table_->readahead(locations);
     }
 
+    //user keys, unbounded when empty
+    std::optional<std::string> lowerBound_;
+    std::optional<std::string> upperBound_;
+    //set once the iterator left the bounds, no block is loaded after that
+    bool outOfBound_{false};
+    //set when a data block could not be read, cleared by the next seek
+    bool corrupted_{false};
+
+    static std::string_view userKey(const std::string_view& ikey)
+    {
+        return std::string_view(ikey.data(),ikey.size() - 8);
+    }
+
+    bool aboveUpper(const std::string_view& ikey) const
+    {
+        return upperBound_ && userKey(ikey) >= *upperBound_;
+    }
+
+    bool belowLower(const std::string_view& ikey) const
+    {
+        return lowerBound_ && userKey(ikey) < *lowerBound_;
+    }
+
+    void checkBounds()
+    {
+        if(Valid() && (aboveUpper(KVIt_->key()) || belowLower(KVIt_->key())))
+            outOfBound_ = true;
+    }
+
+    void seekInternal(const std::string_view& target)
+    {
+        IndexIt_->Seek(target);
+        //past the last key of the table
+        if(!IndexIt_->Valid())
+        {
+            KVIt_.reset();
+            return;
+        }
+
+        assert(InternalKeyStringViewComparator{}(IndexIt_->key(),target) <= 0);
+
+        if(updateKVIt())
+            KVIt_->Seek(target);
+    }
 
-    
 public:
 
-    IteratorImpl(SSTable* table)
+    IteratorImpl(SSTable* table,const ReadOptions& options = ReadOptions{})
      : table_(table),
-       IndexIt_(table_->indexBlock_->newIterator()),
+       IndexIt_(table_->newIndexIterator()),
        KVIt_(nullptr),
-       locationCache_(std::make_pair(0,0))
+       locationCache_(std::make_pair(0,0)),
+       lowerBound_(options.iterateLowerBound_),
+       upperBound_(options.iterateUpperBound_)
     {
 
     }
 
-    ~IteratorImpl() override = default;
+    ~IteratorImpl() override
+    {
+        finishInFlight();
+    }
 
     bool Valid() const override
     {
-        if(KVIt_ && IndexIt_)
+        if(KVIt_ && IndexIt_ && !outOfBound_)
         {
             return KVIt_->Valid() && IndexIt_->Valid();
         }
@@ -117,59 +819,95 @@ public:
 
     void SeekForFirst() override
     {
-        IndexIt_->SeekForFirst();
-        updateKVIt();
-        KVIt_->SeekForFirst();
+        outOfBound_ = false;
+        corrupted_ = false;
+        if(lowerBound_)
+        {
+            seekInternal(InternalKey(*lowerBound_,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode());
+        } else
+        {
+            IndexIt_->SeekForFirst();
+            if(updateKVIt())
+                KVIt_->SeekForFirst();
+        }
+        checkBounds();
     }
 
     void SeekForLast() override
     {
+        outOfBound_ = false;
+        corrupted_ = false;
+        if(upperBound_)
+        {
+            //the last key before the first one at the bound
+            seekInternal(InternalKey(*upperBound_,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode());
+            if(Valid())
+            {
+                Prev();
+                return;
+            }
+        }
         IndexIt_->SeekForLast();
-        updateKVIt();
-        KVIt_->SeekForLast();
+        if(updateKVIt())
+            KVIt_->SeekForLast();
+        checkBounds();
     }
 
     void Seek(const std::string_view& target) override
     {
-        IndexIt_->Seek(target);
-
-        assert(InternalKeyStringViewComparator{}(IndexIt_->key(),target) <= 0);
-
-        updateKVIt();
-        KVIt_->Seek(target);
+        outOfBound_ = false;
+        corrupted_ = false;
+        if(aboveUpper(target))
+        {
+            outOfBound_ = true;
+            return;
+        }
+        if(belowLower(target))
+        {
+            seekInternal(InternalKey(*lowerBound_,kDefaultMaxSequenceNumber,kOpsTypeForSeek).Encode());
+        } else
+        {
+            seekInternal(target);
+        }
+        checkBounds();
     }
 
     void Next() override
     {
         assert(KVIt_);
         KVIt_->Next();
-        if(KVIt_->Valid())
-            return;
-        
-        //TODO 
-        IndexIt_->Next();
-        if(IndexIt_->Valid())
+        if(!KVIt_->Valid())
         {
-            updateKVIt();
-            KVIt_->SeekForFirst();
+            //TODO 
+            IndexIt_->Next();
+            if(IndexIt_->Valid() && updateKVIt(true))
+            {
+                KVIt_->SeekForFirst();
+            }
         }
-
+        checkBounds();
     }
 
     void Prev() override
     {
         assert(KVIt_);
         KVIt_->Prev();
-        if(KVIt_->Valid())
-            return;
-        //TODO
-        
-        IndexIt_->Prev();
-        if(IndexIt_->Valid())
+        if(!KVIt_->Valid())
         {
-            updateKVIt();
-            KVIt_->SeekForLast();
+            //TODO
+            IndexIt_->Prev();
+            //every key of the previous block is below the last one, which is the index key
+            if(IndexIt_->Valid() && belowLower(IndexIt_->key()))
+            {
+                outOfBound_ = true;
+                return;
+            }
+            if(IndexIt_->Valid() && updateKVIt())
+            {
+                KVIt_->SeekForLast();
+            }
         }
+        checkBounds();
     }
 
     std::string_view key() const override
@@ -182,10 +920,70 @@ public:
         return KVIt_->value();
     }
 
+    bool Corrupted() const override
+    {
+        return corrupted_ || IndexIt_->Corrupted();
+    }
+
 };
 
 
 SSTable::Iterator* SSTable::newIterator() 
 {
-    return new SSTable::IteratorImpl(this);
+    return newIterator(ReadOptions{});
+}
+
+//keys of an ingested table carry sequence 0 on disk and the global sequence
+//once read, a single version per user key keeps their order unchanged
+class SSTable::GlobalSequenceIterator : public SSTable::Iterator
+{
+private:
+    std::unique_ptr<Iterator> it_;
+    SequenceNumber seq_;
+    mutable std::string key_;
+public:
+    GlobalSequenceIterator(Iterator* it,SequenceNumber seq)
+     : it_(it),
+       seq_(seq)
+    {
+
+    }
+
+    bool Valid() const override { return it_->Valid(); }
+
+    void SeekForFirst() override { it_->SeekForFirst(); }
+
+    void SeekForLast() override { it_->SeekForLast(); }
+
+    //the version of the target's user key sorts before the target once it carries a
+    //global sequence newer than the target's, the next user key is the first one at or above it
+    void Seek(const std::string_view& target) override
+    {
+        it_->Seek(target);
+        if(it_->Valid() && InternalKeyStringViewComparator{}(key(),target) == 1)
+            it_->Next();
+    }
+
+    void Next() override { it_->Next(); }
+
+    void Prev() override { it_->Prev(); }
+
+    std::string_view key() const override
+    {
+        key_ = it_->key();
+        SetSequence(key_,seq_);
+        return key_;
+    }
+
+    std::string_view value() const override { return it_->value(); }
+
+    bool Corrupted() const override { return it_->Corrupted(); }
+};
+
+SSTable::Iterator* SSTable::newIterator(const ReadOptions& options)
+{
+    Iterator* it = new SSTable::IteratorImpl(this,options);
+    if(globalSequence_ != 0)
+        return new GlobalSequenceIterator(it,globalSequence_);
+    return it;
 }
@@ -3,8 +3,16 @@
 #include <string>
 #include <memory>
 #include <iostream>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <functional>
 #include "./block.h"
+#include "./table_format.h"
 #include "../util/LRUCache.h"
+#include "../util/Options.h"
+#include "../util/format.h"
+#include "../util/FileSystem.h"
 
 
 class SSTable
@@ -13,25 +21,145 @@ private:
 
     InternalKeyUserComparator userComparator_;
 
+    //the top-level index when partitionedIndex_ is set
     std::unique_ptr<IndexBlock> indexBlock_{nullptr};
+    //index partitions are loaded through the block cache on demand
+    bool partitionedIndex_{false};
     //KVBlock cache
     std::shared_ptr<ShardedLRUCache> cache_{nullptr};
+    //compressed tier behind cache_
+    std::shared_ptr<CompressedSecondaryCache> secondaryCache_{nullptr};
+    //distinguishes this table's blocks in a shared cache
+    uint64_t cacheId_{NewCacheId()};
+    //local file tier, keyed by fileNumber_
+    std::shared_ptr<PersistentCache> persistentCache_{nullptr};
+    //batched block reads, synchronous when null
+    std::shared_ptr<AsyncReader> asyncReader_{nullptr};
+
+    uint64_t fileNumber_{0};
 
     bool opened_{false};
 
     std::string fileName_{};
 
-    size_t indexDataoffset_{0};
+    Footer footer_;
+
+    //nullptr for tables written without a properties block
+    std::unique_ptr<TableProperties> properties_{nullptr};
+
+    //non-zero for ingested tables, see TableProperties::globalSequence_
+    SequenceNumber globalSequence_{0};
+
+    //a key of an ingested table is only seen by lookups at or above its sequence
+    bool visible(const std::string_view& target) const
+    {
+        return globalSequence_ == 0 || ExtractSequence(target) >= globalSequence_;
+    }
+
+    //handle sees ikey with the global sequence when there is one
+    template<typename F>
+    void withGlobalSequence(const std::string_view& ikey,const std::string_view& value,F&& handle) const
+    {
+        if(globalSequence_ == 0)
+        {
+            handle(ikey,value);
+            return;
+        }
+        std::string key(ikey);
+        SetSequence(key,globalSequence_);
+        handle(std::string_view(key),value);
+    }
+
+    bool verifyChecksums_{true};
+
+    //one bit per 8 bytes of the mapping, set once the block starting there passed
+    //its checksum, a block with its trailer is never shorter than 8 bytes so no two
+    //blocks share a bit, read without a lock on every mapped access
+    std::unique_ptr<std::atomic<uint64_t>[]> verifiedMapped_;
+
+    bool verifyMapped(const char* buf,size_t offset,size_t size);
+
+    size_t maxReadaheadBlocks_{0};
 
     size_t totalSize_{0};
-    
-    int fd_{-1};
 
-    void loadIndexblock();
+    //a compressed block claiming a longer uncompressed length is corrupted,
+    //checked before the buffer is allocated
+    size_t maxBlockLength_{0};
+    static constexpr size_t kMaxBlockSizeMultiple = 1024;
+    //varint lengths, a restart and hash index bytes of one entry, generously
+    static constexpr size_t kMaxEntryOverhead = 64;
+
+    //positional reads only, shared by all readers of this table
+    std::unique_ptr<RandomAccessFile> file_{nullptr};
+
+    void loadIndexblock(const Options& options);
+
+    void loadProperties();
+
+    void setMaxBlockLength(const Options& options);
+
+    //reads the block and its trailer, data_ is nullptr on a failed read or checksum
+    BlockContent readBlock(const std::pair<size_t,size_t>& location,bool verify);
+
+    //reads every block with one batch of async reads, a failed block has data_ nullptr
+    std::vector<BlockContent> readBlocks(const std::vector<std::pair<size_t,size_t>>& locations,bool verify);
+
+    //same batch, done(i,content) runs as block i is read, failed blocks are skipped
+    void readBlocks(const std::vector<std::pair<size_t,size_t>>& locations,bool verify,
+                    const std::function<void(size_t,BlockContent)>& done);
+
+    //readahead goes through the async reader rather than the kernel
+    bool asyncReadahead() const
+    {
+        return asyncReader_ && file_->Mapped() == nullptr;
+    }
+
+    //kernel readahead over the byte range of the blocks
+    void readahead(const std::vector<std::pair<size_t,size_t>>& locations);
+
+    //checks the trailer and decompresses, takes ownership of the malloc'd buf
+    BlockContent decodeBlock(char* buf,size_t size,bool verify);
+
+    //decompresses into a malloc'd buffer, compressed stays with the caller
+    BlockContent uncompressBlock(CompressionType type,const std::string_view& compressed);
+
+    //iterator over a block read in place from the mapping, bypasses the caches
+    std::shared_ptr<KVIterator> mappedKVBlockReader(const std::pair<size_t,size_t>& location);
     
     BlockContent loadKVBlock(const std::pair<size_t,size_t>& location);
 
     std::shared_ptr<KVIterator> KVBlockReader(const std::pair<size_t,size_t>& location);
+
+    //one iterator per location, blocks missing from every cache are read in one batch,
+    //nullptr for a block that failed to load
+    std::vector<std::shared_ptr<KVIterator>> KVBlockReaders(const std::vector<std::pair<size_t,size_t>>& locations);
+
+    std::shared_ptr<KVIterator> cachedKVIterator(Entry* entry)
+    {
+        KVBlock* block = static_cast<KVBlock*>(entry->value_);
+        return std::shared_ptr<KVIterator>(block->newIterator(),[cache = cache_,entry](KVIterator* it){
+            cache->Release(entry);
+            delete it;
+        });
+    }
+
+    //the tiers behind the block cache, data_ is nullptr when neither has the block
+    BlockContent lookupLowerTiers(const std::string& cacheKey,const std::pair<size_t,size_t>& location);
+
+    Entry* insertKVBlock(const std::string& cacheKey,BlockContent&& content)
+    {
+        KVBlock* block = new KVBlock(std::move(content),InternalKeyStringViewComparator{});
+        return cache_->Insert(cacheKey,block,1,KVBlockDestroy);
+    }
+
+    //mapped uncompressed blocks are read in place
+    bool readInPlace(const std::pair<size_t,size_t>& location) const
+    {
+        const char* mapped = file_->Mapped();
+        return mapped != nullptr && location.first + location.second + kBlockTrailerSize <= totalSize_ &&
+            BlockTrailerType(mapped + location.first,location.second) == CompressionType::kNoCompression;
+    }
     
     void InsertKVBlockToCache(std::string key,KVBlock* block)
     {
@@ -39,9 +167,43 @@ private:
         cache_->Release(entry);
     }
 
-    std::string pairToString(const std::pair<size_t,size_t>& value) const
+    std::string blockCacheKey(const std::pair<size_t,size_t>& location) const
+    {
+        std::string key;
+        AppendUINT64(key,cacheId_);
+        AppendUINT64(key,location.first);
+        return key;
+    }
+
+    //tells index partitions apart from KVBlocks in the shared cache
+    static constexpr char kIndexPartitionTag = 'i';
+
+    std::string partitionCacheKey(const std::pair<size_t,size_t>& location) const
     {
-        return std::to_string(value.first) + std::to_string(value.second);
+        return blockCacheKey(location) + kIndexPartitionTag;
+    }
+
+    static bool isPartitionCacheKey(const std::string& key)
+    {
+        return key.size() == 2 * sizeof(uint64_t) + 1 && key.back() == kIndexPartitionTag;
+    }
+
+    //iterator over the whole index, partitioned or not
+    IndexIterator* newIndexIterator();
+
+    //nullptr when the partition failed to load
+    std::shared_ptr<IndexIterator> IndexPartitionReader(const std::pair<size_t,size_t>& location);
+
+    static void IndexBlockDestroy(const std::string& key,void* value)
+    {
+        IndexBlock* block = static_cast<IndexBlock*>(value);
+        delete block;
+    }
+
+    static uint64_t NewCacheId()
+    {
+        static std::atomic<uint64_t> nextId{1};
+        return nextId.fetch_add(1,std::memory_order_relaxed);
     }
 
     static void KVBlockDestroy(const std::string& key,void* value)
@@ -52,30 +214,78 @@ private:
 
     class IteratorImpl;
 
+    class GlobalSequenceIterator;
+
+    //folds MERGE entries in InternalGet, null returns them as they are
+    std::shared_ptr<MergeOperator> mergeOperator_{nullptr};
+
+    static std::string_view userKeyOf(const std::string_view& ikey)
+    {
+        return ikey.substr(0,ikey.size() - 8);
+    }
+
+    //walks the versions of key from its newest MERGE down to a base value, see InternalGet
+    template<typename F>
+    int foldMerge(const std::string_view& key,MergeContext* context,std::string* newestKey,F&& handle)
+    {
+        std::unique_ptr<Iterator> it(newIterator());
+        for (it->Seek(key); it->Valid() && userComparator_(it->key(),key) == 0; it->Next())
+        {
+            if(newestKey->empty())
+                *newestKey = it->key();
+            OpsType type = ExtractOpsType(it->key());
+            if(type == OpsType::MERGE)
+            {
+                context->PushOperand(it->value());
+                continue;
+            }
+            if(type == OpsType::BLOB_INDEX)
+            {
+                handle(it->key(),it->value());
+                return kMergeOntoBlob;
+            }
+            std::string result;
+            std::string_view base = it->value();
+            if(!context->Fold(*mergeOperator_,userKeyOf(key),type == OpsType::DELETE ? nullptr : &base,&result))
+                return kCorruption;
+            context->Clear();
+            SetOpsType(*newestKey,OpsType::UPDATE);
+            handle(std::string_view(*newestKey),std::string_view(result));
+            return 0;
+        }
+        return kMergeInProgress;
+    }
+
+    class PartitionedIndexIterator;
+
+    static void installEvictionHook(ShardedLRUCache& cache,const std::shared_ptr<CompressedSecondaryCache>& secondaryCache);
+
 public:
+    static constexpr int kCorruption = -2;
+    static constexpr int kMergeInProgress = 1;
+    static constexpr int kMergeOntoBlob = 2;
+
     SSTable() = default;
     ~SSTable();
 
 
-    void OpenTable(const std::string& filename)
-    {
-        fileName_ = filename;
-        loadIndexblock();
-        //TODO
-        cache_ = ShardedLRUCache::NewCache(64);
-    }
+    void OpenTable(const std::string& filename,const Options& options = Options{},uint64_t fileNumber = 0);
+
+    //demotes blocks evicted from options.blockCache_ into options.secondaryCache_, called once
+    //where the two caches are set up since every table shares the hook. TableCache does it
+    static void InstallSecondaryCache(const Options& options);
 
-    static std::shared_ptr<SSTable> newTable(const std::string& filename)
+    static std::shared_ptr<SSTable> newTable(const std::string& filename,const Options& options = Options{},uint64_t fileNumber = 0)
     {
         auto table = std::make_shared<SSTable>();
-        table->OpenTable(filename);
+        table->OpenTable(filename,options,fileNumber);
         return table;
     }
 
-    static SSTable* newTableRaw(const std::string& filename)
+    static SSTable* newTableRaw(const std::string& filename,const Options& options = Options{},uint64_t fileNumber = 0)
     {
         SSTable* table = new SSTable;
-        table->OpenTable(filename);
+        table->OpenTable(filename,options,fileNumber);
         return table;
     }
 
@@ -83,40 +293,198 @@ public:
 
     SSTable& operator = (const SSTable&) = delete;
     
+    //0 if found, -1 if not, kCorruption if the block failed to load or a merge failed.
+    //with a merge operator the operands of a key are folded onto its older versions in the
+    //table, kMergeInProgress when the base value is in an older table or a blob file,
+    //the overload below carries the operands on
     template<typename F>
     int InternalGet(const std::string_view& key,F&& handle)
+    {
+        MergeContext context;
+        std::string newestKey;
+        int ret = InternalGet(key,&context,&newestKey,[&handle,&context](const std::string_view& ikey,const std::string_view& value){
+            //a blob base comes with the operands still to fold
+            if(context.empty())
+                handle(ikey,value);
+        });
+        return ret == kMergeOntoBlob ? kMergeInProgress : ret;
+    }
+
+    //as above for a lookup that goes on from newer tables: context holds their operands,
+    //newest first, and newestKey the key of the newest one, empty when unknown. operands
+    //are folded onto the first base value and handle gets the result under newestKey.
+    //without a base the table's operands are added and kMergeInProgress is returned for the
+    //caller to go on in older tables. a blob reference as base is handed over as it is with
+    //the operands left in context and kMergeOntoBlob returned
+    template<typename F>
+    int InternalGet(const std::string_view& lookupKey,MergeContext* context,std::string* newestKey,F&& handle)
     {
         assert(opened_);
+        const SeekKey target(lookupKey);
+        const std::string_view key = target.Encode();
         bool find = false;
-        IndexIterator* iit = indexBlock_->newIterator();
+        IndexIterator* iit = newIndexIterator();
         iit->Seek(key);
         if(iit->Valid())
         {
             std::shared_ptr<KVIterator> kvit = KVBlockReader(iit->value());
-            kvit->Seek(key);
-            std::string_view ikey = kvit->key();
-            if(userComparator_(ikey,key) == 0)
+            if(kvit == nullptr)
             {
+                delete iit;
+                return kCorruption;
+            }
+            kvit->SeekForGet(key);
+            if(kvit->Valid() && userComparator_(kvit->key(),key) == 0 && visible(key))
+            {
+                if(mergeOperator_ != nullptr && (ExtractOpsType(kvit->key()) == OpsType::MERGE || !context->empty()))
+                {
+                    delete iit;
+                    return foldMerge(key,context,newestKey,handle);
+                }
                 find = true;
-                handle(kvit->key(),kvit->value());
+                withGlobalSequence(kvit->key(),kvit->value(),handle);
             }
         }
         delete iit;
+        if(!find && mergeOperator_ != nullptr && !context->empty())
+            return kMergeInProgress;
         return find ? 0 : -1;
     }
-   
+
+    //looks up every key with one pass over the index, keys that fall in the same
+    //block share one read of it and blocks missing from the caches are read in one batch
+    //results[i] is 0, -1 or kCorruption as for InternalGet, handle(i,ikey,value) runs for found keys
+    template<typename F>
+    void MultiGet(const std::vector<std::string_view>& lookupKeys,std::vector<int>& results,F&& handle)
+    {
+        assert(opened_);
+        //one buffer holds every target
+        std::string buffer;
+        size_t total = 0;
+        for (const auto & lookupKey : lookupKeys)
+        {
+            total += lookupKey.size();
+        }
+        buffer.reserve(total);
+        std::vector<std::string_view> keys;
+        keys.reserve(lookupKeys.size());
+        for (const auto & lookupKey : lookupKeys)
+        {
+            buffer.append(lookupKey);
+            buffer[buffer.size() - 8] = static_cast<char>(kOpsTypeForSeek);
+        }
+        for (size_t i = 0, offset = 0; i < lookupKeys.size(); offset += lookupKeys[i].size(), i++)
+        {
+            keys.emplace_back(buffer.data() + offset,lookupKeys[i].size());
+        }
+        InternalKeyStringViewComparator comparator;
+        results.assign(keys.size(),-1);
+        std::vector<size_t> order(keys.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::sort(order.begin(),order.end(),[&keys,&comparator](size_t l,size_t r){
+            return comparator(keys[l],keys[r]) > 0;
+        });
+
+        //groups[i] holds the keys that fall in locations[i]
+        std::vector<std::pair<size_t,size_t>> locations;
+        std::vector<std::vector<size_t>> groups;
+        std::unique_ptr<IndexIterator> iit(newIndexIterator());
+        bool positioned = false;
+        for (size_t i : order)
+        {
+            //the block holding the previous key may hold this one too
+            if(!positioned || comparator(iit->key(),keys[i]) > 0)
+            {
+                iit->Seek(keys[i]);
+                positioned = true;
+            }
+            //every later key is past the last block as well
+            if(!iit->Valid())
+                break;
+            if(locations.empty() || locations.back() != iit->value())
+            {
+                locations.push_back(iit->value());
+                groups.emplace_back();
+            }
+            groups.back().push_back(i);
+        }
+
+        std::vector<std::shared_ptr<KVIterator>> kvits = KVBlockReaders(locations);
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            for (size_t i : groups[g])
+            {
+                if(kvits[g] == nullptr)
+                {
+                    results[i] = kCorruption;
+                    continue;
+                }
+                kvits[g]->SeekForGet(keys[i]);
+                if(kvits[g]->Valid() && userComparator_(kvits[g]->key(),keys[i]) == 0 && visible(keys[i]))
+                {
+                    results[i] = 0;
+                    withGlobalSequence(kvits[g]->key(),kvits[g]->value(),[&handle,i](const std::string_view& ikey,const std::string_view& value){
+                        handle(i,ikey,value);
+                    });
+                }
+            }
+        }
+    }
+
     bool isOpen() const
     {
         return opened_;
     }
 
+    bool isMapped() const
+    {
+        return file_ && file_->Mapped() != nullptr;
+    }
+
+    //loads the block at location into the block cache
+    void PrefetchBlock(const std::pair<size_t,size_t>& location)
+    {
+        KVBlockReader(location);
+    }
+
+    //loads every block missing from the caches with one batch of reads,
+    //arrived(i) runs once locations[i] can be read from the cache
+    void PrefetchBlocks(const std::vector<std::pair<size_t,size_t>>& locations,
+                        const std::function<void(size_t)>& arrived = nullptr);
+
+    //(offset, size) of every data block in key order
+    std::vector<std::pair<size_t,size_t>> BlockLocations();
+
     size_t totalSize() const
     {
         return totalSize_;
     }
 
+    //offset of the data block that would hold key, the end of the data blocks past the
+    //last key, read from the index alone
+    uint64_t ApproximateOffsetOf(const std::string_view& key);
+
+    //user keys in [start,limit) that end a data block, read from the index alone
+    std::vector<std::string> BlockBoundaries(const std::string_view& start,const std::string_view& limit);
+
+    //stamps an ingested table with its global sequence by rewriting its properties block
+    //in place, -1 when the table has no properties block or the write fails
+    static int WriteGlobalSequence(const std::string& fileName,SequenceNumber seq);
+
+    //read at open from the meta block, nullptr when the table has none
+    const TableProperties* Properties() const
+    {
+        return properties_.get();
+    }
+
     using Iterator = IteratorBase<std::string_view,std::string_view>;
     
     Iterator* newIterator();
+
+    //the iterator turns invalid at the bounds without loading blocks past them
+    Iterator* newIterator(const ReadOptions& options);
 };
 
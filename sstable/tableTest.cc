@@ -3,9 +3,13 @@
 #include <vector>
 #include <random>
 #include <algorithm>
+#include <thread>
 
 #include "./table_builder.h"
 #include "./table.h"
+#include "./table_cache.h"
+#include "../util/fname.h"
+#include "../util/TestMergeOperators.h"
 
 using KVMap = std::map<std::string,std::string>;
 
@@ -117,3 +121,820 @@ TEST(table,BuildAndLoad)
 }
 
 
+
+TEST(table,SecondaryCache)
+{
+    std::remove("test_secondary.table");
+    TableBuilder builder("test_secondary.table");
+    KVMap kvMap;
+    for (size_t i = 0; i < 10240; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey + randomKey));
+    }
+    SequenceNumber seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,seq++,OpsType::UPDATE);
+        builder.Add(ikey.Encode(),std::string_view(v));
+    }
+    builder.Finish();
+
+    Options options;
+    options.blockCache_ = ShardedLRUCache::NewCache(16);
+    options.secondaryCache_ = CompressedSecondaryCache::NewCache(64 << 20);
+    SSTable::InstallSecondaryCache(options);
+    std::shared_ptr<SSTable> table = SSTable::newTable(builder.FileName(),options);
+    ASSERT_TRUE(table->isOpen());
+
+    for (int round = 0; round < 2; round++)
+    {
+        for (const auto& [k,v] : kvMap)
+        {
+            InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+            std::string value;
+            ASSERT_EQ(table->InternalGet(ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+                value = val;
+            }),0);
+            ASSERT_EQ(value,v);
+        }
+    }
+    auto stats = options.secondaryCache_->GetStats();
+    ASSERT_GT(stats.inserts_,0);
+    ASSERT_GT(stats.hits_,0);
+}
+
+static void FlipByte(const std::string& filename,off_t offset)
+{
+    int fd = ::open(filename.c_str(),O_RDWR);
+    ASSERT_GE(fd,0);
+    if(offset < 0)
+        offset += lseek(fd,0,SEEK_END);
+    char c;
+    ASSERT_EQ(::pread(fd,&c,1,offset),1);
+    c ^= 0x1;
+    ASSERT_EQ(::pwrite(fd,&c,1,offset),1);
+    ::close(fd);
+}
+
+TEST(table,Checksum)
+{
+    std::remove("test_checksum.table");
+    Options raw;
+    raw.compression_ = CompressionType::kNoCompression;
+    TableBuilder builder("test_checksum.table",raw);
+    KVMap kvMap;
+    for (size_t i = 0; i < 1024; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    SequenceNumber seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,seq++,OpsType::UPDATE);
+        builder.Add(ikey.Encode(),std::string_view(v));
+    }
+    builder.Finish();
+    InternalKey first(kvMap.begin()->first,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    InternalKey last(kvMap.rbegin()->first,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    auto ignore = [](const std::string_view&,const std::string_view&){};
+
+    //corrupt the first data block
+    FlipByte(builder.FileName(),100);
+    {
+        std::shared_ptr<SSTable> table = SSTable::newTable(builder.FileName());
+        ASSERT_TRUE(table->isOpen());
+        ASSERT_EQ(table->InternalGet(first.Encode(),ignore),SSTable::kCorruption);
+        ASSERT_EQ(table->InternalGet(last.Encode(),ignore),0);
+        std::shared_ptr<SSTable::Iterator> it(table->newIterator());
+        it->SeekForFirst();
+        ASSERT_FALSE(it->Valid());
+    }
+    {
+        Options options;
+        options.verifyChecksums_ = false;
+        std::shared_ptr<SSTable> table = SSTable::newTable(builder.FileName(),options);
+        ASSERT_NE(table->InternalGet(first.Encode(),ignore),SSTable::kCorruption);
+    }
+
+    //corrupt the magic number
+    FlipByte(builder.FileName(),-1);
+    std::shared_ptr<SSTable> table = SSTable::newTable(builder.FileName());
+    ASSERT_FALSE(table->isOpen());
+}
+
+static size_t BuildTable(const std::string& filename,const KVMap& kvMap,const Options& options)
+{
+    std::remove(filename.c_str());
+    TableBuilder builder(filename,options);
+    SequenceNumber seq = 1;
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,seq++,OpsType::UPDATE);
+        builder.Add(ikey.Encode(),std::string_view(v));
+    }
+    builder.Finish();
+    struct stat st;
+    ::stat(filename.c_str(),&st);
+    return st.st_size;
+}
+
+TEST(table,Compression)
+{
+    KVMap compressible;
+    KVMap incompressible;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        compressible.insert(std::make_pair(randomKey,std::string(100,'a' + i % 26)));
+        incompressible.insert(std::make_pair(randomKey,std::string(RandomString())));
+    }
+    Options raw;
+    raw.compression_ = CompressionType::kNoCompression;
+    Options lz;
+    lz.compression_ = CompressionType::kLZCompression;
+
+    size_t rawSize = BuildTable("test_raw.table",compressible,raw);
+    size_t lzSize = BuildTable("test_lz.table",compressible,lz);
+    ASSERT_LT(lzSize * 2,rawSize);
+
+    //blocks that do not shrink enough are stored raw
+    rawSize = BuildTable("test_raw.table",incompressible,raw);
+    lzSize = BuildTable("test_lz.table",incompressible,lz);
+    ASSERT_LE(lzSize,rawSize);
+    ASSERT_GT(lzSize,rawSize * 0.95);
+
+    BuildTable("test_lz.table",compressible,lz);
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_lz.table");
+    ASSERT_TRUE(table->isOpen());
+    std::shared_ptr<SSTable::Iterator> it(table->newIterator());
+    it->SeekForFirst();
+    for (const auto & [k,v] : compressible)
+    {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),k);
+        ASSERT_EQ(it->value(),v);
+        it->Next();
+    }
+    ASSERT_FALSE(it->Valid());
+}
+
+//a compressed block claiming an absurd length is rejected before it is allocated
+TEST(table,UncompressedLength)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        kvMap.insert(std::make_pair(std::string(RandomString()),std::string(100,'a' + i % 26)));
+    }
+    Options lz;
+    lz.compression_ = CompressionType::kLZCompression;
+    BuildTable("test_length.table",kvMap,lz);
+    //the first data block starts with its length as a varint, claim 4GB
+    int fd = ::open("test_length.table",O_RDWR);
+    ASSERT_GE(fd,0);
+    const unsigned char length[] = {0xff,0xff,0xff,0xff,0x0f};
+    ASSERT_EQ(::pwrite(fd,length,sizeof(length),0),sizeof(length));
+    ::close(fd);
+
+    Options options;
+    options.verifyChecksums_ = false;
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_length.table",options);
+    ASSERT_TRUE(table->isOpen());
+    auto ignore = [](const std::string_view&,const std::string_view&){};
+    InternalKey first(kvMap.begin()->first,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    InternalKey last(kvMap.rbegin()->first,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    ASSERT_EQ(table->InternalGet(first.Encode(),ignore),SSTable::kCorruption);
+    ASSERT_EQ(table->InternalGet(last.Encode(),ignore),0);
+}
+
+TEST(table,ConcurrentReads)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 8192; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    BuildTable("test_concurrent.table",kvMap,Options{});
+    Options options;
+    //keep evicting so readers hit the file at the same time
+    options.blockCache_ = ShardedLRUCache::NewCache(16);
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_concurrent.table",options);
+    ASSERT_TRUE(table->isOpen());
+
+    std::vector<std::pair<std::string,std::string>> kvs(kvMap.begin(),kvMap.end());
+    std::atomic<size_t> found{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 8; t++)
+    {
+        readers.emplace_back([&kvs,&table,&found,t](){
+            std::mt19937 generator(t);
+            for (size_t i = 0; i < kvs.size(); i++)
+            {
+                const auto & [k,v] = kvs[generator() % kvs.size()];
+                InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+                table->InternalGet(ikey.Encode(),[&v,&found](const std::string_view&,const std::string_view& value){
+                    if(value == v)
+                        found++;
+                });
+            }
+        });
+    }
+    for (auto & reader : readers)
+    {
+        reader.join();
+    }
+    ASSERT_EQ(found.load(),8 * kvs.size());
+}
+
+TEST(table,MmapReads)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    Options raw;
+    raw.compression_ = CompressionType::kNoCompression;
+    size_t fileSize = BuildTable("test_mmap.table",kvMap,raw);
+
+    Options options;
+    options.useMmapReads_ = true;
+    //room for one table only
+    options.mmapLimiter_ = std::make_shared<MmapLimiter>(fileSize + fileSize / 2);
+    options.blockCache_ = ShardedLRUCache::NewCache(64);
+    {
+        std::shared_ptr<SSTable> mapped = SSTable::newTable("test_mmap.table",options);
+        std::shared_ptr<SSTable> unmapped = SSTable::newTable("test_mmap.table",options);
+        ASSERT_TRUE(mapped->isMapped());
+        ASSERT_FALSE(unmapped->isMapped());
+        ASSERT_EQ(options.mmapLimiter_->Usage(),fileSize);
+
+        auto readAll = [&kvMap](SSTable* table){
+            for (const auto & [k,v] : kvMap)
+            {
+                InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+                std::string value;
+                ASSERT_EQ(table->InternalGet(ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+                    value = val;
+                }),0);
+                ASSERT_EQ(value,v);
+            }
+            std::unique_ptr<SSTable::Iterator> it(table->newIterator());
+            size_t n = 0;
+            for (it->SeekForFirst(); it->Valid(); it->Next())
+            {
+                n++;
+            }
+            ASSERT_EQ(n,kvMap.size());
+        };
+        readAll(mapped.get());
+        //mapped blocks are read in place and never enter the block cache
+        ASSERT_EQ(options.blockCache_->TotalCharge(),0);
+        readAll(unmapped.get());
+        ASSERT_GT(options.blockCache_->TotalCharge(),0);
+    }
+    ASSERT_EQ(options.mmapLimiter_->Usage(),0);
+
+    //compressed blocks of a mapped table still go through the cache
+    BuildTable("test_mmap.table",kvMap,Options{});
+    std::shared_ptr<SSTable> compressed = SSTable::newTable("test_mmap.table",options);
+    ASSERT_TRUE(compressed->isMapped());
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        ASSERT_EQ(compressed->InternalGet(ikey.Encode(),[](const std::string_view&,const std::string_view&){}),0);
+    }
+}
+
+TEST(table,AsyncPrefetch)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    BuildTable("test_async.table",kvMap,Options{});
+    Options options;
+    options.blockCache_ = ShardedLRUCache::NewCache(1 << 20);
+    options.asyncReader_ = AsyncReader::NewDefault();
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_async.table",options);
+    ASSERT_TRUE(table->isOpen());
+
+    std::vector<std::pair<size_t,size_t>> locations = table->BlockLocations();
+    ASSERT_GT(locations.size(),1);
+    table->PrefetchBlocks(locations);
+    ASSERT_EQ(options.blockCache_->TotalCharge(),locations.size());
+    //cached blocks are not read again
+    table->PrefetchBlocks(locations);
+    ASSERT_EQ(options.blockCache_->TotalCharge(),locations.size());
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        std::string value;
+        ASSERT_EQ(table->InternalGet(ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+            value = val;
+        }),0);
+        ASSERT_EQ(value,v);
+    }
+    ASSERT_EQ(options.blockCache_->TotalCharge(),locations.size());
+}
+
+TEST(table,MultiGet)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey + "_value"));
+    }
+    BuildTable("test_multiget.table",kvMap,Options{});
+
+    //present keys, absent keys and repeats, in random order
+    std::vector<std::string> userKeys;
+    for (const auto & [k,v] : kvMap)
+    {
+        userKeys.push_back(k);
+        if(userKeys.size() % 3 == 0)
+            userKeys.push_back(k + "_absent");
+        if(userKeys.size() % 7 == 0)
+            userKeys.push_back(k);
+    }
+    userKeys.push_back(std::string(64,'\xff'));
+    std::shuffle(userKeys.begin(),userKeys.end(),std::mt19937(3));
+    std::vector<std::string> ikeys;
+    for (const auto & k : userKeys)
+    {
+        ikeys.push_back(std::string(InternalKey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode()));
+    }
+    std::vector<std::string_view> keys(ikeys.begin(),ikeys.end());
+
+    Options async;
+    async.asyncReader_ = AsyncReader::NewDefault();
+    for (const Options & options : {Options{},async})
+    {
+        Options opts = options;
+        opts.blockCache_ = ShardedLRUCache::NewCache(1 << 20);
+        std::shared_ptr<SSTable> table = SSTable::newTable("test_multiget.table",opts);
+        std::vector<std::string> values(keys.size());
+        std::vector<int> results;
+        table->MultiGet(keys,results,[&values](size_t i,const std::string_view&,const std::string_view& value){
+            values[i] = value;
+        });
+        ASSERT_EQ(results.size(),keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            auto it = kvMap.find(userKeys[i]);
+            if(it == kvMap.end())
+            {
+                ASSERT_EQ(results[i],-1);
+            } else
+            {
+                ASSERT_EQ(results[i],0);
+                ASSERT_EQ(values[i],it->second);
+            }
+        }
+        //every block was read once
+        ASSERT_EQ(opts.blockCache_->TotalCharge(),table->BlockLocations().size());
+    }
+}
+
+TEST(table,HashIndex)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey + "_value"));
+    }
+    Options hashed;
+    hashed.compression_ = CompressionType::kNoCompression;
+    hashed.blockHashIndex_ = true;
+    Options plain = hashed;
+    plain.blockHashIndex_ = false;
+    //the index costs a little space
+    size_t plainSize = BuildTable("test_hash.table",kvMap,plain);
+    size_t hashedSize = BuildTable("test_hash.table",kvMap,hashed);
+    ASSERT_GT(hashedSize,plainSize);
+    ASSERT_LT(hashedSize,plainSize * 1.1);
+
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_hash.table",hashed);
+    ASSERT_TRUE(table->isOpen());
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        std::string value;
+        ASSERT_EQ(table->InternalGet(ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+            value = val;
+        }),0);
+        ASSERT_EQ(value,v);
+        InternalKey absent(k + "_absent",kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        ASSERT_EQ(table->InternalGet(absent.Encode(),[](const std::string_view&,const std::string_view&){}),-1);
+    }
+
+    std::shared_ptr<SSTable::Iterator> it(table->newIterator());
+    it->SeekForFirst();
+    for (const auto & [k,v] : kvMap)
+    {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),k);
+        it->Next();
+    }
+    ASSERT_FALSE(it->Valid());
+}
+
+TEST(table,FixedSizeBlocks)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString()).substr(0,16);
+        kvMap.insert(std::make_pair(randomKey,randomKey.substr(0,8)));
+    }
+    Options fixed;
+    fixed.compression_ = CompressionType::kNoCompression;
+    fixed.fixedSizeBlocks_ = true;
+    Options plain = fixed;
+    plain.fixedSizeBlocks_ = false;
+    size_t plainSize = BuildTable("test_fixed.table",kvMap,plain);
+    size_t fixedSize = BuildTable("test_fixed.table",kvMap,fixed);
+    ASSERT_LT(fixedSize,plainSize * 0.9);
+
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_fixed.table",fixed);
+    ASSERT_TRUE(table->isOpen());
+    for (const auto & [k,v] : kvMap)
+    {
+        InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+        std::string value;
+        ASSERT_EQ(table->InternalGet(ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+            value = val;
+        }),0);
+        ASSERT_EQ(value,v);
+    }
+    std::shared_ptr<SSTable::Iterator> it(table->newIterator());
+    it->SeekForLast();
+    for (auto rit = kvMap.rbegin(); rit != kvMap.rend(); rit++)
+    {
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(ExtraceUserKey(it->key()),rit->first);
+        it->Prev();
+    }
+    ASSERT_FALSE(it->Valid());
+}
+
+TEST(table,Properties)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey + "_value"));
+    }
+    Options options;
+    options.indexPartitionSize_ = 1024;
+    time_t before = time(nullptr);
+    TableBuilder builder("test_properties.table",options);
+    SequenceNumber seq = 100;
+    uint64_t rawKeySize = 0;
+    uint64_t rawValueSize = 0;
+    size_t deletions = 0;
+    for (const auto & [k,v] : kvMap)
+    {
+        OpsType type = seq % 5 == 0 ? OpsType::DELETE : OpsType::UPDATE;
+        std::string_view value = type == OpsType::DELETE ? std::string_view() : std::string_view(v);
+        deletions += type == OpsType::DELETE;
+        InternalKey ikey(k,seq++,type);
+        builder.Add(ikey.Encode(),value);
+        rawKeySize += ikey.Encode().size();
+        rawValueSize += value.size();
+    }
+    ASSERT_EQ(builder.Finish(),0);
+
+    Options readOptions;
+    readOptions.blockCache_ = ShardedLRUCache::NewCache(64);
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_properties.table",readOptions);
+    ASSERT_TRUE(table->isOpen());
+    //no data block or index partition was read
+    ASSERT_EQ(readOptions.blockCache_->TotalCharge(),0);
+    const TableProperties* properties = table->Properties();
+    ASSERT_NE(properties,nullptr);
+    ASSERT_EQ(properties->numEntries_,kvMap.size());
+    ASSERT_EQ(properties->numDeletions_,deletions);
+    ASSERT_EQ(properties->numBlobIndexes_,0);
+    ASSERT_EQ(properties->rawKeySize_,rawKeySize);
+    ASSERT_EQ(properties->rawValueSize_,rawValueSize);
+    ASSERT_EQ(properties->minSequence_,100);
+    ASSERT_EQ(properties->maxSequence_,seq - 1);
+    ASSERT_EQ(ExtraceUserKey(properties->smallestKey_),kvMap.begin()->first);
+    ASSERT_EQ(ExtraceUserKey(properties->largestKey_),kvMap.rbegin()->first);
+    ASSERT_GE(properties->creationTime_,static_cast<uint64_t>(before));
+    ASSERT_LE(properties->creationTime_,static_cast<uint64_t>(time(nullptr)));
+    ASSERT_EQ(properties->numDataBlocks_,table->BlockLocations().size());
+    //data, index, properties and footer make up the file
+    std::string encoded;
+    properties->EncodeTo(encoded);
+    ASSERT_EQ(properties->dataSize_ + properties->indexSize_ + encoded.size() + kBlockTrailerSize + Footer::kEncodedLength,
+                table->totalSize());
+    ASSERT_EQ(builder.Properties().numEntries_,properties->numEntries_);
+}
+
+TEST(table,Readahead)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 8192; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    BuildTable("test_readahead.table",kvMap,Options{});
+
+    //blocks in the cache after scanning half of the table
+    auto scanHalf = [&kvMap](Options options){
+        options.blockCache_ = ShardedLRUCache::NewCache(1 << 20);
+        std::shared_ptr<SSTable> table = SSTable::newTable("test_readahead.table",options);
+        std::unique_ptr<SSTable::Iterator> it(table->newIterator());
+        auto mit = kvMap.begin();
+        it->SeekForFirst();
+        for (size_t i = 0; i < kvMap.size() / 2; i++,mit++)
+        {
+            EXPECT_TRUE(it->Valid());
+            EXPECT_EQ(ExtraceUserKey(it->key()),mit->first);
+            it->Next();
+        }
+        //readahead still in flight lands before the iterator is gone
+        it.reset();
+        return options.blockCache_->TotalCharge();
+    };
+    Options none;
+    none.maxReadaheadBlocks_ = 0;
+    Options async;
+    async.asyncReader_ = AsyncReader::NewDefault();
+    size_t touched = scanHalf(none);
+    //read ahead blocks are already cached
+    ASSERT_GT(scanHalf(async),touched);
+    //kernel readahead leaves the cache alone
+    ASSERT_EQ(scanHalf(Options{}),touched);
+
+    Options mmap;
+    mmap.useMmapReads_ = true;
+    mmap.compression_ = CompressionType::kNoCompression;
+    BuildTable("test_readahead.table",kvMap,mmap);
+    ASSERT_EQ(scanHalf(mmap),0);
+}
+
+TEST(table,Bounds)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    BuildTable("test_bounds.table",kvMap,Options{});
+    std::vector<std::string> keys;
+    for (const auto & [k,v] : kvMap)
+    {
+        keys.push_back(k);
+    }
+    const size_t lower = 1000;
+    const size_t upper = 3000;
+    ReadOptions bounds;
+    bounds.iterateLowerBound_ = keys[lower];
+    bounds.iterateUpperBound_ = keys[upper];
+
+    Options options;
+    options.blockCache_ = ShardedLRUCache::NewCache(1 << 20);
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_bounds.table",options);
+    {
+        std::unique_ptr<SSTable::Iterator> it(table->newIterator(bounds));
+        size_t i = lower;
+        for (it->SeekForFirst(); it->Valid(); it->Next(),i++)
+        {
+            ASSERT_EQ(ExtraceUserKey(it->key()),keys[i]);
+        }
+        ASSERT_EQ(i,upper);
+    }
+    size_t forwardBlocks = options.blockCache_->TotalCharge();
+
+    options.blockCache_ = ShardedLRUCache::NewCache(1 << 20);
+    table = SSTable::newTable("test_bounds.table",options);
+    {
+        std::unique_ptr<SSTable::Iterator> it(table->newIterator(bounds));
+        size_t i = upper;
+        for (it->SeekForLast(); it->Valid(); it->Prev())
+        {
+            ASSERT_EQ(ExtraceUserKey(it->key()),keys[--i]);
+        }
+        ASSERT_EQ(i,lower);
+    }
+    //the block before the lower bound is never loaded
+    ASSERT_EQ(options.blockCache_->TotalCharge(),forwardBlocks);
+
+    std::unique_ptr<SSTable::Iterator> it(table->newIterator(bounds));
+    it->Seek(InternalKey(keys[10],kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode());
+    ASSERT_TRUE(it->Valid());
+    ASSERT_EQ(ExtraceUserKey(it->key()),keys[lower]);
+    it->Seek(InternalKey(keys[upper + 10],kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode());
+    ASSERT_FALSE(it->Valid());
+    //past the last key of the table
+    std::unique_ptr<SSTable::Iterator> unbounded(table->newIterator());
+    unbounded->Seek(InternalKey(std::string(64,'z'),kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode());
+    ASSERT_FALSE(unbounded->Valid());
+}
+
+TEST(table,PartitionedIndex)
+{
+    KVMap kvMap;
+    for (size_t i = 0; i < 8192; i++)
+    {
+        std::string randomKey = std::string(RandomString());
+        kvMap.insert(std::make_pair(randomKey,randomKey));
+    }
+    Options build;
+    build.blockSize_ = 512;
+    build.indexPartitionSize_ = 512;
+    BuildTable("test_partitioned.table",kvMap,build);
+
+    Options options;
+    options.blockCache_ = ShardedLRUCache::NewCache(1 << 20);
+    std::shared_ptr<SSTable> table = SSTable::newTable("test_partitioned.table",options);
+    ASSERT_TRUE(table->isOpen());
+    //only the top-level index is read at open
+    ASSERT_EQ(options.blockCache_->TotalCharge(),0);
+    InternalKey first(kvMap.begin()->first,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+    ASSERT_EQ(table->InternalGet(first.Encode(),[](const std::string_view&,const std::string_view&){}),0);
+    //one partition and one data block
+    ASSERT_EQ(options.blockCache_->TotalCharge(),2);
+
+    std::vector<std::pair<size_t,size_t>> locations = table->BlockLocations();
+    ASSERT_GT(locations.size(),100);
+    for (size_t i = 1; i < locations.size(); i++)
+    {
+        ASSERT_EQ(locations[i].first,locations[i - 1].first + locations[i - 1].second + kBlockTrailerSize);
+    }
+
+    //a small cache keeps evicting partitions into the secondary tier
+    Options small;
+    small.blockCache_ = ShardedLRUCache::NewCache(16);
+    small.secondaryCache_ = CompressedSecondaryCache::NewCache(1 << 20);
+    SSTable::InstallSecondaryCache(small);
+    for (const Options & opts : {options,small})
+    {
+        std::shared_ptr<SSTable> t = SSTable::newTable("test_partitioned.table",opts);
+        for (const auto & [k,v] : kvMap)
+        {
+            InternalKey ikey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE);
+            std::string value;
+            ASSERT_EQ(t->InternalGet(ikey.Encode(),[&value](const std::string_view&,const std::string_view& val){
+                value = val;
+            }),0);
+            ASSERT_EQ(value,v);
+        }
+        std::unique_ptr<SSTable::Iterator> it(t->newIterator());
+        auto mit = kvMap.begin();
+        for (it->SeekForFirst(); it->Valid(); it->Next(),mit++)
+        {
+            ASSERT_EQ(ExtraceUserKey(it->key()),mit->first);
+        }
+        ASSERT_EQ(mit,kvMap.end());
+        auto rit = kvMap.rbegin();
+        for (it->SeekForLast(); it->Valid(); it->Prev(),rit++)
+        {
+            ASSERT_EQ(ExtraceUserKey(it->key()),rit->first);
+        }
+        ASSERT_EQ(rit,kvMap.rend());
+
+        std::vector<std::string> ikeys;
+        for (const auto & [k,v] : kvMap)
+        {
+            ikeys.push_back(std::string(InternalKey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode()));
+        }
+        std::vector<std::string_view> keys(ikeys.begin(),ikeys.end());
+        std::vector<int> results;
+        t->MultiGet(keys,results,[](size_t,const std::string_view&,const std::string_view&){});
+        ASSERT_EQ(std::count(results.begin(),results.end(),0),kvMap.size());
+    }
+    ASSERT_GT(small.secondaryCache_->GetStats().hits_,0);
+}
+
+TEST(table,Merge)
+{
+    const std::string dbname = "table_merge_db";
+    std::system(("rm -rf " + dbname + " && mkdir -p " + dbname).c_str());
+    Options options;
+    options.blockSize_ = 64;
+    options.mergeOperator_ = std::make_shared<AddOperator>();
+    uint64_t fileSize = 0;
+    {
+        TableBuilder builder(TableFileName(dbname,1),options);
+        //base value under the operands
+        builder.Add(InternalKey("a",3,OpsType::MERGE).Encode(),"1");
+        builder.Add(InternalKey("a",2,OpsType::MERGE).Encode(),"2");
+        builder.Add(InternalKey("a",1,OpsType::UPDATE).Encode(),"10");
+        //deleted base
+        builder.Add(InternalKey("b",5,OpsType::MERGE).Encode(),"4");
+        builder.Add(InternalKey("b",4,OpsType::DELETE).Encode(),"");
+        //no base, the operands span several blocks
+        for (SequenceNumber seq = 40; seq > 10; seq--)
+        {
+            builder.Add(InternalKey("c",seq,OpsType::MERGE).Encode(),"1");
+        }
+        builder.Add(InternalKey("d",41,OpsType::UPDATE).Encode(),"5");
+        ASSERT_EQ(builder.Finish(),0);
+        fileSize = builder.FileSize();
+    }
+
+    std::shared_ptr<SSTable> table = SSTable::newTable(TableFileName(dbname,1),options);
+    auto get = [&table](const std::string& k,std::string* value,OpsType* type){
+        return table->InternalGet(InternalKey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),
+            [value,type](const std::string_view& key,const std::string_view& val){
+                *value = val;
+                *type = ExtractOpsType(key);
+            });
+    };
+    std::string value;
+    OpsType type = OpsType::DELETE;
+    ASSERT_EQ(get("a",&value,&type),0);
+    ASSERT_EQ(value,"13");
+    ASSERT_EQ(type,OpsType::UPDATE);
+    ASSERT_EQ(get("b",&value,&type),0);
+    ASSERT_EQ(value,"4");
+    //the base value may be in an older table
+    ASSERT_EQ(get("c",&value,&type),SSTable::kMergeInProgress);
+    ASSERT_EQ(get("d",&value,&type),0);
+    ASSERT_EQ(value,"5");
+    ASSERT_EQ(get("e",&value,&type),-1);
+    //a snapshot sees only the older operands, and those written at its own sequence
+    //whatever the type of the lookup key
+    ASSERT_EQ(table->InternalGet(InternalKey("a",2,OpsType::UPDATE).Encode(),[&value](const std::string_view&,const std::string_view& val){
+        value = val;
+    }),0);
+    ASSERT_EQ(value,"12");
+    ASSERT_EQ(table->InternalGet(InternalKey("a",3,OpsType::UPDATE).Encode(),[&value](const std::string_view&,const std::string_view& val){
+        value = val;
+    }),0);
+    ASSERT_EQ(value,"13");
+    //MultiGet hands the operand at the exact sequence over as it is
+    std::vector<int> exactResults;
+    InternalKey exact("a",3,OpsType::DELETE);
+    table->MultiGet(std::vector<std::string_view>{exact.Encode()},exactResults,[&value](size_t,const std::string_view&,const std::string_view& val){
+        value = val;
+    });
+    ASSERT_EQ(exactResults,std::vector<int>({0}));
+    ASSERT_EQ(value,"1");
+
+    //with a context the operands are left for the older tables
+    MergeContext context;
+    std::string newestKey;
+    ASSERT_EQ(table->InternalGet(InternalKey("c",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),&context,&newestKey,
+        [](const std::string_view&,const std::string_view&){}),SSTable::kMergeInProgress);
+    ASSERT_EQ(context.size(),30);
+    ASSERT_EQ(newestKey,InternalKey("c",40,OpsType::MERGE).Encode());
+    //and the operands of newer tables go onto the base value of this one
+    context.Clear();
+    context.PushOperand("100");
+    newestKey = InternalKey("d",50,OpsType::MERGE).Encode();
+    ASSERT_EQ(table->InternalGet(InternalKey("d",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),&context,&newestKey,
+        [&value,&type](const std::string_view& key,const std::string_view& val){
+            value = val;
+            type = ExtractOpsType(key);
+        }),0);
+    ASSERT_EQ(value,"105");
+    ASSERT_EQ(type,OpsType::UPDATE);
+    ASSERT_TRUE(context.empty());
+
+    //without an operator the newest operand is read as it is
+    std::shared_ptr<SSTable> plain = SSTable::newTable(TableFileName(dbname,1));
+    ASSERT_EQ(plain->InternalGet(InternalKey("a",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),[&value](const std::string_view&,const std::string_view& val){
+        value = val;
+    }),0);
+    ASSERT_EQ(value,"1");
+
+    TableCache cache(dbname,16,options);
+    std::map<std::string,std::string> expected{{"a","13"},{"b","4"},{"d","5"}};
+    for (const auto & [k,v] : expected)
+    {
+        ASSERT_TRUE(cache.Get(1,fileSize,InternalKey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),[&value](const std::string_view&,const std::string_view& val){
+            value = val;
+        }));
+        ASSERT_EQ(value,v);
+    }
+    ASSERT_FALSE(cache.Get(1,fileSize,InternalKey("c",kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode(),[](const std::string_view&,const std::string_view&){}));
+    std::vector<std::string> ikeys;
+    for (const std::string k : {"d","c","e","a","b"})
+    {
+        ikeys.push_back(std::string(InternalKey(k,kDefaultMaxSequenceNumber,OpsType::UPDATE).Encode()));
+    }
+    std::vector<std::string_view> keys(ikeys.begin(),ikeys.end());
+    std::vector<std::string> values(keys.size());
+    std::vector<bool> results;
+    cache.MultiGet(1,fileSize,keys,results,[&values](size_t i,const std::string_view&,const std::string_view& val){
+        values[i] = val;
+    });
+    ASSERT_EQ(results,std::vector<bool>({true,false,false,true,true}));
+    ASSERT_EQ(values,std::vector<std::string>({"5","","","13","4"}));
+}
@@ -1,5 +1,7 @@
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -8,14 +10,43 @@
 #include "table_builder.h"
 
 void TableBuilder::Add(const std::string_view& key,const std::string_view& value)
+{
+	if(blobBuilder_ != nullptr && minBlobSize_ > 0 && value.size() >= minBlobSize_ &&
+		ExtractOpsType(key) == OpsType::UPDATE)
+	{
+		blobKey_.assign(key.data(),key.size());
+		SetOpsType(blobKey_,OpsType::BLOB_INDEX);
+		blobIndex_.clear();
+		blobBuilder_->Add(key.substr(0,key.size() - 8),value).EncodeTo(blobIndex_);
+		ok_ = ok_ && blobBuilder_->ok();
+		addEntry(blobKey_,blobIndex_);
+		return;
+	}
+	addEntry(key,value);
+}
+
+void TableBuilder::addEntry(const std::string_view& key,const std::string_view& value)
 {
 	entriesNum_++;
+	properties_.numEntries_++;
+	properties_.rawKeySize_ += key.size();
+	properties_.rawValueSize_ += value.size();
+	OpsType type = ExtractOpsType(key);
+	properties_.numDeletions_ += type == OpsType::DELETE;
+	properties_.numBlobIndexes_ += type == OpsType::BLOB_INDEX;
+	uint64_t packSeqAndType;
+	memcpy(&packSeqAndType,key.data() + key.size() - 8,sizeof(packSeqAndType));
+	properties_.minSequence_ = std::min(properties_.minSequence_,packSeqAndType >> 8);
+	properties_.maxSequence_ = std::max(properties_.maxSequence_,packSeqAndType >> 8);
+	if(properties_.smallestKey_.empty())
+		properties_.smallestKey_ = key;
+	properties_.largestKey_ = key;
 	kvBuilder_->Add(key,value);
 	lastKey_ = key;
 	if(kvBuilder_->CurrentSize() >= blockSize_)
 	{
 		auto res = WriteBlock();
 		kvBuilder_->Reset();
-		IndexBuilder_->Add(key,res);
+		AddIndexEntry(key,res);
 	}
 }
@@ -4,14 +4,20 @@
 #include <string>
 #include <string_view>
 #include <memory>
+#include <vector>
 #include <cassert>
 #include <cstdlib>
+#include <ctime>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 #include "block_builder.h"
+#include "table_format.h"
+#include "blob_file.h"
+#include "../util/Options.h"
+#include "../util/FileSystem.h"
 
 class TableBuilder
 {
@@ -19,76 +25,171 @@ private:
     static constexpr uint64_t kDefaultBlockSize = 4 * 1024;
     std::string fileName_;
     std::string lastKey_;
-    int fd_;
+    std::unique_ptr<WritableFile> file_;
+    bool ok_;
 
     uint64_t blockSize_;
     uint64_t entriesNum_;
+    CompressionType compression_;
+    double minCompressionSavings_;
+    std::string compressed_;
     std::unique_ptr<KVBlockBuilder> kvBuilder_;
     std::unique_ptr<IndexBlockBuilder> IndexBuilder_;
+    //0 writes a single index block
+    uint64_t indexPartitionSize_;
+    //finished partitions and their last keys, written after the data blocks
+    //so that data blocks stay back to back
+    std::vector<std::pair<std::string,std::string>> indexPartitions_;
+    //top-level indexes get the prefix array too
+    bool blockPrefixArray_;
+    //values at least this large go to blobBuilder_
+    uint64_t minBlobSize_;
+    BlobFileBuilder* blobBuilder_{nullptr};
+    std::string blobKey_;
+    std::string blobIndex_;
+    TableProperties properties_;
+
+    void addEntry(const std::string_view& key,const std::string_view& value);
+
+    static Options blockSizeOptions(uint64_t blockSize)
+    {
+        Options options;
+        options.blockSize_ = blockSize;
+        return options;
+    }
 
-    int openNewFile()
+    BlockHandle WriteRawBlock(const std::string_view& content,CompressionType type)
     {
-        int fd = ::open(fileName_.c_str(),O_CLOEXEC | O_CREAT | O_TRUNC | O_RDWR,0644);
-        assert(fd >= 0);
-	    return fd;
+        BlockHandle handle;
+        handle.second = content.size();
+        handle.first = file_->Size();
+        std::string trailer;
+        AppendBlockTrailer(trailer,content,type);
+        ok_ = ok_ && file_->Append(content) && file_->Append(trailer);
+        return handle;
     }
+
+    BlockHandle WriteBlock(const std::string_view& raw)
+    {
+        CompressionType type = CompressionType::kNoCompression;
+        std::string_view content = raw;
+        const CompressionCodec* codec = CompressionRegistry::instance().Get(compression_);
+        if(codec != nullptr && codec->compress_(raw,compressed_) &&
+            compressed_.size() < raw.size() - raw.size() * minCompressionSavings_)
+        {
+            type = compression_;
+            content = compressed_;
+        }
+        return WriteRawBlock(content,type);
+    }
+
     std::pair<size_t,size_t> WriteBlock()
     {
-        assert(fd_ >= 0);
-        std::pair<size_t,size_t> sizeAndOffset;
-        std::string_view content = kvBuilder_->Finish();
-        sizeAndOffset.second = content.size();
-        sizeAndOffset.first = lseek(fd_,0,SEEK_END);
-        int res = ::write(fd_,content.data(),content.size());
-        assert(res == content.size());
-        ::fsync(fd_);
-        return sizeAndOffset;
+        BlockHandle handle = WriteBlock(kvBuilder_->Finish());
+        properties_.numDataBlocks_++;
+        properties_.dataSize_ += handle.second + kBlockTrailerSize;
+        return handle;
+    }
+
+    //key is the last key of the block
+    void AddIndexEntry(const std::string_view& key,const BlockHandle& handle)
+    {
+        IndexBuilder_->Add(key,handle);
+        if(indexPartitionSize_ > 0 && IndexBuilder_->CurrentSize() >= indexPartitionSize_)
+            FlushIndexPartition(key);
+    }
+
+    void FlushIndexPartition(const std::string_view& lastKey)
+    {
+        indexPartitions_.emplace_back(std::string(lastKey),std::string(IndexBuilder_->Finish()));
+        IndexBuilder_->Reset();
+    }
+
+    //writes the partitions and returns the handle of the top-level index over them
+    BlockHandle WritePartitionedIndex()
+    {
+        IndexBlockBuilder topIndexBuilder(IndexBlockBuilder::kDefaultInterval,false,blockPrefixArray_);
+        for (const auto & [lastKey,partition] : indexPartitions_)
+        {
+            topIndexBuilder.Add(lastKey,WriteBlock(partition));
+        }
+        indexPartitions_.clear();
+        return WriteBlock(topIndexBuilder.Finish());
     }
 
 public:
-    TableBuilder(std::string fileName, uint64_t blockSize = kDefaultBlockSize)
+    TableBuilder(std::string fileName,const Options& options)
      : fileName_(std::move(fileName)),
-        fd_(openNewFile()),
-        blockSize_(blockSize),
+        file_(std::make_unique<WritableFile>(fileName_,options.tableWriteBufferSize_,options.bytesPerSync_)),
+        ok_(file_->isOpen()),
+        blockSize_(options.blockSize_),
         entriesNum_(0),
-        kvBuilder_(std::make_unique<KVBlockBuilder>()),
-        IndexBuilder_(std::make_unique<IndexBlockBuilder>())
+        compression_(options.compression_),
+        minCompressionSavings_(options.minCompressionSavings_),
+        kvBuilder_(std::make_unique<KVBlockBuilder>(KVBlockBuilder::kDefaultInterval,options.blockHashIndex_,
+                                                     options.blockPrefixArray_,options.fixedSizeBlocks_)),
+        IndexBuilder_(std::make_unique<IndexBlockBuilder>(IndexBlockBuilder::kDefaultInterval,false,options.blockPrefixArray_)),
+        indexPartitionSize_(options.indexPartitionSize_),
+        blockPrefixArray_(options.blockPrefixArray_),
+        minBlobSize_(options.minBlobSize_)
     {
 
     }
-    ~TableBuilder()
+
+    TableBuilder(std::string fileName, uint64_t blockSize = kDefaultBlockSize)
+     : TableBuilder(std::move(fileName),blockSizeOptions(blockSize))
     {
-        if(fd_ != -1)
-	        ::close(fd_);
+
     }
+    ~TableBuilder() = default;
 
     TableBuilder(const TableBuilder&) = delete;
     TableBuilder& operator= (const TableBuilder&) = delete;
 
     void Add(const std::string_view& key,const std::string_view& value);
+
+    //large UPDATE values are appended to blobs and the table keeps a BLOB_INDEX entry,
+    //the caller finishes blobs once every table referencing it is done
+    void SetBlobFileBuilder(BlobFileBuilder* blobs)
+    {
+        blobBuilder_ = blobs;
+    }
     
 
+    //the only sync of the table, returns -1 if any write failed
     int Finish()
     {
         if(!kvBuilder_->empty())
         {
             auto res = WriteBlock();
             kvBuilder_->Reset();
-            IndexBuilder_->Add(lastKey_,res);
+            AddIndexEntry(lastKey_,res);
         }
         
-        std::string_view content = IndexBuilder_->Finish();
-        size_t indexDataOffset = lseek(fd_,0,SEEK_END);
-        ssize_t haswrite = ::write(fd_,content.data(),content.size());
-        haswrite += ::write(fd_,&indexDataOffset,sizeof(size_t));
-        assert(haswrite == content.size() + sizeof(size_t));
+        Footer footer;
+        uint64_t indexOffset = file_->Size();
+        if(indexPartitionSize_ > 0)
+        {
+            if(!IndexBuilder_->empty())
+                FlushIndexPartition(lastKey_);
+            footer.indexHandle_ = WritePartitionedIndex();
+            footer.formatVersion_ = kPartitionedIndexFormatVersion;
+        } else
+        {
+            footer.indexHandle_ = WriteBlock(IndexBuilder_->Finish());
+        }
+        properties_.indexSize_ = file_->Size() - indexOffset;
+        properties_.creationTime_ = time(nullptr);
+        std::string properties;
+        properties_.EncodeTo(properties);
+        footer.metaHandle_ = WriteRawBlock(properties,CompressionType::kNoCompression);
+        std::string footerContent;
+        footer.EncodeTo(footerContent);
+        ok_ = ok_ && file_->Append(footerContent);
         IndexBuilder_->Reset();
-        int ret = ::fsync(fd_);
-        assert(ret == 0);
-        ret = ::close(fd_);
-        fd_ = -1;
-        assert(ret == 0);
-        return 0;
+        ok_ = ok_ && file_->Sync();
+        ok_ = file_->Close() && ok_;
+        return ok_ ? 0 : -1;
     }
 
     uint64_t NumEntries() const
@@ -96,9 +197,15 @@ public:
         return entriesNum_;
     }
 
+    //complete once Finish returned
+    const TableProperties& Properties() const
+    {
+        return properties_;
+    }
+
     uint64_t FileSize() const
     {
-        return lseek(fd_,0,SEEK_END);
+        return file_->Size();
     }
 
     std::string FileName() const { return fileName_; }
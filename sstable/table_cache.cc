@@ -1,25 +1,77 @@
 #include "table_cache.h"
+#include "persistent_cache.h"
 #include "../util/fname.h"
 
+#include <unordered_map>
+
 static void tableDeleter(const std::string &key, void *value)
 {
     SSTable* table = static_cast<SSTable*>(value);
     delete table;
 }
 
-Entry* TableCache::findTable(uint64_t fileNumber,uint64_t fileSize)
+TableCache::TableCache(const std::string& dbname,int entries,const Options& options)
+ : dbname_(dbname),
+   cache_(new ShardedLRUCache(entries)),
+   options_(options),
+   blobCache_(std::make_shared<BlobCache>(dbname,entries,options))
 {
-    char buf[sizeof(fileNumber)];
-    memcpy(buf,&fileNumber,sizeof(fileNumber));
+    SSTable::InstallSecondaryCache(options_);
+
+}
 
-    std::string key(buf);
+TableCache::~TableCache()
+{
+    shutdown_ = true;
+    WaitForPrefetch();
+    delete cache_;
+}
+
+Entry* TableCache::findTable(uint64_t fileNumber,uint64_t fileSize)
+{
+    std::string key = tableKey(fileNumber);
 
     Entry* entry = cache_->Lookup(key);
     if(entry == nullptr)
     {
         std::string fname = TableFileName(dbname_,fileNumber);
-        SSTable* table = SSTable::newTableRaw(fname);
+        SSTable* table = SSTable::newTableRaw(fname,options_,fileNumber);
+        if(!table->isOpen())
+        {
+            delete table;
+            return nullptr;
+        }
         entry = cache_->Insert(key,table,1,tableDeleter);
     }
     return entry;
-}
\ No newline at end of file
+}
+
+void TableCache::PrefetchHotBlocks()
+{
+    if(!options_.persistentCache_ || prefetcher_.joinable())
+        return;
+    std::vector<PersistentCache::BlockKey> keys = options_.persistentCache_->LoadHotKeys();
+    //one batch of reads per table, tables in the order their hottest block appears
+    std::vector<std::pair<uint64_t,std::vector<std::pair<size_t,size_t>>>> tables;
+    std::unordered_map<uint64_t,size_t> slots;
+    for (const auto & key : keys)
+    {
+        auto [it,inserted] = slots.emplace(key.fileNumber_,tables.size());
+        if(inserted)
+            tables.emplace_back(key.fileNumber_,std::vector<std::pair<size_t,size_t>>{});
+        tables[it->second].second.emplace_back(key.offset_,key.size_);
+    }
+    prefetcher_ = std::thread([this,tables = std::move(tables)](){
+        for (const auto & [fileNumber,locations] : tables)
+        {
+            if(shutdown_)
+                return;
+            Entry* entry = findTable(fileNumber,0);
+            if(entry == nullptr)
+                continue;
+            SSTable* table = static_cast<SSTable*>(entry->value_);
+            table->PrefetchBlocks(locations);
+            cache_->Release(entry);
+        }
+    });
+}
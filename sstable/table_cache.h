@@ -1,50 +1,248 @@
 #pragma once
 
+#include <thread>
+#include <atomic>
+
 #include "table.h"
+#include "merge.h"
+#include "blob_file.h"
+#include "../db/version.h"
 #include "../util/LRUCache.h"
+#include "../util/Options.h"
 
 
 class TableCache
 {
 private:
     Entry* findTable(uint64_t fileNumber,uint64_t fileSize);
+    static std::string tableKey(uint64_t fileNumber)
+    {
+        char buf[sizeof(fileNumber)];
+        memcpy(buf,&fileNumber,sizeof(fileNumber));
+        return std::string(buf,sizeof(buf));
+    }
     const std::string dbname_;
     ShardedLRUCache* cache_;
+    Options options_;
+    //values of BLOB_INDEX entries are read through it
+    std::shared_ptr<BlobCache> blobCache_;
+
+    //handle sees the blob value under an UPDATE key, false when the blob cannot be read
+    template<typename F>
+    bool resolveBlob(const std::string_view& ikey,const std::string_view& value,F& handle)
+    {
+        if(ExtractOpsType(ikey) != OpsType::BLOB_INDEX)
+        {
+            handle(ikey,value);
+            return true;
+        }
+        std::string blob;
+        if(!blobCache_->Resolve(value,&blob))
+            return false;
+        std::string key(ikey);
+        SetOpsType(key,OpsType::UPDATE);
+        handle(std::string_view(key),std::string_view(blob));
+        return true;
+    }
+
+    std::thread prefetcher_;
+    std::atomic<bool> shutdown_{false};
 public:
-    TableCache(const std::string& dbname,int entries);
+    TableCache(const std::string& dbname,int entries,const Options& options = Options{});
     ~TableCache();
 
     std::shared_ptr<SSTable::Iterator> 
             NewIterator(uint64_t fileNumber,uint64_t fileSize,std::shared_ptr<SSTable>& ptr)
+    {
+        return NewIterator(fileNumber,fileSize,ReadOptions{});
+    }
+
+    std::shared_ptr<SSTable::Iterator> 
+            NewIterator(uint64_t fileNumber,uint64_t fileSize,const ReadOptions& options)
     {
         Entry* entry_ = findTable(fileNumber,fileSize);
         if(entry_ == nullptr)
             return nullptr;
         SSTable* table = reinterpret_cast<SSTable*>(entry_->value_);
-        auto cleaner = [entry = entry_,cache = cache_](){
+        auto cleaner = [entry = entry_,cache = cache_](SSTable::Iterator* it){
+            delete it;
             cache->Release(entry);
         };
-        std::shared_ptr<SSTable::Iterator> it(table->newIterator(),std::move(cleaner));
-        return it;
+        std::shared_ptr<SSTable::Iterator> it(table->newIterator(options),std::move(cleaner));
+        //tables that say they hold no blob references skip the resolving wrapper
+        const TableProperties* properties = table->Properties();
+        if(!options.resolveBlobs_ || (properties != nullptr && properties->numBlobIndexes_ == 0))
+            return it;
+        return std::make_shared<BlobResolvingIterator>(std::move(it),blobCache_);
+    }
+
+    //iterators over the files that overlap the bounds, the others are not opened
+    MergeIterator::IteratorList NewIterators(const std::vector<FileMeta>& files,const ReadOptions& options)
+    {
+        MergeIterator::IteratorList iterators;
+        for (const auto & file : files)
+        {
+            if(!file.OverlapsBounds(options))
+                continue;
+            std::shared_ptr<SSTable::Iterator> it = NewIterator(file.number_,file.fileSize_,options);
+            if(it != nullptr)
+                iterators.push_back(std::move(it));
+        }
+        return iterators;
     }
 
+    //false when the key is absent, its blob cannot be read or its operands fail to merge,
+    //operands are folded as in SSTable::InternalGet, a key with operands but no base value
+    //in the table is reported absent, the context overload below carries them on
     template<typename F>
     bool Get(uint64_t fileNumber,uint64_t fileSize,const std::string_view& k,F handle)
+    {
+        MergeContext context;
+        std::string newestKey;
+        return Get(fileNumber,fileSize,k,&context,&newestKey,handle) == 0;
+    }
+
+    //see the context overload of SSTable::InternalGet, a blob base value is read and the
+    //operands folded onto it. 0 if found, -1 if not, kMergeInProgress with the table's
+    //operands added to context, kCorruption if the table, a block or the blob cannot be
+    //read or a merge failed
+    template<typename F>
+    int Get(uint64_t fileNumber,uint64_t fileSize,const std::string_view& k,MergeContext* context,std::string* newestKey,F handle)
+    {
+        Entry* entry = findTable(fileNumber,fileSize);
+        if(entry == nullptr)
+            return SSTable::kCorruption;
+        SSTable* table = reinterpret_cast<SSTable*>(entry->value_);
+        bool resolved = true;
+        std::string blobBase;
+        int ret = table->InternalGet(k,context,newestKey,[this,&handle,&resolved,&blobBase,context](const std::string_view& ikey,const std::string_view& value){
+            if(context->empty())
+                resolved = resolveBlob(ikey,value,handle);
+            else if(ExtractOpsType(ikey) == OpsType::BLOB_INDEX)
+                resolved = blobCache_->Resolve(value,&blobBase);
+        });
+        cache_->Release(entry);
+        if(!resolved)
+            return SSTable::kCorruption;
+        if(ret != SSTable::kMergeOntoBlob)
+            return ret;
+        std::string result;
+        const std::string_view base(blobBase);
+        if(!context->Fold(*options_.mergeOperator_,k.substr(0,k.size() - 8),&base,&result))
+            return SSTable::kCorruption;
+        context->Clear();
+        SetOpsType(*newestKey,OpsType::UPDATE);
+        handle(std::string_view(*newestKey),std::string_view(result));
+        return 0;
+    }
+
+    //results[i] is true when keys[i] was found and its blob, if any, was read, see SSTable::MultiGet
+    template<typename F>
+    void MultiGet(uint64_t fileNumber,uint64_t fileSize,const std::vector<std::string_view>& keys,std::vector<bool>& results,F handle)
+    {
+        results.assign(keys.size(),false);
+        Entry* entry = findTable(fileNumber,fileSize);
+        if(entry == nullptr)
+            return;
+        SSTable* table = reinterpret_cast<SSTable*>(entry->value_);
+        std::vector<int> ret;
+        std::vector<size_t> merged;
+        table->MultiGet(keys,ret,[this,&handle,&ret,&merged](size_t i,const std::string_view& ikey,const std::string_view& value){
+            if(options_.mergeOperator_ != nullptr && ExtractOpsType(ikey) == OpsType::MERGE)
+            {
+                merged.push_back(i);
+                ret[i] = -1;
+                return;
+            }
+            auto handleOne = [&handle,i](const std::string_view& key,const std::string_view& val){
+                handle(i,key,val);
+            };
+            if(!resolveBlob(ikey,value,handleOne))
+                ret[i] = SSTable::kCorruption;
+        });
+        cache_->Release(entry);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            results[i] = ret[i] == 0;
+        }
+        //operands are folded by a lookup of their own, without a base value in this table
+        //the key is reported absent and Version::Get carries its operands to older tables
+        for (size_t i : merged)
+        {
+            results[i] = Get(fileNumber,fileSize,keys[i],[&handle,i](const std::string_view& key,const std::string_view& val){
+                handle(i,key,val);
+            });
+        }
+    }
+
+    //see SSTable::ApproximateOffsetOf, false when the table cannot be opened
+    bool ApproximateOffsetOf(uint64_t fileNumber,uint64_t fileSize,const std::string_view& key,uint64_t* offset)
+    {
+        Entry* entry = findTable(fileNumber,fileSize);
+        if(entry == nullptr)
+            return false;
+        SSTable* table = reinterpret_cast<SSTable*>(entry->value_);
+        *offset = table->ApproximateOffsetOf(key);
+        cache_->Release(entry);
+        return true;
+    }
+
+    //see SSTable::BlockBoundaries, false when the table cannot be opened
+    bool BlockBoundaries(uint64_t fileNumber,uint64_t fileSize,const std::string_view& start,
+                            const std::string_view& limit,std::vector<std::string>* keys)
+    {
+        Entry* entry = findTable(fileNumber,fileSize);
+        if(entry == nullptr)
+            return false;
+        SSTable* table = reinterpret_cast<SSTable*>(entry->value_);
+        *keys = table->BlockBoundaries(start,limit);
+        cache_->Release(entry);
+        return true;
+    }
+
+    //false when the table cannot be opened or has no properties block
+    bool GetProperties(uint64_t fileNumber,uint64_t fileSize,TableProperties* properties)
     {
         Entry* entry = findTable(fileNumber,fileSize);
         if(entry == nullptr)
             return false;
         SSTable* table = reinterpret_cast<SSTable*>(entry->value_);
-        table->InternalGet(k,std::move(handle));
+        bool found = table->Properties() != nullptr;
+        if(found)
+            *properties = *table->Properties();
         cache_->Release(entry);
+        return found;
     }
 
     void Evict(uint64_t fileNumber)
     {
-        char buf[sizeof(fileNumber)];
-        memcpy(buf,&fileNumber,sizeof(fileNumber));
-        cache_->Erase(std::string(buf));
+        cache_->Erase(tableKey(fileNumber));
     }
 
-};
+    const std::string& DBName() const
+    {
+        return dbname_;
+    }
+
+    //blob files are evicted before they are deleted by garbage collection
+    const std::shared_ptr<MergeOperator>& GetMergeOperator() const
+    {
+        return options_.mergeOperator_;
+    }
 
+    std::shared_ptr<BlobCache> GetBlobCache() const
+    {
+        return blobCache_;
+    }
+
+    //loads the hot blocks dumped by the persistent cache at its last close
+    //into the block cache on a background thread
+    void PrefetchHotBlocks();
+
+    void WaitForPrefetch()
+    {
+        if(prefetcher_.joinable())
+            prefetcher_.join();
+    }
+
+};
@@ -0,0 +1,130 @@
+#include "table_format.h"
+#include "../util/checksum.h"
+#include "../util/format.h"
+
+#include <cstring>
+#include <algorithm>
+
+static void encodeHandle(std::string& dst,const BlockHandle& handle)
+{
+    AppendUINT64(dst,handle.first);
+    AppendUINT64(dst,handle.second);
+}
+
+static const char* decodeHandle(const char* data,BlockHandle& handle)
+{
+    uint64_t offset;
+    uint64_t size;
+    memcpy(&offset,data,sizeof(offset));
+    memcpy(&size,data + sizeof(offset),sizeof(size));
+    handle = BlockHandle(offset,size);
+    return data + 2 * sizeof(uint64_t);
+}
+
+void Footer::EncodeTo(std::string& dst) const
+{
+    encodeHandle(dst,indexHandle_);
+    encodeHandle(dst,filterHandle_);
+    encodeHandle(dst,metaHandle_);
+    AppendUINT32(dst,formatVersion_);
+    AppendUINT64(dst,kTableMagicNumber);
+}
+
+bool Footer::DecodeFrom(const char* data)
+{
+    uint64_t magic;
+    memcpy(&magic,data + kEncodedLength - sizeof(magic),sizeof(magic));
+    if(magic != kTableMagicNumber)
+        return false;
+    data = decodeHandle(data,indexHandle_);
+    data = decodeHandle(data,filterHandle_);
+    data = decodeHandle(data,metaHandle_);
+    memcpy(&formatVersion_,data,sizeof(formatVersion_));
+    return formatVersion_ >= kTableFormatVersion && formatVersion_ <= kPartitionedIndexFormatVersion;
+}
+
+uint32_t BlockChecksum(const std::string_view& block,CompressionType type)
+{
+    uint32_t crc = CRC32C(block.data(),block.size());
+    char t = static_cast<char>(type);
+    return CRC32CExtend(crc,&t,1);
+}
+
+void AppendBlockTrailer(std::string& dst,const std::string_view& block,CompressionType type)
+{
+    dst.push_back(static_cast<char>(type));
+    AppendUINT32(dst,BlockChecksum(block,type));
+}
+
+bool VerifyBlockTrailer(const char* data,size_t size)
+{
+    CompressionType type = BlockTrailerType(data,size);
+    uint32_t expected;
+    memcpy(&expected,data + size + 1,sizeof(expected));
+    return expected == BlockChecksum(std::string_view(data,size),type);
+}
+
+CompressionType BlockTrailerType(const char* data,size_t size)
+{
+    return static_cast<CompressionType>(data[size]);
+}
+
+static constexpr uint32_t kPropertiesFields = 12;
+//tables written before globalSequence_ was added
+static constexpr uint32_t kMinPropertiesFields = 11;
+
+void TableProperties::EncodeTo(std::string& dst) const
+{
+    AppendUINT32(dst,kPropertiesFields);
+    AppendUINT64(dst,numEntries_);
+    AppendUINT64(dst,numDeletions_);
+    AppendUINT64(dst,numBlobIndexes_);
+    AppendUINT64(dst,numDataBlocks_);
+    AppendUINT64(dst,rawKeySize_);
+    AppendUINT64(dst,rawValueSize_);
+    AppendUINT64(dst,dataSize_);
+    AppendUINT64(dst,indexSize_);
+    AppendUINT64(dst,minSequence_);
+    AppendUINT64(dst,maxSequence_);
+    AppendUINT64(dst,creationTime_);
+    AppendUINT64(dst,globalSequence_);
+    AppendUINT32(dst,smallestKey_.size());
+    dst.append(smallestKey_);
+    AppendUINT32(dst,largestKey_.size());
+    dst.append(largestKey_);
+}
+
+static bool decodeString(std::string_view& src,std::string& dst)
+{
+    uint32_t size;
+    if(src.size() < sizeof(size))
+        return false;
+    memcpy(&size,src.data(),sizeof(size));
+    src.remove_prefix(sizeof(size));
+    if(src.size() < size)
+        return false;
+    dst.assign(src.data(),size);
+    src.remove_prefix(size);
+    return true;
+}
+
+bool TableProperties::DecodeFrom(const std::string_view& data)
+{
+    std::string_view src = data;
+    uint32_t numFields;
+    if(src.size() < sizeof(numFields))
+        return false;
+    memcpy(&numFields,src.data(),sizeof(numFields));
+    src.remove_prefix(sizeof(numFields));
+    if(numFields < kMinPropertiesFields || src.size() < numFields * sizeof(uint64_t))
+        return false;
+    uint64_t* fields[kPropertiesFields] = {&numEntries_,&numDeletions_,&numBlobIndexes_,&numDataBlocks_,
+                                            &rawKeySize_,&rawValueSize_,&dataSize_,&indexSize_,
+                                            &minSequence_,&maxSequence_,&creationTime_,&globalSequence_};
+    for (uint32_t i = 0; i < std::min(numFields,kPropertiesFields); i++)
+    {
+        memcpy(fields[i],src.data() + i * sizeof(uint64_t),sizeof(uint64_t));
+    }
+    src.remove_prefix(numFields * sizeof(uint64_t));
+    return decodeString(src,smallestKey_) && decodeString(src,largestKey_);
+}
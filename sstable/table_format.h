@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <cstdint>
+
+#include "../util/compression.h"
+#include "../util/InternalKey.h"
+
+//offset and size of a block, the size excludes the trailer
+using BlockHandle = std::pair<size_t,size_t>;
+
+//table layout:
+//[data block | trailer]... [index partition | trailer]... [index block | trailer]
+//[properties block | trailer] [footer]
+//index partitions only exist in partitioned tables, the footer's meta handle points at
+//the properties block and is (0,0) in tables written before it existed
+//trailer: type(uint8) | crc32c(uint32) over block and type
+static constexpr size_t kBlockTrailerSize = sizeof(uint8_t) + sizeof(uint32_t);
+
+static constexpr uint64_t kTableMagicNumber = 0x4c61646465725353ull;
+
+//1: one index block over the data blocks
+//2: the index handle points at a top-level index over index partitions
+static constexpr uint32_t kTableFormatVersion = 1;
+static constexpr uint32_t kPartitionedIndexFormatVersion = 2;
+
+struct Footer
+{
+    BlockHandle indexHandle_{0,0};
+    //(0,0) when the table has no such block
+    BlockHandle filterHandle_{0,0};
+    BlockHandle metaHandle_{0,0};
+    uint32_t formatVersion_{kTableFormatVersion};
+
+    //three handles | version | magic
+    static constexpr size_t kEncodedLength = 6 * sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t);
+
+    void EncodeTo(std::string& dst) const;
+
+    //false on a wrong magic number or an unknown version
+    bool DecodeFrom(const char* data);
+};
+
+uint32_t BlockChecksum(const std::string_view& block,CompressionType type);
+
+void AppendBlockTrailer(std::string& dst,const std::string_view& block,CompressionType type);
+
+//data points at a block followed by its trailer
+bool VerifyBlockTrailer(const char* data,size_t size);
+
+CompressionType BlockTrailerType(const char* data,size_t size);
+
+//per-table statistics written by the builder into the meta block
+struct TableProperties
+{
+    uint64_t numEntries_{0};
+    uint64_t numDeletions_{0};
+    //entries whose value is a reference into a blob file
+    uint64_t numBlobIndexes_{0};
+    uint64_t numDataBlocks_{0};
+    //key and value bytes before block compression, a blob value counts as its reference
+    uint64_t rawKeySize_{0};
+    uint64_t rawValueSize_{0};
+    //data and index bytes as stored, after compression and with trailers
+    uint64_t dataSize_{0};
+    uint64_t indexSize_{0};
+    SequenceNumber minSequence_{kDefaultMaxSequenceNumber};
+    SequenceNumber maxSequence_{0};
+    //seconds since the epoch
+    uint64_t creationTime_{0};
+    //set when the table is ingested, every key then reads with this sequence
+    //in place of the 0 it was written with
+    SequenceNumber globalSequence_{0};
+    //internal keys
+    std::string smallestKey_{};
+    std::string largestKey_{};
+
+    //numFields(uint32) | fields(uint64)... | smallest and largest key as uint32 length | bytes
+    //readers skip fields they do not know, so fields are only ever appended
+    void EncodeTo(std::string& dst) const;
+
+    bool DecodeFrom(const std::string_view& src);
+
+    //where globalSequence_ sits in the encoding, so that ingestion can patch it in place
+    static constexpr size_t kGlobalSequenceOffset = sizeof(uint32_t) + 11 * sizeof(uint64_t);
+};
@@ -0,0 +1,432 @@
+#include "AsyncReader.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+class ThreadPoolReader : public AsyncReader
+{
+private:
+    //completions of one Read call
+    struct Batch
+    {
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::vector<size_t> completed_;
+    };
+
+    struct Task
+    {
+        ReadRequest* request_;
+        size_t index_;
+        Batch* batch_;
+    };
+
+    std::vector<std::thread> workers_;
+    std::deque<Task> queue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool shutdown_{false};
+
+    void work()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                cond_.wait(lk,[this]{ return shutdown_ || !queue_.empty(); });
+                if(queue_.empty())
+                    return;
+                task = queue_.front();
+                queue_.pop_front();
+            }
+            ReadRequest* request = task.request_;
+            request->ok_ = request->file_->Read(request->offset_,request->size_,request->scratch_);
+            std::lock_guard<std::mutex> lk(task.batch_->mutex_);
+            task.batch_->completed_.push_back(task.index_);
+            task.batch_->cond_.notify_one();
+        }
+    }
+public:
+    explicit ThreadPoolReader(size_t threads)
+    {
+        for (size_t i = 0; i < (threads == 0 ? 1 : threads); i++)
+        {
+            workers_.emplace_back([this]{ work(); });
+        }
+    }
+
+    ~ThreadPoolReader() override
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            shutdown_ = true;
+        }
+        cond_.notify_all();
+        for (auto & worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    void Read(ReadRequest* requests,size_t n,const std::function<void(size_t)>& done) override
+    {
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            for (size_t i = 0; i < n; i++)
+            {
+                queue_.push_back(Task{requests + i,i,&batch});
+            }
+        }
+        cond_.notify_all();
+        std::vector<size_t> completed;
+        for (size_t handled = 0; handled < n;)
+        {
+            {
+                std::unique_lock<std::mutex> lk(batch.mutex_);
+                batch.cond_.wait(lk,[&batch]{ return !batch.completed_.empty(); });
+                completed.swap(batch.completed_);
+            }
+            for (size_t index : completed)
+            {
+                done(index);
+            }
+            handled += completed.size();
+            completed.clear();
+        }
+    }
+
+    const char* Name() const override
+    {
+        return "threadpool";
+    }
+};
+
+#ifdef __linux__
+//io_uring driven through the raw syscalls, no liburing needed
+class UringReader : public AsyncReader
+{
+private:
+    struct Ring
+    {
+        int fd_{-1};
+        unsigned entries_{0};
+
+        void* sqRing_{nullptr};
+        size_t sqRingSize_{0};
+        void* cqRing_{nullptr};
+        size_t cqRingSize_{0};
+        io_uring_sqe* sqes_{nullptr};
+
+        unsigned* sqHead_;
+        unsigned* sqTail_;
+        unsigned* sqMask_;
+        unsigned* sqArray_;
+        unsigned* cqHead_;
+        unsigned* cqTail_;
+        unsigned* cqMask_;
+        io_uring_cqe* cqes_;
+
+        ~Ring()
+        {
+            if(sqes_ != nullptr)
+                ::munmap(sqes_,entries_ * sizeof(io_uring_sqe));
+            if(cqRing_ != nullptr && cqRing_ != sqRing_)
+                ::munmap(cqRing_,cqRingSize_);
+            if(sqRing_ != nullptr)
+                ::munmap(sqRing_,sqRingSize_);
+            if(fd_ >= 0)
+                ::close(fd_);
+        }
+    };
+
+    const unsigned queueDepth_;
+    //idle rings, a Read call owns one ring while it runs
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::mutex mutex_;
+
+    static std::unique_ptr<Ring> newRing(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params,0,sizeof(params));
+        auto ring = std::make_unique<Ring>();
+        ring->fd_ = ::syscall(__NR_io_uring_setup,entries,&params);
+        if(ring->fd_ < 0)
+            return nullptr;
+        //IORING_OP_READ needs 5.6, the first kernel with this feature
+        if(!(params.features & IORING_FEAT_RW_CUR_POS))
+            return nullptr;
+        ring->entries_ = params.sq_entries;
+        ring->sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if(single)
+            ring->sqRingSize_ = ring->cqRingSize_ = std::max(ring->sqRingSize_,ring->cqRingSize_);
+
+        void* sq = ::mmap(nullptr,ring->sqRingSize_,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring->fd_,IORING_OFF_SQ_RING);
+        if(sq == MAP_FAILED)
+            return nullptr;
+        ring->sqRing_ = sq;
+        if(single)
+        {
+            ring->cqRing_ = sq;
+        } else
+        {
+            void* cq = ::mmap(nullptr,ring->cqRingSize_,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring->fd_,IORING_OFF_CQ_RING);
+            if(cq == MAP_FAILED)
+                return nullptr;
+            ring->cqRing_ = cq;
+        }
+        void* sqes = ::mmap(nullptr,params.sq_entries * sizeof(io_uring_sqe),PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,ring->fd_,IORING_OFF_SQES);
+        if(sqes == MAP_FAILED)
+            return nullptr;
+        ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sqBase = static_cast<char*>(ring->sqRing_);
+        ring->sqHead_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+        ring->sqTail_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+        ring->sqMask_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+        ring->sqArray_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+        char* cqBase = static_cast<char*>(ring->cqRing_);
+        ring->cqHead_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+        ring->cqTail_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+        ring->cqMask_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+        ring->cqes_ = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+        return ring;
+    }
+
+    std::unique_ptr<Ring> acquireRing()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            if(!rings_.empty())
+            {
+                std::unique_ptr<Ring> ring = std::move(rings_.back());
+                rings_.pop_back();
+                return ring;
+            }
+        }
+        return newRing(queueDepth_);
+    }
+
+    void releaseRing(std::unique_ptr<Ring> ring)
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        rings_.push_back(std::move(ring));
+    }
+
+    //queues the unread part of request index, the caller keeps the SQ from overflowing
+    static void prepareRead(Ring* ring,ReadRequest* request,size_t index,size_t hasRead)
+    {
+        unsigned tail = *ring->sqTail_;
+        unsigned slot = tail & *ring->sqMask_;
+        io_uring_sqe* sqe = &ring->sqes_[slot];
+        memset(sqe,0,sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = request->file_->fd();
+        sqe->off = request->offset_ + hasRead;
+        sqe->addr = reinterpret_cast<uint64_t>(request->scratch_ + hasRead);
+        sqe->len = request->size_ - hasRead;
+        sqe->user_data = index;
+        ring->sqArray_[slot] = slot;
+        __atomic_store_n(ring->sqTail_,tail + 1,__ATOMIC_RELEASE);
+    }
+
+    //false when the ring is unusable, requests still in flight are lost
+    static bool enter(Ring* ring,unsigned& toSubmit,unsigned minComplete)
+    {
+        while (true)
+        {
+            int ret = ::syscall(__NR_io_uring_enter,ring->fd_,toSubmit,minComplete,
+                                minComplete > 0 ? IORING_ENTER_GETEVENTS : 0,nullptr,0);
+            if(ret >= 0)
+            {
+                toSubmit -= ret;
+                return true;
+            }
+            if(errno == EINTR)
+                continue;
+            //completion queue is full, wait for a completion to reap before submitting more
+            if((errno == EAGAIN || errno == EBUSY) && minComplete > 0)
+            {
+                do
+                {
+                    ret = ::syscall(__NR_io_uring_enter,ring->fd_,0,minComplete,IORING_ENTER_GETEVENTS,nullptr,0);
+                } while (ret < 0 && errno == EINTR);
+                //busy again means completions are already waiting
+                if(ret >= 0 || errno == EAGAIN || errno == EBUSY)
+                    return true;
+            }
+            perror("io_uring_enter");
+            return false;
+        }
+    }
+
+    //waits out the reads the kernel took from a ring that cannot be entered any more,
+    //they still write into the caller's scratch buffers. completions are polled from
+    //the mapped queue, io-wq posts them without io_uring_enter
+    static void drain(Ring* ring,unsigned inFlight)
+    {
+        unsigned unsubmitted = *ring->sqTail_ - __atomic_load_n(ring->sqHead_,__ATOMIC_ACQUIRE);
+        unsigned pending = inFlight - unsubmitted;
+        while (pending > 0)
+        {
+            unsigned head = *ring->cqHead_;
+            unsigned tail = __atomic_load_n(ring->cqTail_,__ATOMIC_ACQUIRE);
+            pending -= std::min(pending,tail - head);
+            __atomic_store_n(ring->cqHead_,tail,__ATOMIC_RELEASE);
+            if(pending > 0 && ::syscall(__NR_io_uring_enter,ring->fd_,0,1,IORING_ENTER_GETEVENTS,nullptr,0) < 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+public:
+    explicit UringReader(unsigned queueDepth,std::unique_ptr<Ring> ring)
+     : queueDepth_(queueDepth)
+    {
+        rings_.push_back(std::move(ring));
+    }
+
+    static std::shared_ptr<AsyncReader> New(unsigned queueDepth)
+    {
+        std::unique_ptr<Ring> ring = newRing(queueDepth);
+        if(ring == nullptr)
+            return nullptr;
+        return std::make_shared<UringReader>(queueDepth,std::move(ring));
+    }
+
+    void Read(ReadRequest* requests,size_t n,const std::function<void(size_t)>& done) override
+    {
+        std::unique_ptr<Ring> ring = n > 0 ? acquireRing() : nullptr;
+        if(ring == nullptr)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                requests[i].ok_ = requests[i].file_->Read(requests[i].offset_,requests[i].size_,requests[i].scratch_);
+                done(i);
+            }
+            return;
+        }
+        std::vector<size_t> hasRead(n,0);
+        std::vector<bool> finished(n,false);
+        //short reads to finish, resubmitted before new requests
+        std::vector<size_t> retries;
+        size_t next = 0;
+        size_t completed = 0;
+        unsigned inFlight = 0;
+        unsigned toSubmit = 0;
+        bool broken = false;
+        while (completed < n && !broken)
+        {
+            while (inFlight < ring->entries_ && (!retries.empty() || next < n))
+            {
+                size_t index;
+                if(!retries.empty())
+                {
+                    index = retries.back();
+                    retries.pop_back();
+                } else
+                {
+                    index = next++;
+                }
+                prepareRead(ring.get(),requests + index,index,hasRead[index]);
+                inFlight++;
+                toSubmit++;
+            }
+            if(!enter(ring.get(),toSubmit,1))
+            {
+                broken = true;
+                break;
+            }
+            unsigned head = *ring->cqHead_;
+            unsigned tail = __atomic_load_n(ring->cqTail_,__ATOMIC_ACQUIRE);
+            for (; head != tail; head++)
+            {
+                io_uring_cqe* cqe = &ring->cqes_[head & *ring->cqMask_];
+                size_t index = cqe->user_data;
+                int res = cqe->res;
+                inFlight--;
+                ReadRequest* request = requests + index;
+                if(res == -EINTR || res == -EAGAIN)
+                {
+                    retries.push_back(index);
+                    continue;
+                }
+                if(res > 0)
+                {
+                    hasRead[index] += res;
+                    if(hasRead[index] < request->size_)
+                    {
+                        retries.push_back(index);
+                        continue;
+                    }
+                }
+                //errors and eof before size_ fail the request
+                request->ok_ = hasRead[index] == request->size_;
+                finished[index] = true;
+                completed++;
+                done(index);
+            }
+            __atomic_store_n(ring->cqHead_,head,__ATOMIC_RELEASE);
+        }
+        if(broken)
+        {
+            //drop the ring once nothing writes through it and finish the rest synchronously
+            drain(ring.get(),inFlight);
+            ring.reset();
+            for (size_t i = 0; i < n; i++)
+            {
+                if(finished[i])
+                    continue;
+                requests[i].ok_ = requests[i].file_->Read(requests[i].offset_,requests[i].size_,requests[i].scratch_);
+                done(i);
+            }
+            return;
+        }
+        releaseRing(std::move(ring));
+    }
+
+    const char* Name() const override
+    {
+        return "io_uring";
+    }
+};
+#endif
+
+std::shared_ptr<AsyncReader> AsyncReader::NewUringReader(unsigned queueDepth)
+{
+#ifdef __linux__
+    return UringReader::New(queueDepth);
+#else
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<AsyncReader> AsyncReader::NewThreadPoolReader(size_t threads)
+{
+    return std::make_shared<ThreadPoolReader>(threads);
+}
+
+std::shared_ptr<AsyncReader> AsyncReader::NewDefault(unsigned queueDepth,size_t threads)
+{
+    std::shared_ptr<AsyncReader> reader = NewUringReader(queueDepth);
+    if(reader == nullptr)
+        reader = NewThreadPoolReader(threads);
+    return reader;
+}
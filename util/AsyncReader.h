@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "FileSystem.h"
+
+struct ReadRequest
+{
+    const RandomAccessFile* file_;
+    uint64_t offset_;
+    size_t size_;
+    char* scratch_;
+    //set on completion, true when all size_ bytes were read
+    bool ok_{false};
+};
+
+//reads a batch of blocks with many of them in flight at once
+//completions are handed back on the calling thread, so one reader can be
+//shared by every table and every thread of a DB
+class AsyncReader
+{
+public:
+    virtual ~AsyncReader() = default;
+
+    //returns once every request has completed, done(i) runs as request i completes
+    virtual void Read(ReadRequest* requests,size_t n,const std::function<void(size_t)>& done) = 0;
+
+    virtual const char* Name() const = 0;
+
+    //io_uring, nullptr when the kernel does not support it
+    static std::shared_ptr<AsyncReader> NewUringReader(unsigned queueDepth = 64);
+
+    //pread on a pool of threads, works everywhere
+    static std::shared_ptr<AsyncReader> NewThreadPoolReader(size_t threads = 8);
+
+    //io_uring when available, the thread pool otherwise
+    static std::shared_ptr<AsyncReader> NewDefault(unsigned queueDepth = 64,size_t threads = 8);
+};
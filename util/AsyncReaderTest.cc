@@ -0,0 +1,74 @@
+#include "./AsyncReader.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+static std::string WriteTestFile(const std::string& name,size_t size)
+{
+    std::string content(size,0);
+    std::mt19937 generator(7);
+    for (auto & c : content)
+    {
+        c = generator();
+    }
+    WritableFile file(name,1 << 20);
+    file.Append(content);
+    file.Close();
+    return content;
+}
+
+static void ReadBatch(AsyncReader* reader)
+{
+    const std::string name = "async_reader.test";
+    std::string content = WriteTestFile(name,1 << 20);
+    RandomAccessFile file(name);
+    ASSERT_TRUE(file.isOpen());
+
+    std::mt19937 generator(1);
+    std::vector<ReadRequest> requests;
+    for (int i = 0; i < 500; i++)
+    {
+        size_t size = generator() % 8192 + 1;
+        size_t offset = generator() % (content.size() - size);
+        requests.push_back(ReadRequest{&file,offset,size,static_cast<char*>(malloc(size))});
+    }
+    //past the end of the file
+    requests.push_back(ReadRequest{&file,content.size() - 10,100,static_cast<char*>(malloc(100))});
+
+    std::vector<int> completions(requests.size(),0);
+    reader->Read(requests.data(),requests.size(),[&](size_t i){
+        completions[i]++;
+    });
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        ASSERT_EQ(completions[i],1);
+        const ReadRequest& request = requests[i];
+        if(i + 1 == requests.size())
+        {
+            ASSERT_FALSE(request.ok_);
+        } else
+        {
+            ASSERT_TRUE(request.ok_);
+            ASSERT_EQ(std::string(request.scratch_,request.size_),content.substr(request.offset_,request.size_));
+        }
+        free(request.scratch_);
+    }
+}
+
+TEST(AsyncReader,ThreadPool)
+{
+    std::shared_ptr<AsyncReader> reader = AsyncReader::NewThreadPoolReader(4);
+    ReadBatch(reader.get());
+}
+
+TEST(AsyncReader,Uring)
+{
+    std::shared_ptr<AsyncReader> reader = AsyncReader::NewUringReader(32);
+    if(reader == nullptr)
+        GTEST_SKIP() << "io_uring not supported";
+    ReadBatch(reader.get());
+    //rings are reused by later batches
+    ReadBatch(reader.get());
+}
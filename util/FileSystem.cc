@@ -0,0 +1,315 @@
+#include "FileSystem.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+WritableFile::WritableFile(std::string fileName,size_t bufferSize,uint64_t bytesPerSync)
+ : fileName_(std::move(fileName)),
+   bufferSize_(bufferSize < kAlignment ? kAlignment : bufferSize),
+   bytesPerSync_(bytesPerSync)
+{
+    fd_ = ::open(fileName_.c_str(),O_CLOEXEC | O_CREAT | O_TRUNC | O_WRONLY,0644);
+    if(fd_ < 0)
+    {
+        perror("open file");
+    }
+    buffer_.reserve(bufferSize_);
+}
+
+WritableFile::~WritableFile()
+{
+    Close();
+}
+
+bool WritableFile::writeOut(size_t n)
+{
+    assert(n <= buffer_.size());
+    const char* data = buffer_.data();
+    size_t left = n;
+    while (left > 0)
+    {
+        ssize_t written = ::write(fd_,data,left);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written < 0)
+        {
+            perror("write file");
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+    buffer_.erase(0,n);
+    flushed_ += n;
+    rangeSync();
+    return true;
+}
+
+void WritableFile::rangeSync()
+{
+#ifdef __linux__
+    if(bytesPerSync_ == 0 || flushed_ - rangeSynced_ < bytesPerSync_)
+        return;
+    //start writeback without waiting, so Sync() has little left to do
+    ::sync_file_range(fd_,rangeSynced_,flushed_ - rangeSynced_,SYNC_FILE_RANGE_WRITE);
+    rangeSynced_ = flushed_;
+#endif
+}
+
+bool WritableFile::Append(const std::string_view& data)
+{
+    if(fd_ < 0)
+        return false;
+    buffer_.append(data.data(),data.size());
+    size_ += data.size();
+    if(buffer_.size() < bufferSize_)
+        return true;
+    //keep the tail so the next write starts at an aligned offset
+    return writeOut(buffer_.size() - buffer_.size() % kAlignment);
+}
+
+bool WritableFile::Flush()
+{
+    if(fd_ < 0)
+        return false;
+    return writeOut(buffer_.size());
+}
+
+bool WritableFile::Sync()
+{
+    if(!Flush())
+        return false;
+    return ::fdatasync(fd_) == 0;
+}
+
+bool WritableFile::Close()
+{
+    if(fd_ < 0)
+        return true;
+    bool ok = Flush();
+    ok = ::close(fd_) == 0 && ok;
+    fd_ = -1;
+    return ok;
+}
+
+RandomAccessFile::RandomAccessFile(std::string fileName)
+ : fileName_(std::move(fileName))
+{
+    fd_ = ::open(fileName_.c_str(),O_CLOEXEC | O_RDONLY);
+    if(fd_ < 0)
+    {
+        perror("open file");
+        return;
+    }
+    struct stat st;
+    if(::fstat(fd_,&st) == 0)
+        size_ = st.st_size;
+}
+
+RandomAccessFile::~RandomAccessFile()
+{
+    if(mapped_ != nullptr)
+    {
+        ::munmap(const_cast<char*>(mapped_),size_);
+        if(limiter_)
+            limiter_->Release(size_);
+    }
+    if(fd_ >= 0)
+        ::close(fd_);
+}
+
+static int adviceFor(AccessPattern pattern)
+{
+    switch (pattern)
+    {
+    case AccessPattern::kRandom:
+        return MADV_RANDOM;
+    case AccessPattern::kSequential:
+        return MADV_SEQUENTIAL;
+    case AccessPattern::kWillNeed:
+        return MADV_WILLNEED;
+    default:
+        return MADV_NORMAL;
+    }
+}
+
+bool RandomAccessFile::Map(std::shared_ptr<MmapLimiter> limiter,AccessPattern pattern)
+{
+    assert(mapped_ == nullptr);
+    if(fd_ < 0 || size_ == 0)
+        return false;
+    if(limiter && !limiter->Acquire(size_))
+        return false;
+    void* base = ::mmap(nullptr,size_,PROT_READ,MAP_SHARED,fd_,0);
+    if(base == MAP_FAILED)
+    {
+        perror("mmap file");
+        if(limiter)
+            limiter->Release(size_);
+        return false;
+    }
+    mapped_ = static_cast<const char*>(base);
+    limiter_ = std::move(limiter);
+    Advise(pattern,0,size_);
+    return true;
+}
+
+void RandomAccessFile::Advise(AccessPattern pattern,uint64_t offset,size_t n) const
+{
+    if(mapped_ == nullptr || offset >= size_)
+        return;
+    //madvise wants a page aligned start
+    static const uint64_t pageSize = ::sysconf(_SC_PAGESIZE);
+    uint64_t start = offset / pageSize * pageSize;
+    uint64_t end = offset + n > size_ ? size_ : offset + n;
+    ::madvise(const_cast<char*>(mapped_) + start,end - start,adviceFor(pattern));
+}
+
+void RandomAccessFile::Readahead(uint64_t offset,size_t n) const
+{
+    if(mapped_ != nullptr)
+    {
+        Advise(AccessPattern::kWillNeed,offset,n);
+        return;
+    }
+    if(fd_ >= 0)
+        ::posix_fadvise(fd_,offset,n,POSIX_FADV_WILLNEED);
+}
+
+bool RandomAccessFile::Read(uint64_t offset,size_t n,char* scratch) const
+{
+    if(offset + n > size_)
+        return false;
+    if(mapped_ != nullptr)
+    {
+        memcpy(scratch,mapped_ + offset,n);
+        return true;
+    }
+    while (n > 0)
+    {
+        ssize_t hasRead = ::pread(fd_,scratch,n,offset);
+        if(hasRead < 0 && errno == EINTR)
+            continue;
+        if(hasRead <= 0)
+            return false;
+        scratch += hasRead;
+        offset += hasRead;
+        n -= hasRead;
+    }
+    return true;
+}
+
+bool LinkFile(const std::string& src,const std::string& target)
+{
+    if(::link(src.c_str(),target.c_str()) != 0)
+    {
+        //across filesystems the caller copies instead
+        if(errno != EXDEV)
+            perror("link file");
+        return false;
+    }
+    return true;
+}
+
+bool CopyFile(const std::string& src,const std::string& target)
+{
+    int in = ::open(src.c_str(),O_CLOEXEC | O_RDONLY);
+    if(in < 0)
+    {
+        perror("open file");
+        return false;
+    }
+    int out = ::open(target.c_str(),O_CLOEXEC | O_WRONLY | O_CREAT | O_EXCL,0644);
+    if(out < 0)
+    {
+        perror("open file");
+        ::close(in);
+        return false;
+    }
+    bool ok = true;
+    //the kernel copies without a trip through user space and may share extents,
+    //plain reads and writes where it cannot
+    bool inKernel = true;
+    char buf[64 * 1024];
+    while (true)
+    {
+        ssize_t n = -1;
+        if(inKernel)
+        {
+            n = ::copy_file_range(in,nullptr,out,nullptr,1 << 30,0);
+            if(n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+            {
+                inKernel = false;
+                continue;
+            }
+        } else
+        {
+            n = ::read(in,buf,sizeof(buf));
+            for (ssize_t done = 0; n > 0 && done < n;)
+            {
+                ssize_t written = ::write(out,buf + done,n - done);
+                if(written < 0 && errno == EINTR)
+                    continue;
+                if(written <= 0)
+                {
+                    n = -1;
+                    break;
+                }
+                done += written;
+            }
+        }
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+        {
+            ok = n == 0;
+            break;
+        }
+    }
+    ok = ok && ::fdatasync(out) == 0;
+    ::close(in);
+    ::close(out);
+    if(!ok)
+    {
+        perror("copy file");
+        ::unlink(target.c_str());
+    }
+    return ok;
+}
+
+bool WriteFileAt(const std::string& fileName,uint64_t offset,const std::string_view& data)
+{
+    int fd = ::open(fileName.c_str(),O_CLOEXEC | O_WRONLY);
+    if(fd < 0)
+    {
+        perror("open file");
+        return false;
+    }
+    const char* p = data.data();
+    size_t n = data.size();
+    bool ok = true;
+    while (n > 0)
+    {
+        ssize_t written = ::pwrite(fd,p,n,offset);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+        {
+            ok = false;
+            break;
+        }
+        p += written;
+        offset += written;
+        n -= written;
+    }
+    ok = ok && ::fdatasync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
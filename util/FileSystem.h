@@ -1,3 +1,5 @@
+#pragma once
+
 #ifdef _WIN64
    //define something for Windows (64-bit)
 #elif _WIN32
@@ -19,4 +21,156 @@
     // Unix
 #elif __posix
     // POSIX
-#endif
\ No newline at end of file
+#endif
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+//append-only file that buffers writes and tracks its own size
+//bytes go to the kernel in large chunks whose file offsets are aligned,
+//durability comes only from Sync()
+class WritableFile
+{
+private:
+    static constexpr size_t kAlignment = 4 * 1024;
+
+    std::string fileName_;
+    int fd_{-1};
+    std::string buffer_;
+    size_t bufferSize_;
+    //written + buffered bytes
+    uint64_t size_{0};
+    //bytes handed to write(2)
+    uint64_t flushed_{0};
+    uint64_t bytesPerSync_;
+    uint64_t rangeSynced_{0};
+
+    bool writeOut(size_t n);
+
+    void rangeSync();
+public:
+    //bytesPerSync starts background writeback every that many bytes, 0 disables
+    WritableFile(std::string fileName,size_t bufferSize,uint64_t bytesPerSync = 0);
+    ~WritableFile();
+
+    WritableFile(const WritableFile&) = delete;
+    WritableFile& operator=(const WritableFile&) = delete;
+
+    bool isOpen() const { return fd_ >= 0; }
+
+    bool Append(const std::string_view& data);
+
+    //hands every buffered byte to the kernel
+    bool Flush();
+
+    //Flush and fdatasync
+    bool Sync();
+
+    bool Close();
+
+    uint64_t Size() const { return size_; }
+
+    const std::string& FileName() const { return fileName_; }
+};
+
+//caps the bytes mapped by every table sharing it, one per DB
+class MmapLimiter
+{
+private:
+    const uint64_t limit_;
+    std::atomic<uint64_t> usage_{0};
+public:
+    explicit MmapLimiter(uint64_t limit)
+     : limit_(limit)
+    {
+
+    }
+
+    //false when mapping n more bytes would exceed the limit
+    bool Acquire(uint64_t n)
+    {
+        uint64_t usage = usage_.load(std::memory_order_relaxed);
+        do
+        {
+            if(usage + n > limit_)
+                return false;
+        } while (!usage_.compare_exchange_weak(usage,usage + n,std::memory_order_relaxed));
+        return true;
+    }
+
+    void Release(uint64_t n)
+    {
+        usage_.fetch_sub(n,std::memory_order_relaxed);
+    }
+
+    uint64_t Usage() const
+    {
+        return usage_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Limit() const
+    {
+        return limit_;
+    }
+};
+
+//madvise hint for a mapped file
+enum class AccessPattern : uint8_t {
+    kNormal = 0x0,
+    kRandom = 0x1,
+    kSequential = 0x2,
+    kWillNeed = 0x3,
+};
+
+//read-only file for positional reads, safe to share between threads
+class RandomAccessFile
+{
+private:
+    std::string fileName_;
+    int fd_{-1};
+    uint64_t size_{0};
+    const char* mapped_{nullptr};
+    std::shared_ptr<MmapLimiter> limiter_{nullptr};
+public:
+    explicit RandomAccessFile(std::string fileName);
+    ~RandomAccessFile();
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    bool isOpen() const { return fd_ >= 0; }
+
+    //reads exactly n bytes at offset into scratch, false on error or short read
+    bool Read(uint64_t offset,size_t n,char* scratch) const;
+
+    //maps the whole file, false when the limiter has no room or mmap fails,
+    //the file stays usable through Read either way
+    bool Map(std::shared_ptr<MmapLimiter> limiter,AccessPattern pattern);
+
+    //nullptr unless mapped, valid for the lifetime of this file
+    const char* Mapped() const { return mapped_; }
+
+    void Advise(AccessPattern pattern,uint64_t offset,size_t n) const;
+
+    //starts reading the range into the page cache in the background
+    void Readahead(uint64_t offset,size_t n) const;
+
+    uint64_t Size() const { return size_; }
+
+    int fd() const { return fd_; }
+
+    const std::string& FileName() const { return fileName_; }
+};
+
+//hard links target to src, both stay valid and share their contents.
+//errno is EXDEV when they are on different filesystems
+bool LinkFile(const std::string& src,const std::string& target);
+
+//copies src into the new file target and syncs it, target is removed on failure
+bool CopyFile(const std::string& src,const std::string& target);
+
+//overwrites bytes of an existing file in place and syncs it
+bool WriteFileAt(const std::string& fileName,uint64_t offset,const std::string_view& data);
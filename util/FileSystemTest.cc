@@ -0,0 +1,55 @@
+#include "./FileSystem.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+static std::string ReadFile(const std::string& name)
+{
+    std::ifstream in(name,std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static size_t DiskSize(const std::string& name)
+{
+    struct stat st;
+    ::stat(name.c_str(),&st);
+    return st.st_size;
+}
+
+TEST(WritableFile,BuffersAndTracksSize)
+{
+    const std::string name = "writable_file.test";
+    std::string expected;
+    WritableFile file(name,64 * 1024,128 * 1024);
+    ASSERT_TRUE(file.isOpen());
+    for (int i = 0; i < 10000; i++)
+    {
+        std::string chunk(i % 97 + 1,'a' + i % 26);
+        ASSERT_TRUE(file.Append(chunk));
+        expected += chunk;
+        ASSERT_EQ(file.Size(),expected.size());
+    }
+    //only whole aligned chunks reached the file so far
+    ASSERT_LT(DiskSize(name),expected.size());
+    ASSERT_EQ(DiskSize(name) % 4096,0);
+
+    ASSERT_TRUE(file.Sync());
+    ASSERT_EQ(DiskSize(name),expected.size());
+    ASSERT_TRUE(file.Close());
+    ASSERT_EQ(ReadFile(name),expected);
+}
+
+TEST(WritableFile,CloseFlushes)
+{
+    const std::string name = "writable_file_close.test";
+    {
+        WritableFile file(name,1 << 20);
+        ASSERT_TRUE(file.Append("ladder"));
+        ASSERT_EQ(DiskSize(name),0);
+    }
+    ASSERT_EQ(ReadFile(name),"ladder");
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+//murmur-like hash, stable across builds since it is persisted in table files
+inline uint32_t Hash(const char* data,size_t n,uint32_t seed = 0xbc9f1d34)
+{
+    constexpr uint32_t m = 0xc6a4a793;
+    constexpr int r = 24;
+    uint32_t h = seed ^ (n * m);
+    const char* limit = data + n;
+    while (data + 4 <= limit)
+    {
+        uint32_t w;
+        memcpy(&w,data,sizeof(w));
+        data += 4;
+        h += w;
+        h *= m;
+        h ^= (h >> 16);
+    }
+    switch (limit - data)
+    {
+    case 3:
+        h += static_cast<uint8_t>(data[2]) << 16;
+        [[fallthrough]];
+    case 2:
+        h += static_cast<uint8_t>(data[1]) << 8;
+        [[fallthrough]];
+    case 1:
+        h += static_cast<uint8_t>(data[0]);
+        h *= m;
+        h ^= (h >> r);
+        break;
+    }
+    return h;
+}
+
+inline uint32_t Hash(const std::string_view& data)
+{
+    return Hash(data.data(),data.size());
+}
@@ -10,7 +10,15 @@ using SequenceNumber = uint64_t;
 enum class OpsType {
     DELETE = 0x0,
     UPDATE = 0x1,
+    //an UPDATE whose value lives in a blob file, the entry holds a BlobIndex
+    BLOB_INDEX = 0x2,
+    //an operand folded onto the older versions by the MergeOperator
+    MERGE = 0x3,
 };
+static constexpr OpsType kMaxOpsType = OpsType::MERGE;
+//entries of one sequence order by type, largest first, so lookup and seek keys carry the
+//largest type to land before every entry written at their sequence
+static constexpr OpsType kOpsTypeForSeek = kMaxOpsType;
 static constexpr SequenceNumber kDefaultMaxSequenceNumber = std::numeric_limits<SequenceNumber>::max();
 
 
@@ -105,11 +113,70 @@ public:
         res.seq_ = seq;
         res.type_ = static_cast<OpsType>(type);
 
-        return type <= static_cast<uint8_t>(OpsType::UPDATE);
+        return type <= static_cast<uint8_t>(kMaxOpsType);
     }
 
     
 
 };
 
+//the type byte of an encoded internal key
+inline OpsType ExtractOpsType(const std::string_view& ikey)
+{
+    assert(ikey.size() >= 8);
+    return static_cast<OpsType>(static_cast<uint8_t>(ikey[ikey.size() - 8]));
+}
+
+inline void SetOpsType(std::string& ikey,OpsType type)
+{
+    assert(ikey.size() >= 8);
+    ikey[ikey.size() - 8] = static_cast<char>(type);
+}
+
+//a lookup key with kOpsTypeForSeek, copied onto the stack unless the user key is long
+class SeekKey
+{
+private:
+    static constexpr size_t kInlineSize = 64;
+    char inline_[kInlineSize];
+    std::string heap_;
+    std::string_view key_;
+public:
+    explicit SeekKey(const std::string_view& lookupKey)
+    {
+        assert(lookupKey.size() >= 8);
+        char* p = inline_;
+        if(lookupKey.size() > kInlineSize)
+        {
+            heap_.resize(lookupKey.size());
+            p = heap_.data();
+        }
+        memcpy(p,lookupKey.data(),lookupKey.size());
+        p[lookupKey.size() - 8] = static_cast<char>(kOpsTypeForSeek);
+        key_ = std::string_view(p,lookupKey.size());
+    }
+
+    SeekKey(const SeekKey&) = delete;
+    SeekKey& operator=(const SeekKey&) = delete;
+
+    std::string_view Encode() const
+    {
+        return key_;
+    }
+};
 
+inline SequenceNumber ExtractSequence(const std::string_view& ikey)
+{
+    assert(ikey.size() >= 8);
+    uint64_t packSeqAndType;
+    memcpy(&packSeqAndType,ikey.data() + ikey.size() - 8,sizeof(packSeqAndType));
+    return packSeqAndType >> 8;
+}
+
+//keeps the type byte
+inline void SetSequence(std::string& ikey,SequenceNumber seq)
+{
+    assert(ikey.size() >= 8);
+    uint64_t packSeqAndType = (seq << 8) | static_cast<uint8_t>(ikey[ikey.size() - 8]);
+    memcpy(ikey.data() + ikey.size() - 8,&packSeqAndType,sizeof(packSeqAndType));
+}
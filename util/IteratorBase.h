@@ -22,6 +22,13 @@ public:
 
     virtual void Seek(const K&) = 0;
 
+    //positions for a point lookup, may leave the iterator invalid when no entry
+    //shares the target's user key, a plain Seek unless the source can do better
+    virtual void SeekForGet(const K& target)
+    {
+        Seek(target);
+    }
+
     virtual void Next() = 0;
 
     virtual void Prev() = 0;
@@ -30,4 +37,11 @@ public:
 
     virtual V value() const = 0;
 
+    //true once an entry could not be read, e.g. a block failed its checksum, the iterator
+    //is invalid then rather than at its end. sources that cannot fail keep the default
+    virtual bool Corrupted() const
+    {
+        return false;
+    }
+
 };
@@ -7,6 +7,8 @@
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <functional>
+#include <vector>
 struct Entry
 {
     void* value_;
@@ -28,6 +30,9 @@ class LRUCache
 {
 public:
     using HashTable = std::unordered_map<std::string,Entry*>;
+    //called outside the lock for entries dropped by capacity eviction,
+    //right before their deleter runs
+    using EvictionHook = std::function<void(const std::string& key,void* value)>;
     LRUCache()
     {
         activeList_.next_ = &activeList_;
@@ -50,8 +55,9 @@ public:
             }
 
             
+            Entry* next = e->next_;
             UnRef(e);
-            e = e->next_; 
+            e = next;
         }
         
     }
@@ -69,10 +75,12 @@ public:
         entry->inCache_ = true;
         entry->refs_ = 2;
         memcpy(entry->data_,key.data(),key.length());
-        usage_ += charge;
 
+        std::vector<Entry*> evicted;
+        EvictionHook hook;
         {
             std::lock_guard<std::mutex> lk(mutex_);
+            usage_ += charge;
             FinishErase(table_.find(key));
             LRUAppend(&activeList_,entry);
             table_[key] = entry;
@@ -80,9 +88,26 @@ public:
             {
                 Entry* old = inactiveList_.next_;  
                 HashTable::iterator it = table_.find(old->key());                                   
-                FinishErase(it);
+                if(hook_)
+                {
+                    Detach(old);
+                    evicted.push_back(old);
+                } else
+                {
+                    FinishErase(it);
+                }
                 table_.erase(it);
-            }   
+            }
+            if(!evicted.empty())
+                hook = hook_;
+        }
+        //detached entries are unreachable and only referenced by the cache
+        for (Entry* e : evicted)
+        {
+            std::string key = e->key();
+            hook(key,e->value_);
+            e->deleter_(key,e->value_);
+            free(e);
         }
         return entry;
     }
@@ -153,6 +178,12 @@ public:
         return capacity_;
     }
 
+    void setEvictionHook(EvictionHook hook)
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        hook_ = std::move(hook);
+    }
+
 private:
     void LRUAppend(Entry* list,Entry* e)
     {   
@@ -204,6 +235,14 @@ private:
         }
     }
 
+    void Detach(Entry* entry)
+    {
+        assert(entry->refs_ == 1);
+        usage_ -= entry->charge_;
+        LRURemove(entry);
+        entry->inCache_ = false;
+    }
+
     bool FinishErase(HashTable::iterator it)
     {
         if(it != table_.end())
@@ -221,9 +260,9 @@ private:
 
 private:
     
-    size_t usage_;
+    size_t usage_{0};
 
-    size_t capacity_;
+    size_t capacity_{0};
 
     Entry activeList_;
 
@@ -231,6 +270,8 @@ private:
     
     HashTable table_;
 
+    EvictionHook hook_;
+
     mutable std::mutex mutex_;
 };
 
@@ -294,6 +335,24 @@ public:
         uint32_t shard = Shard(key);
         return shards_[shard].Value(key);
     }
+
+    void SetEvictionHook(const LRUCache::EvictionHook& hook)
+    {
+        for (auto & shard : shards_)
+        {
+            shard.setEvictionHook(hook);
+        }
+    }
+
+    size_t TotalCharge() const
+    {
+        size_t total = 0;
+        for (const auto & shard : shards_)
+        {
+            total += shard.TotalCharge();
+        }
+        return total;
+    }
 };
 
 
@@ -49,13 +49,13 @@ public:
 
     void Insert(int key,int v,int charge = 1)
     {
-        Entry* e = cache_->Insert(EncodeKey(key),EncodeValue(v),1,Deleter);
+        Entry* e = cache_->Insert(EncodeKey(key),EncodeValue(v),charge,Deleter);
         cache_->Release(e);
     }
 
     Entry* InsertAndReturnEntry(int key,int v,int charge = 1)
     {
-        Entry* e = cache_->Insert(EncodeKey(key),EncodeValue(v),1,Deleter);
+        Entry* e = cache_->Insert(EncodeKey(key),EncodeValue(v),charge,Deleter);
         return e;
     }
 
@@ -201,3 +201,28 @@ TEST_F(CacheTest, HeavyEntries) {
   }
   ASSERT_LE(cached_weight, kCacheSize + kCacheSize / 10);
 }
+
+TEST_F(CacheTest, EvictionHook) {
+  std::vector<int> evictedKeys;
+  cache_->SetEvictionHook([&evictedKeys](const std::string& key,void* value){
+    evictedKeys.push_back(DecodeKey(key));
+  });
+  Insert(100, 101);
+  Entry* h = cache_->Lookup(EncodeKey(100));
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  // pinned entries are never handed to the hook
+  for (int k : evictedKeys) {
+    ASSERT_NE(100, k);
+  }
+  ASSERT_FALSE(evictedKeys.empty());
+  ASSERT_EQ(evictedKeys.size(), deletedKeys_.size());
+
+  // explicit erase is not an eviction
+  size_t before = evictedKeys.size();
+  cache_->Release(h);
+  Erase(100);
+  ASSERT_EQ(before, evictedKeys.size());
+  cache_->SetEvictionHook(nullptr);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+//user-supplied read-modify-write, such as counters or appends: a MERGE entry holds an
+//operand that reads fold onto the key's older value. the operation must be associative
+//so that compaction can combine operands ahead of the base value
+class MergeOperator
+{
+public:
+    virtual ~MergeOperator() = default;
+
+    //existing is nullptr when the key has no value below the operands, operands come
+    //oldest first, false fails the read
+    virtual bool FullMerge(const std::string_view& userKey,const std::string_view* existing,
+                            const std::vector<std::string_view>& operands,std::string* result) const = 0;
+
+    //combines two adjacent operands, older first, into one,
+    //false keeps them apart
+    virtual bool PartialMerge([[maybe_unused]] const std::string_view& userKey,[[maybe_unused]] const std::string_view& older,
+                                [[maybe_unused]] const std::string_view& newer,[[maybe_unused]] std::string* result) const
+    {
+        return false;
+    }
+};
+
+//operands of one key as a lookup meets them, newest first, possibly across memtable
+//and several tables
+class MergeContext
+{
+private:
+    std::vector<std::string> operands_;
+public:
+    void PushOperand(const std::string_view& operand)
+    {
+        operands_.emplace_back(operand);
+    }
+
+    bool empty() const
+    {
+        return operands_.empty();
+    }
+
+    size_t size() const
+    {
+        return operands_.size();
+    }
+
+    void Clear()
+    {
+        operands_.clear();
+    }
+
+    //base is nullptr when the key has no older value
+    bool Fold(const MergeOperator& mergeOperator,const std::string_view& userKey,
+                const std::string_view* base,std::string* result) const
+    {
+        std::vector<std::string_view> operands(operands_.rbegin(),operands_.rend());
+        result->clear();
+        return mergeOperator.FullMerge(userKey,base,operands,result);
+    }
+};
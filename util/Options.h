@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "LRUCache.h"
+#include "SecondaryCache.h"
+#include "compression.h"
+#include "FileSystem.h"
+#include "AsyncReader.h"
+#include "MergeOperator.h"
+
+class PersistentCache;
+
+struct Options
+{
+    //KVBlock cache shared by tables, each table creates its own when null
+    std::shared_ptr<ShardedLRUCache> blockCache_{nullptr};
+    //compressed tier behind the block cache, disabled when null. a shared block cache
+    //needs SSTable::InstallSecondaryCache, TableCache calls it
+    std::shared_ptr<CompressedSecondaryCache> secondaryCache_{nullptr};
+    //local file tier keyed by (file number, offset), disabled when null and for
+    //tables opened without a file number
+    std::shared_ptr<PersistentCache> persistentCache_{nullptr};
+    //check block checksums when reading from disk, the index is always checked
+    bool verifyChecksums_{true};
+    //map table files and read uncompressed blocks in place, they skip the block cache
+    //mapped blocks are verified on every read when verifyChecksums_ is set
+    bool useMmapReads_{false};
+    //shared mapped-bytes budget, tables past it fall back to pread, unlimited when null
+    std::shared_ptr<MmapLimiter> mmapLimiter_{nullptr};
+    //madvise hint for mapped tables
+    AccessPattern accessPattern_{AccessPattern::kRandom};
+    //batched block reads keep many reads in flight through it, plain pread when null
+    std::shared_ptr<AsyncReader> asyncReader_{nullptr};
+    //forward scans read ahead up to this many blocks, the window doubles from 2, 0 disables
+    size_t maxReadaheadBlocks_{32};
+
+    //table building
+    uint64_t blockSize_{4 * 1024};
+    //falls back to kNoCompression when the codec is not built in
+    CompressionType compression_{CompressionType::kLZCompression};
+    //blocks are stored raw unless compression saves at least this fraction
+    double minCompressionSavings_{0.125};
+    //append a user key hash index to every data block, point lookups skip the
+    //binary search over the restarts
+    bool blockHashIndex_{false};
+    //store a fixed-width prefix of every restart key in a contiguous array, block seeks
+    //search it with vector compares before touching the keys
+    bool blockPrefixArray_{false};
+    //data blocks whose keys and values all have one size each are stored without lengths
+    //or restarts and searched by position, others keep the variable layout
+    bool fixedSizeBlocks_{false};
+    //cut the index into partitions of about this size under a small top-level index,
+    //partitions are loaded through the block cache on demand, 0 keeps one index block
+    uint64_t indexPartitionSize_{0};
+    //values at least this large are written to a blob file when the table builder
+    //has one and the table keeps a reference, 0 keeps every value inline
+    uint64_t minBlobSize_{0};
+    //table files are written in chunks of this size
+    size_t tableWriteBufferSize_{1 << 20};
+    //start writeback every this many bytes while building, 0 waits for the final sync
+    uint64_t bytesPerSync_{0};
+    //folds MERGE entries on reads and in compaction, they are returned as they are when null
+    std::shared_ptr<MergeOperator> mergeOperator_{nullptr};
+};
+
+struct ReadOptions
+{
+    //user keys, scans see keys in [lower, upper), unbounded when empty
+    //tables wholly outside the range are not opened
+    std::optional<std::string> iterateLowerBound_{};
+    std::optional<std::string> iterateUpperBound_{};
+    //false hands BLOB_INDEX entries out as they are, as compaction copies them
+    bool resolveBlobs_{true};
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+
+#include "compression.h"
+
+//second cache tier that keeps blocks in compressed form
+//blocks evicted from the primary cache are demoted here, a hit hands the
+//block back to the caller and drops it from this tier (promotion)
+class CompressedSecondaryCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits_{0};
+        uint64_t misses_{0};
+        uint64_t inserts_{0};
+        uint64_t evictions_{0};
+        //bytes charged against the budget
+        size_t usage_{0};
+        //uncompressed bytes held
+        size_t rawUsage_{0};
+    };
+
+    explicit CompressedSecondaryCache(size_t capacity)
+     : capacity_(capacity)
+    {
+
+    }
+
+    ~CompressedSecondaryCache() = default;
+
+    CompressedSecondaryCache(const CompressedSecondaryCache&) = delete;
+    CompressedSecondaryCache& operator=(const CompressedSecondaryCache&) = delete;
+
+    static std::shared_ptr<CompressedSecondaryCache> NewCache(size_t capacity)
+    {
+        return std::make_shared<CompressedSecondaryCache>(capacity);
+    }
+
+    void Insert(const std::string& key,const std::string_view& raw)
+    {
+        Item item;
+        item.key_ = key;
+        item.rawSize_ = raw.size();
+        LZCompress(raw,item.data_);
+        //keep incompressible blocks as they are
+        item.compressed_ = item.data_.size() < raw.size();
+        if(!item.compressed_)
+            item.data_.assign(raw.data(),raw.size());
+        size_t charge = item.data_.size() + key.size();
+        if(charge > capacity_)
+            return;
+
+        std::lock_guard<std::mutex> lk(mutex_);
+        eraseLocked(key);
+        lru_.push_front(std::move(item));
+        table_[key] = lru_.begin();
+        stats_.usage_ += charge;
+        stats_.rawUsage_ += raw.size();
+        stats_.inserts_++;
+        while (stats_.usage_ > capacity_)
+        {
+            eraseLocked(lru_.back().key_);
+            stats_.evictions_++;
+        }
+    }
+
+    //returns a malloc'd copy of the uncompressed block owned by the caller,
+    //nullptr on miss
+    char* Lookup(const std::string& key,size_t* size)
+    {
+        Item item;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            auto it = table_.find(key);
+            if(it == table_.end())
+            {
+                stats_.misses_++;
+                return nullptr;
+            }
+            stats_.hits_++;
+            ItemList::iterator pos = it->second;
+            item = std::move(*pos);
+            stats_.usage_ -= item.data_.size() + key.size();
+            stats_.rawUsage_ -= item.rawSize_;
+            table_.erase(it);
+            lru_.erase(pos);
+        }
+
+        char* buf = static_cast<char*>(malloc(item.rawSize_));
+        if(item.compressed_)
+        {
+            if(!LZUncompress(item.data_,buf,item.rawSize_))
+            {
+                free(buf);
+                return nullptr;
+            }
+        } else
+        {
+            memcpy(buf,item.data_.data(),item.rawSize_);
+        }
+        *size = item.rawSize_;
+        return buf;
+    }
+
+    void Erase(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        eraseLocked(key);
+    }
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return stats_;
+    }
+
+    size_t Capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    struct Item
+    {
+        std::string key_;
+        std::string data_;
+        size_t rawSize_{0};
+        bool compressed_{false};
+    };
+    using ItemList = std::list<Item>;
+
+    void eraseLocked(const std::string& key)
+    {
+        auto it = table_.find(key);
+        if(it == table_.end())
+            return;
+        ItemList::iterator item = it->second;
+        stats_.usage_ -= item->data_.size() + key.size();
+        stats_.rawUsage_ -= item->rawSize_;
+        table_.erase(it);
+        lru_.erase(item);
+    }
+
+    const size_t capacity_;
+
+    //front is the most recently inserted
+    ItemList lru_;
+
+    std::unordered_map<std::string,ItemList::iterator> table_;
+
+    Stats stats_;
+
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,110 @@
+#include "./SecondaryCache.h"
+#include "./compression.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+
+static std::string CompressibleString(size_t size)
+{
+    std::string s;
+    std::mt19937 generator(301);
+    while (s.size() < size)
+    {
+        s.append("key_" + std::to_string(generator() % 100) + "_value_");
+    }
+    s.resize(size);
+    return s;
+}
+
+static std::string RandomBytes(size_t size)
+{
+    std::string s(size,0);
+    std::mt19937 generator(17);
+    for (auto & c : s)
+    {
+        c = static_cast<char>(generator());
+    }
+    return s;
+}
+
+static std::string RoundTrip(const std::string& raw)
+{
+    std::string compressed;
+    LZCompress(raw,compressed);
+    size_t length = 0;
+    EXPECT_TRUE(LZUncompressedLength(compressed,&length));
+    std::string out(length,0);
+    EXPECT_TRUE(LZUncompress(compressed,out.data(),length));
+    return out;
+}
+
+TEST(LZ,RoundTrip)
+{
+    for (size_t size : {0,1,7,12,13,100,4096,65536,300000})
+    {
+        std::string compressible = CompressibleString(size);
+        ASSERT_EQ(RoundTrip(compressible),compressible);
+        std::string random = RandomBytes(size);
+        ASSERT_EQ(RoundTrip(random),random);
+    }
+    std::string runs(10000,'a');
+    ASSERT_EQ(RoundTrip(runs),runs);
+
+    std::string compressed;
+    LZCompress(CompressibleString(4096),compressed);
+    ASSERT_LT(compressed.size(),4096 / 2);
+}
+
+TEST(LZ,RejectsCorruption)
+{
+    std::string raw = CompressibleString(4096);
+    std::string compressed;
+    LZCompress(raw,compressed);
+    std::string out(raw.size(),0);
+    ASSERT_FALSE(LZUncompress(std::string_view(compressed.data(),compressed.size() / 2),out.data(),out.size()));
+    ASSERT_FALSE(LZUncompress(compressed,out.data(),out.size() - 1));
+}
+
+TEST(SecondaryCache,PromoteOnHit)
+{
+    auto cache = CompressedSecondaryCache::NewCache(1 << 20);
+    std::string raw = CompressibleString(4096);
+    cache->Insert("a",raw);
+    auto stats = cache->GetStats();
+    ASSERT_EQ(stats.inserts_,1);
+    ASSERT_EQ(stats.rawUsage_,raw.size());
+    ASSERT_LT(stats.usage_,raw.size());
+
+    size_t size = 0;
+    char* data = cache->Lookup("a",&size);
+    ASSERT_NE(data,nullptr);
+    ASSERT_EQ(std::string(data,size),raw);
+    free(data);
+
+    //promoted blocks leave this tier
+    ASSERT_EQ(cache->Lookup("a",&size),nullptr);
+    stats = cache->GetStats();
+    ASSERT_EQ(stats.hits_,1);
+    ASSERT_EQ(stats.misses_,1);
+    ASSERT_EQ(stats.usage_,0);
+}
+
+TEST(SecondaryCache,ByteBudget)
+{
+    const size_t capacity = 16 * 1024;
+    auto cache = CompressedSecondaryCache::NewCache(capacity);
+    std::string raw = RandomBytes(4096);
+    for (int i = 0; i < 16; i++)
+    {
+        cache->Insert(std::to_string(i),raw);
+        ASSERT_LE(cache->GetStats().usage_,capacity);
+    }
+    auto stats = cache->GetStats();
+    ASSERT_GT(stats.evictions_,0);
+    size_t size = 0;
+    ASSERT_EQ(cache->Lookup("0",&size),nullptr);
+    char* data = cache->Lookup("15",&size);
+    ASSERT_NE(data,nullptr);
+    ASSERT_EQ(std::string(data,size),raw);
+    free(data);
+}
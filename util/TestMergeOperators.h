@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MergeOperator.h"
+
+//merge operators shared by the tests
+
+//decimal counters
+class AddOperator : public MergeOperator
+{
+public:
+    bool FullMerge(const std::string_view&,const std::string_view* existing,
+                    const std::vector<std::string_view>& operands,std::string* result) const override
+    {
+        long long sum = existing != nullptr ? std::stoll(std::string(*existing)) : 0;
+        for (const auto & operand : operands)
+        {
+            sum += std::stoll(std::string(operand));
+        }
+        *result = std::to_string(sum);
+        return true;
+    }
+
+    bool PartialMerge(const std::string_view&,const std::string_view& older,
+                        const std::string_view& newer,std::string* result) const override
+    {
+        *result = std::to_string(std::stoll(std::string(older)) + std::stoll(std::string(newer)));
+        return true;
+    }
+};
+
+//comma separated lists, operands cannot be combined without the base
+class AppendOperator : public MergeOperator
+{
+public:
+    bool FullMerge(const std::string_view&,const std::string_view* existing,
+                    const std::vector<std::string_view>& operands,std::string* result) const override
+    {
+        if(existing != nullptr)
+            *result = *existing;
+        for (const auto & operand : operands)
+        {
+            if(!result->empty())
+                result->push_back(',');
+            result->append(operand);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "CRC.h"
+
+//CRC-32C (Castagnoli), CRC.h only exposes it under CRCPP_INCLUDE_ESOTERIC_CRC_DEFINITIONS
+inline const CRC::Table<crcpp_uint32,32>& CRC32CTable()
+{
+    static const CRC::Parameters<crcpp_uint32,32> parameters = { 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true, true };
+    static const CRC::Table<crcpp_uint32,32> table(parameters);
+    return table;
+}
+
+inline uint32_t CRC32C(const char* data,size_t size)
+{
+    return CRC::Calculate(data,size,CRC32CTable());
+}
+
+//continue crc over more bytes
+inline uint32_t CRC32CExtend(uint32_t crc,const char* data,size_t size)
+{
+    return CRC::Calculate(data,size,CRC32CTable(),crc);
+}
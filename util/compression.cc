@@ -0,0 +1,314 @@
+#include "compression.h"
+
+#include <cstring>
+#include <cassert>
+
+#ifdef LADDER_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef LADDER_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef LADDER_WITH_SNAPPY
+#include <snappy-c.h>
+#endif
+
+static constexpr size_t kMinMatch = 4;
+static constexpr size_t kHashBits = 14;
+static constexpr size_t kMaxOffset = 65535;
+//no match may start inside the last bytes of the input
+static constexpr size_t kTailLiterals = 8;
+
+static uint32_t load32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+static uint32_t hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+static void appendVarint32(std::string& buf,uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+static const char* readVarint32(const char* p,const char* limit,uint32_t* v)
+{
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift <= 28 && p < limit; shift += 7)
+    {
+        uint32_t byte = static_cast<uint8_t>(*p++);
+        result |= (byte & 0x7f) << shift;
+        if((byte & 0x80) == 0)
+        {
+            *v = result;
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+static void appendLength(std::string& buf,size_t len)
+{
+    while (len >= 255)
+    {
+        buf.push_back(static_cast<char>(255));
+        len -= 255;
+    }
+    buf.push_back(static_cast<char>(len));
+}
+
+static void emitSequence(std::string& out,const char* literal,size_t literalLen,size_t offset,size_t matchLen)
+{
+    size_t extraMatch = matchLen - kMinMatch;
+    uint8_t token = (literalLen >= 15 ? 15 : literalLen) << 4;
+    token |= (extraMatch >= 15 ? 15 : extraMatch);
+    out.push_back(static_cast<char>(token));
+    if(literalLen >= 15)
+        appendLength(out,literalLen - 15);
+    out.append(literal,literalLen);
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if(extraMatch >= 15)
+        appendLength(out,extraMatch - 15);
+}
+
+static void emitLastLiterals(std::string& out,const char* literal,size_t literalLen)
+{
+    uint8_t token = (literalLen >= 15 ? 15 : literalLen) << 4;
+    out.push_back(static_cast<char>(token));
+    if(literalLen >= 15)
+        appendLength(out,literalLen - 15);
+    out.append(literal,literalLen);
+}
+
+void LZCompress(const std::string_view& input,std::string& output)
+{
+    output.clear();
+    output.reserve(input.size() + input.size() / 255 + 16);
+    appendVarint32(output,input.size());
+
+    const char* base = input.data();
+    const size_t size = input.size();
+    size_t anchor = 0;
+    if(size > kTailLiterals + kMinMatch)
+    {
+        uint32_t table[1 << kHashBits];
+        memset(table,0,sizeof(table));
+        const size_t limit = size - kTailLiterals;
+        size_t pos = 1;
+        while (pos < limit)
+        {
+            uint32_t seq = load32(base + pos);
+            uint32_t h = hash32(seq);
+            size_t candidate = table[h];
+            table[h] = pos;
+            if(candidate >= pos || pos - candidate > kMaxOffset || load32(base + candidate) != seq)
+            {
+                pos++;
+                continue;
+            }
+            size_t matchLen = kMinMatch;
+            while (pos + matchLen < limit && base[candidate + matchLen] == base[pos + matchLen])
+            {
+                matchLen++;
+            }
+            emitSequence(output,base + anchor,pos - anchor,pos - candidate,matchLen);
+            pos += matchLen;
+            anchor = pos;
+        }
+    }
+    emitLastLiterals(output,base + anchor,size - anchor);
+}
+
+bool LZUncompressedLength(const std::string_view& input,size_t* length)
+{
+    uint32_t v;
+    if(readVarint32(input.data(),input.data() + input.size(),&v) == nullptr)
+        return false;
+    *length = v;
+    return true;
+}
+
+static bool readLength(const char*& p,const char* limit,size_t* len)
+{
+    uint8_t byte;
+    do
+    {
+        if(p >= limit)
+            return false;
+        byte = static_cast<uint8_t>(*p++);
+        *len += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool LZUncompress(const std::string_view& input,char* output,size_t length)
+{
+    const char* p = input.data();
+    const char* limit = input.data() + input.size();
+    uint32_t expected;
+    p = readVarint32(p,limit,&expected);
+    if(p == nullptr || expected != length)
+        return false;
+
+    size_t written = 0;
+    while (p < limit)
+    {
+        uint8_t token = static_cast<uint8_t>(*p++);
+        size_t literalLen = token >> 4;
+        if(literalLen == 15 && !readLength(p,limit,&literalLen))
+            return false;
+        if(static_cast<size_t>(limit - p) < literalLen || length - written < literalLen)
+            return false;
+        memcpy(output + written,p,literalLen);
+        p += literalLen;
+        written += literalLen;
+        if(p == limit)
+            break;
+
+        if(limit - p < 2)
+            return false;
+        size_t offset = static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8);
+        p += 2;
+        size_t matchLen = token & 0x0f;
+        if(matchLen == 15 && !readLength(p,limit,&matchLen))
+            return false;
+        matchLen += kMinMatch;
+        if(offset == 0 || offset > written || length - written < matchLen)
+            return false;
+        //overlapping copy must go byte by byte
+        const char* src = output + written - offset;
+        char* dst = output + written;
+        for (size_t i = 0; i < matchLen; i++)
+        {
+            dst[i] = src[i];
+        }
+        written += matchLen;
+    }
+    return written == length;
+}
+
+static bool lzCompress(const std::string_view& input,std::string& output)
+{
+    LZCompress(input,output);
+    return true;
+}
+
+static const CompressionCodec kLZCodec{
+    CompressionType::kLZCompression,"lz",lzCompress,LZUncompressedLength,LZUncompress
+};
+
+#ifdef LADDER_WITH_ZSTD
+static constexpr int kZstdLevel = 3;
+
+static bool zstdCompress(const std::string_view& input,std::string& output)
+{
+    output.resize(ZSTD_compressBound(input.size()));
+    size_t n = ZSTD_compress(output.data(),output.size(),input.data(),input.size(),kZstdLevel);
+    if(ZSTD_isError(n))
+        return false;
+    output.resize(n);
+    return true;
+}
+
+static bool zstdUncompressedLength(const std::string_view& input,size_t* length)
+{
+    unsigned long long n = ZSTD_getFrameContentSize(input.data(),input.size());
+    if(n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR)
+        return false;
+    *length = n;
+    return true;
+}
+
+static bool zstdUncompress(const std::string_view& input,char* output,size_t length)
+{
+    size_t n = ZSTD_decompress(output,length,input.data(),input.size());
+    return !ZSTD_isError(n) && n == length;
+}
+
+static const CompressionCodec kZstdCodec{
+    CompressionType::kZstdCompression,"zstd",zstdCompress,zstdUncompressedLength,zstdUncompress
+};
+#endif
+
+#ifdef LADDER_WITH_LZ4
+//lz4 blocks do not record their length, prefix it
+static bool lz4Compress(const std::string_view& input,std::string& output)
+{
+    output.clear();
+    appendVarint32(output,input.size());
+    size_t header = output.size();
+    output.resize(header + LZ4_compressBound(input.size()));
+    int n = LZ4_compress_default(input.data(),output.data() + header,input.size(),output.size() - header);
+    if(n <= 0)
+        return false;
+    output.resize(header + n);
+    return true;
+}
+
+static bool lz4Uncompress(const std::string_view& input,char* output,size_t length)
+{
+    uint32_t expected;
+    const char* p = readVarint32(input.data(),input.data() + input.size(),&expected);
+    if(p == nullptr || expected != length)
+        return false;
+    int n = LZ4_decompress_safe(p,output,input.data() + input.size() - p,length);
+    return n >= 0 && static_cast<size_t>(n) == length;
+}
+
+static const CompressionCodec kLZ4Codec{
+    CompressionType::kLZ4Compression,"lz4",lz4Compress,LZUncompressedLength,lz4Uncompress
+};
+#endif
+
+#ifdef LADDER_WITH_SNAPPY
+static bool snappyCompress(const std::string_view& input,std::string& output)
+{
+    size_t n = snappy_max_compressed_length(input.size());
+    output.resize(n);
+    if(snappy_compress(input.data(),input.size(),output.data(),&n) != SNAPPY_OK)
+        return false;
+    output.resize(n);
+    return true;
+}
+
+static bool snappyUncompressedLength(const std::string_view& input,size_t* length)
+{
+    return snappy_uncompressed_length(input.data(),input.size(),length) == SNAPPY_OK;
+}
+
+static bool snappyUncompress(const std::string_view& input,char* output,size_t length)
+{
+    size_t n = length;
+    return snappy_uncompress(input.data(),input.size(),output,&n) == SNAPPY_OK && n == length;
+}
+
+static const CompressionCodec kSnappyCodec{
+    CompressionType::kSnappyCompression,"snappy",snappyCompress,snappyUncompressedLength,snappyUncompress
+};
+#endif
+
+CompressionRegistry::CompressionRegistry()
+{
+    memset(codecs_,0,sizeof(codecs_));
+    Register(&kLZCodec);
+#ifdef LADDER_WITH_ZSTD
+    Register(&kZstdCodec);
+#endif
+#ifdef LADDER_WITH_LZ4
+    Register(&kLZ4Codec);
+#endif
+#ifdef LADDER_WITH_SNAPPY
+    Register(&kSnappyCodec);
+#endif
+}
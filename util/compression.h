@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+//stored in the trailer of every table block
+enum class CompressionType : uint8_t {
+    kNoCompression = 0x0,
+    kLZCompression = 0x1,
+    kZstdCompression = 0x2,
+    kLZ4Compression = 0x3,
+    kSnappyCompression = 0x4,
+};
+
+struct CompressionCodec
+{
+    CompressionType type_;
+    const char* name_;
+    bool (*compress_)(const std::string_view& input,std::string& output);
+    bool (*uncompressedLength_)(const std::string_view& input,size_t* length);
+    //output holds exactly the uncompressed length
+    bool (*uncompress_)(const std::string_view& input,char* output,size_t length);
+};
+
+//codecs by type, the in-tree LZ codec is always present
+//zstd, lz4 and snappy are registered when built with
+//LADDER_WITH_ZSTD, LADDER_WITH_LZ4 and LADDER_WITH_SNAPPY
+class CompressionRegistry
+{
+private:
+    const CompressionCodec* codecs_[256];
+
+    CompressionRegistry();
+public:
+    CompressionRegistry(const CompressionRegistry&) = delete;
+    CompressionRegistry& operator=(const CompressionRegistry&) = delete;
+
+    static CompressionRegistry& instance()
+    {
+        static CompressionRegistry registry;
+        return registry;
+    }
+
+    //nullptr when the codec is not available in this build
+    const CompressionCodec* Get(CompressionType type) const
+    {
+        return codecs_[static_cast<uint8_t>(type)];
+    }
+
+    //codec must outlive the registry
+    void Register(const CompressionCodec* codec)
+    {
+        codecs_[static_cast<uint8_t>(codec->type_)] = codec;
+    }
+};
+
+//in-tree LZ77 codec
+//format: varint32 uncompressed length | sequences
+//sequence: token(literal len << 4 | match len - 4) | literals | offset(uint16) | ...
+void LZCompress(const std::string_view& input,std::string& output);
+
+bool LZUncompressedLength(const std::string_view& input,size_t* length);
+
+//output must hold exactly LZUncompressedLength bytes
+bool LZUncompress(const std::string_view& input,char* output,size_t length);
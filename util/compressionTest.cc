@@ -0,0 +1,33 @@
+#include "./compression.h"
+#include <gtest/gtest.h>
+#include <string>
+
+TEST(CompressionRegistry,Codecs)
+{
+    CompressionRegistry& registry = CompressionRegistry::instance();
+    ASSERT_EQ(registry.Get(CompressionType::kNoCompression),nullptr);
+    ASSERT_NE(registry.Get(CompressionType::kLZCompression),nullptr);
+
+    std::string raw;
+    for (int i = 0; i < 1000; i++)
+    {
+        raw += "ladder" + std::to_string(i % 10);
+    }
+    for (CompressionType type : {CompressionType::kLZCompression,CompressionType::kZstdCompression,
+                                    CompressionType::kLZ4Compression,CompressionType::kSnappyCompression})
+    {
+        const CompressionCodec* codec = registry.Get(type);
+        if(codec == nullptr)
+            continue;
+        ASSERT_EQ(codec->type_,type);
+        std::string compressed;
+        ASSERT_TRUE(codec->compress_(raw,compressed));
+        ASSERT_LT(compressed.size(),raw.size());
+        size_t length = 0;
+        ASSERT_TRUE(codec->uncompressedLength_(compressed,&length));
+        ASSERT_EQ(length,raw.size());
+        std::string out(length,0);
+        ASSERT_TRUE(codec->uncompress_(compressed,out.data(),length));
+        ASSERT_EQ(out,raw);
+    }
+}
@@ -0,0 +1,25 @@
+#include "fname.h"
+
+#include <cstdio>
+
+static std::string MakeFileName(const std::string& dbname,uint64_t number,const char* suffix)
+{
+    char buf[64];
+    snprintf(buf,sizeof(buf),"/%06llu.%s",static_cast<unsigned long long>(number),suffix);
+    return dbname + buf;
+}
+
+std::string LogFileName(const std::string& dbname,uint64_t number)
+{
+    return MakeFileName(dbname,number,"log");
+}
+
+std::string TableFileName(const std::string& dbname,uint64_t number)
+{
+    return MakeFileName(dbname,number,"sst");
+}
+
+std::string BlobFileName(const std::string& dbname,uint64_t number)
+{
+    return MakeFileName(dbname,number,"blob");
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 std::string LogFileName(const std::string& dbname,uint64_t number);
 
-std::string TableFileName(const std::string& dbname,uint64_t number);
\ No newline at end of file
+std::string TableFileName(const std::string& dbname,uint64_t number);
+
+std::string BlobFileName(const std::string& dbname,uint64_t number);
\ No newline at end of file